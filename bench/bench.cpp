@@ -0,0 +1,481 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cryptopp/aes.h"
+#include "cryptopp/modes.h"
+#include "cryptopp/sha.h"
+
+#include "pugixml.hpp"
+
+#include "arena.hpp"
+#include "cryptbuf.hpp"
+#include "gzipbuf.hpp"
+#include "hashbuf.hpp"
+#include "io.hpp"
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+#include "membuf.hpp"
+#include "transform.hpp"
+#include "xml_memory.hpp"
+
+#include "generator.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::istream;
+using std::string;
+
+using pugi::xml_node;
+
+using CryptoPP::AES;
+using CryptoPP::CBC_Mode;
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+
+using namespace kdbx;
+
+static const char* const PASSWORD = "benchmark";
+
+// After every time the generator writes
+static const char* const LATER = "2017-01-01T00:00:00Z";
+
+struct bench_options
+{
+    generator_options database;
+    size_t iterations = 5;
+    size_t read_ahead = 0;
+    string out;
+};
+
+struct stage
+{
+    const char* name;
+    double seconds;
+    double bytes;
+    double items;
+    const char* unit;
+};
+
+// Best of several runs, in seconds
+template<typename F>
+static double best_of(size_t iterations, F run)
+{
+    double best = 0;
+
+    for (size_t ii = 0; ii < iterations; ii++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (ii == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    return best;
+}
+
+static string drain(std::streambuf* buffer)
+{
+    istream in(buffer);
+    in.exceptions(std::ios::badbit);
+
+    string out;
+    std::vector<char> chunk(64 * 1024);
+
+    while (in.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || in.gcount()) {
+        out.append(chunk.data(), static_cast<size_t>(in.gcount()));
+    }
+
+    return out;
+}
+
+/*
+ * The file saved after edit has changed the document of a load of it.
+ * Removed nodes stay in protected_values until the save, so edits add
+ * nodes before they remove any.
+ */
+template<typename F>
+static string edit_file(const string& file, F edit)
+{
+    kdbx2 db;
+    db.push_key(PASSWORD);
+    db.load(file.data(), file.size());
+
+    kdbx2_pvt& pvt = kdbx2_pvt::of(db);
+
+    {
+        xml_memory_scope scope(&pvt.arena, nullptr);
+        edit(pvt);
+    }
+
+    std::ostringstream out;
+    db.save(out);
+    return out.str();
+}
+
+static void remove_entries(kdbx2_pvt& db, size_t first, size_t step)
+{
+    for (size_t ii = first; ii < db.tree.entries.size(); ii += step) {
+        xml_node node = db.tree.entries[ii].node;
+        node.parent().remove_child(node);
+    }
+}
+
+static void delete_entries(kdbx2_pvt& db, size_t step)
+{
+    xml_node deleted = db.document.child("KeePassFile").child("Root").child("DeletedObjects");
+
+    for (size_t ii = 0; ii < db.tree.entries.size(); ii += step) {
+        xml_node object = deleted.append_child("DeletedObject");
+        object.append_child("UUID").text().set(db.tree.entries[ii].id.to_base64().c_str());
+        object.append_child("DeletionTime").text().set(LATER);
+    }
+
+    remove_entries(db, 0, step);
+}
+
+// Each one goes to the group after its own, ahead of the subgroups
+static void move_entries(kdbx2_pvt& db, size_t step)
+{
+    size_t groups = db.tree.groups.size();
+
+    for (size_t ii = 0; ii < db.tree.entries.size(); ii += step) {
+        const entry_record& e = db.tree.entries[ii];
+        xml_node target = db.tree.groups[(e.parent + 1) % groups].node;
+        xml_node before = target.child("Group");
+
+        if (before) {
+            target.insert_move_before(e.node, before);
+        } else {
+            target.append_move(e.node);
+        }
+
+        e.node.child("Times").child("LocationChanged").text().set(LATER);
+    }
+}
+
+// Best of several merges of other into fresh loads of file, in seconds.
+// Only the merge is timed, since it changes the database it runs on.
+static double best_merge(size_t iterations, const string& file, const string& other_file)
+{
+    kdbx2 other;
+    other.push_key(PASSWORD);
+    other.load(other_file.data(), other_file.size());
+
+    double best = 0;
+
+    for (size_t ii = 0; ii < iterations; ii++) {
+        kdbx2 db;
+        db.push_key(PASSWORD);
+        db.load(file.data(), file.size());
+
+        auto start = std::chrono::steady_clock::now();
+        db.merge(other);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (ii == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    return best;
+}
+
+static void usage(const char* name)
+{
+    cout << "Usage:" << endl;
+    cout << "\t" << name << " [options]" << endl;
+    cout << endl;
+    cout << "\t--entries N        entries in the database (1000)" << endl;
+    cout << "\t--depth N          levels of groups below the root (2)" << endl;
+    cout << "\t--fanout N         child groups per group (4)" << endl;
+    cout << "\t--field-size N     bytes per field value (32)" << endl;
+    cout << "\t--custom N         custom fields per entry (2)" << endl;
+    cout << "\t--protected R      share of protected fields, 0 to 1 (0.2)" << endl;
+    cout << "\t--rounds N         key transform rounds (6000)" << endl;
+    cout << "\t--no-compress      store the XML uncompressed" << endl;
+    cout << "\t--read-ahead N     hashed blocks verified ahead (0)" << endl;
+    cout << "\t--iterations N     runs per stage, the best is kept (5)" << endl;
+    cout << "\t--out PATH         also write the database to PATH" << endl;
+}
+
+static bool parse_options(int argc, char** argv, bench_options& options)
+{
+    generator_options& db = options.database;
+
+    for (int ii = 1; ii < argc; ii++) {
+        string arg = argv[ii];
+
+        if (arg == "--no-compress") {
+            db.compress = false;
+            continue;
+        }
+
+        if (ii + 1 >= argc) {
+            return false;
+        }
+
+        const char* value = argv[++ii];
+
+        if (arg == "--entries") {
+            db.entry_count = static_cast<uint32_t>(std::strtoul(value, NULL, 10));
+        } else if (arg == "--depth") {
+            db.group_depth = static_cast<uint32_t>(std::strtoul(value, NULL, 10));
+        } else if (arg == "--fanout") {
+            db.group_fanout = static_cast<uint32_t>(std::strtoul(value, NULL, 10));
+        } else if (arg == "--field-size") {
+            db.field_size = std::strtoul(value, NULL, 10);
+        } else if (arg == "--custom") {
+            db.custom_fields = static_cast<uint32_t>(std::strtoul(value, NULL, 10));
+        } else if (arg == "--protected") {
+            db.protected_ratio = std::strtod(value, NULL);
+        } else if (arg == "--rounds") {
+            db.transform_rounds = std::strtoull(value, NULL, 10);
+        } else if (arg == "--read-ahead") {
+            options.read_ahead = std::strtoul(value, NULL, 10);
+        } else if (arg == "--iterations") {
+            options.iterations = std::strtoul(value, NULL, 10);
+        } else if (arg == "--out") {
+            options.out = value;
+        } else {
+            return false;
+        }
+    }
+
+    return options.iterations > 0;
+}
+
+static void print(const stage& s)
+{
+    cout << std::left << std::setw(18) << s.name << std::right << std::fixed
+            << std::setw(12) << std::setprecision(3) << s.seconds * 1000.0 << " ms";
+
+    if (s.bytes > 0) {
+        cout << std::setw(12) << std::setprecision(1)
+                << s.bytes / s.seconds / (1024.0 * 1024.0) << " MB/s";
+    } else {
+        cout << std::setw(17) << "";
+    }
+
+    if (s.items > 0) {
+        cout << std::setw(14) << std::setprecision(0) << s.items / s.seconds << " " << s.unit;
+    }
+
+    cout << endl;
+}
+
+int main(int argc, char** argv)
+{
+    bench_options options;
+
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const generator_options& shape = options.database;
+    size_t iterations = options.iterations;
+    double entries = shape.entry_count;
+
+    generator gen(shape);
+    std::ostringstream generated;
+    gen.write(generated, PASSWORD);
+    const string file = generated.str();
+
+    if (!options.out.empty()) {
+        std::ofstream out(options.out, std::ios::binary);
+        out << file;
+
+        if (!out) {
+            cerr << "unable to write " << options.out << endl;
+            return 1;
+        }
+    }
+
+    std::vector<stage> stages;
+
+    //
+    // Header
+    //
+    kdbx2 owner;
+    kdbx2_pvt header(owner);
+    size_t header_size = 0;
+
+    double seconds = best_of(iterations, [&] {
+        membuf buffer(file.data(), file.size());
+        istream in(&buffer);
+
+        header.parse_signature(in);
+        read(in, header.file_version);
+        header.parse_fields_v1(in);
+        header_size = static_cast<size_t>(in.tellg());
+    });
+
+    stages.push_back({"header parse", seconds, static_cast<double>(header_size), 0, ""});
+
+    //
+    // Key transformation
+    //
+    SecByteBlock composite(SHA256::DIGESTSIZE);
+    SHA256().CalculateDigest(composite.data(), reinterpret_cast<const byte*>(PASSWORD),
+                                std::strlen(PASSWORD));
+    SHA256().CalculateDigest(composite.data(), composite.data(), composite.size());
+
+    SecByteBlock transformed;
+
+    seconds = best_of(iterations, [&] {
+        transformed = composite;
+        key_transform(header.transform_seed).apply(transformed.data(), header.transform_rounds);
+    });
+
+    stages.push_back({"key transform", seconds, 0,
+                        static_cast<double>(header.transform_rounds), "rounds/s"});
+
+    SHA256().CalculateDigest(transformed.data(), transformed.data(), transformed.size());
+
+    SecByteBlock master_key(SHA256::DIGESTSIZE);
+    SHA256 hash;
+    hash.Update(header.master_seed.data(), header.master_seed.size());
+    hash.Update(transformed.data(), transformed.size());
+    hash.Final(master_key.data());
+
+    //
+    // AES-CBC
+    //
+    const byte* ciphertext = reinterpret_cast<const byte*>(file.data()) + header_size;
+    size_t ciphertext_size = file.size() - header_size;
+    string plaintext;
+
+    seconds = best_of(iterations, [&] {
+        CBC_Mode<AES>::Decryption decryption(master_key, master_key.size(),
+                                                header.encryption_iv.data());
+        cryptbuf buffer(ciphertext, ciphertext_size, decryption);
+        plaintext = drain(&buffer);
+    });
+
+    stages.push_back({"AES-CBC decrypt", seconds, static_cast<double>(ciphertext_size), 0, ""});
+
+    //
+    // Hashed blocks
+    //
+    size_t start_size = header.stream_start_bytes.size();
+    size_t hashed_size = plaintext.size() - start_size;
+    string payload;
+
+    seconds = best_of(iterations, [&] {
+        membuf source(plaintext.data() + start_size, hashed_size);
+        istream in(&source);
+        hashbuf buffer(in, options.read_ahead);
+        payload = drain(&buffer);
+    });
+
+    stages.push_back({"hashbuf verify", seconds, static_cast<double>(hashed_size), 0, ""});
+
+    //
+    // GZip
+    //
+    string xml;
+
+    if (shape.compress) {
+        seconds = best_of(iterations, [&] {
+            membuf source(payload.data(), payload.size());
+            istream in(&source);
+            gzipbuf buffer(in);
+            xml = drain(&buffer);
+        });
+
+        stages.push_back({"gzip inflate", seconds, static_cast<double>(payload.size()), 0, ""});
+    } else {
+        xml = payload;
+    }
+
+    //
+    // XML
+    //
+    // Parsed in place from an arena, like a load does
+    seconds = best_of(iterations, [&] {
+        secure_arena arena;
+        pugi::xml_document doc;
+
+        char* text = static_cast<char*>(arena.allocate(xml.size()));
+        std::memcpy(text, xml.data(), xml.size());
+
+        xml_memory_scope scope(&arena, nullptr);
+        doc.load_buffer_inplace(text, xml.size());
+    });
+
+    stages.push_back({"XML parse", seconds, static_cast<double>(xml.size()), entries, "entries/s"});
+
+    //
+    // Objects
+    //
+    header.document.load_buffer(xml.data(), xml.size());
+
+    seconds = best_of(iterations, [&] {
+        pugi::xml_node kee = header.document.child("KeePassFile");
+
+        header.protected_values.clear();
+        header.protected_offset = 0;
+        header.index_protected(header.document);
+        header.parse_meta(kee.child("Meta"));
+        header.tree.build(kee.child("Root"), header.protected_values);
+        header.index_tree();
+        header.urls.build(header.tree);
+    });
+
+    stages.push_back({"object build", seconds, 0, entries, "entries/s"});
+
+    //
+    // The whole load
+    //
+    seconds = best_of(iterations, [&] {
+        kdbx2 db;
+        db.push_key(PASSWORD);
+        db.set_read_ahead(options.read_ahead);
+        db.load(file.data(), file.size());
+    });
+
+    stages.push_back({"full load", seconds, static_cast<double>(file.size()), entries, "entries/s"});
+
+    //
+    // Merges
+    //
+    // Each merges an edited copy into the file, mostly through one path:
+    // matching every object, adding entries, deleting them by tombstone and
+    // moving them to another group
+    stages.push_back({"merge identical", best_merge(iterations, file, file),
+                        0, entries, "entries/s"});
+
+    string even = edit_file(file, [](kdbx2_pvt& db) { remove_entries(db, 1, 2); });
+    string odd = edit_file(file, [](kdbx2_pvt& db) { remove_entries(db, 0, 2); });
+    stages.push_back({"merge disjoint", best_merge(iterations, even, odd),
+                        0, entries, "entries/s"});
+
+    string deleted = edit_file(file, [](kdbx2_pvt& db) { delete_entries(db, 4); });
+    stages.push_back({"merge deletions", best_merge(iterations, file, deleted),
+                        0, entries, "entries/s"});
+
+    string moved = edit_file(file, [](kdbx2_pvt& db) { move_entries(db, 4); });
+    stages.push_back({"merge moves", best_merge(iterations, file, moved),
+                        0, entries, "entries/s"});
+
+    cout << "database: " << file.size() << " bytes, " << xml.size() << " bytes of XML, "
+            << gen.group_count() << " groups, " << shape.entry_count << " entries, "
+            << shape.transform_rounds << " rounds" << endl;
+    cout << "best of " << iterations << " runs" << endl << endl;
+
+    for (const stage& s : stages) {
+        print(s);
+    }
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "generator.hpp"
+
+#include <cstring>
+#include <random>
+
+#include "cryptopp/osrng.h"
+
+#include "base64.hpp"
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+#include "protected_stream.hpp"
+
+using std::ostream;
+using std::string;
+
+using CryptoPP::AutoSeededRandomPool;
+using CryptoPP::SecByteBlock;
+
+namespace kdbx
+{
+
+static const size_t SEED_SIZE = 32;
+
+static const char TEXT_CHARS[] = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+
+static const char* const TIMES =
+    "<Times>"
+    "<CreationTime>2016-01-01T00:00:00Z</CreationTime>"
+    "<LastModificationTime>2016-01-01T00:00:00Z</LastModificationTime>"
+    "<LastAccessTime>2016-01-01T00:00:00Z</LastAccessTime>"
+    "<ExpiryTime>2016-01-01T00:00:00Z</ExpiryTime>"
+    "<Expires>False</Expires>"
+    "<UsageCount>0</UsageCount>"
+    "<LocationChanged>2016-01-01T00:00:00Z</LocationChanged>"
+    "</Times>";
+
+/*
+ * Everything that changes while the XML is written. Protected values take
+ * their keystream in document order, like the reader expects.
+ */
+struct content
+{
+    const generator_options& options;
+    std::mt19937 rng;
+    protected_stream inner;
+    uint64_t offset = 0;
+    uint32_t groups = 0;
+    uint32_t group_count;
+    string xml;
+
+    content(const generator_options& options, const SecByteBlock& key, uint32_t group_count)
+        : options(options), rng(options.seed),
+            inner(protected_stream::SALSA20, key), group_count(group_count) {}
+
+    string text(size_t length)
+    {
+        std::uniform_int_distribution<size_t> pick(0, sizeof(TEXT_CHARS) - 2);
+        string out(length, ' ');
+
+        for (size_t ii = 0; ii < length; ii++) {
+            out[ii] = TEXT_CHARS[pick(rng)];
+        }
+
+        return out;
+    }
+
+    string uuid()
+    {
+        byte bytes[16];
+
+        for (size_t ii = 0; ii < sizeof(bytes); ii++) {
+            bytes[ii] = static_cast<byte>(rng());
+        }
+
+        return base64_encode(bytes, sizeof(bytes));
+    }
+
+    void field(const char* key, const string& value)
+    {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+        xml += "<String><Key>";
+        xml += key;
+        xml += "</Key>";
+
+        if (chance(rng) < options.protected_ratio) {
+            SecByteBlock data(reinterpret_cast<const byte*>(value.data()), value.size());
+            inner.apply(offset, data.data(), data.size());
+            offset += data.size();
+
+            xml += "<Value Protected=\"True\">";
+            xml += base64_encode(data.data(), data.size());
+        } else {
+            xml += "<Value>";
+            xml += value;
+        }
+
+        xml += "</Value></String>";
+    }
+
+    void entry(uint32_t index)
+    {
+        xml += "<Entry><UUID>";
+        xml += uuid();
+        xml += "</UUID><IconID>0</IconID>";
+        xml += TIMES;
+
+        size_t size = options.field_size;
+        field("Title", text(size));
+        field("UserName", text(size));
+        field("Password", text(size));
+        field("URL", "https://site" + std::to_string(index % 997) + ".example.com/login");
+        field("Notes", text(size));
+
+        for (uint32_t ii = 0; ii < options.custom_fields; ii++) {
+            field(("Field " + std::to_string(ii)).c_str(), text(size));
+        }
+
+        xml += "</Entry>";
+    }
+
+    void group(uint32_t depth)
+    {
+        uint32_t index = groups++;
+
+        xml += "<Group><UUID>";
+        xml += uuid();
+        xml += "</UUID><Name>Group ";
+        xml += std::to_string(index);
+        xml += "</Name><Notes></Notes><IconID>48</IconID>";
+        xml += TIMES;
+        xml += "<IsExpanded>True</IsExpanded>"
+                "<EnableAutoType>null</EnableAutoType>"
+                "<EnableSearching>null</EnableSearching>"
+                "<LastTopVisibleEntry>AAAAAAAAAAAAAAAAAAAAAA==</LastTopVisibleEntry>";
+
+        // Entries are dealt round-robin over groups in pre-order
+        for (uint32_t ii = index; ii < options.entry_count; ii += group_count) {
+            entry(ii);
+        }
+
+        if (depth < options.group_depth) {
+            for (uint32_t ii = 0; ii < options.group_fanout; ii++) {
+                group(depth + 1);
+            }
+        }
+
+        xml += "</Group>";
+    }
+};
+
+generator::generator(const generator_options& options)
+    : _options(options)
+{
+
+}
+
+size_t generator::group_count() const
+{
+    size_t count = 0;
+    size_t level = 1;
+
+    for (uint32_t ii = 0; ii <= _options.group_depth; ii++) {
+        count += level;
+        level *= _options.group_fanout;
+    }
+
+    return count;
+}
+
+void generator::write(ostream& out, const string& password) const
+{
+    kdbx2 db;
+    kdbx2_pvt& pvt = kdbx2_pvt::of(db);
+
+    pvt.compression_flags = _options.compress ? kdbx2_pvt::Compression::GZIP
+                                              : kdbx2_pvt::Compression::NONE;
+    pvt.transform_rounds = _options.transform_rounds;
+    pvt.inner_random_stream_id = protected_stream::SALSA20;
+
+    AutoSeededRandomPool rng;
+    pvt.protected_stream_key.New(SEED_SIZE);
+    rng.GenerateBlock(pvt.protected_stream_key.data(), pvt.protected_stream_key.size());
+
+    // The XML, with protected values encrypted as if it had been loaded.
+    // The save fills in the header hash.
+    content body(_options, pvt.protected_stream_key, static_cast<uint32_t>(group_count()));
+
+    body.xml = "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>"
+                "<KeePassFile><Meta><Generator>kdbx_bench</Generator><HeaderHash/>"
+                "<DatabaseName>Benchmark</DatabaseName>"
+                "<MemoryProtection><ProtectTitle>False</ProtectTitle>"
+                "<ProtectUserName>False</ProtectUserName>"
+                "<ProtectPassword>True</ProtectPassword>"
+                "<ProtectURL>False</ProtectURL>"
+                "<ProtectNotes>False</ProtectNotes></MemoryProtection>"
+                "<RecycleBinEnabled>False</RecycleBinEnabled>"
+                "</Meta><Root>";
+    body.group(0);
+    body.xml += "<DeletedObjects/></Root></KeePassFile>";
+
+    char* text = static_cast<char*>(pvt.arena.allocate(body.xml.size()));
+    std::memcpy(text, body.xml.data(), body.xml.size());
+    pvt.parse_xml(text, body.xml.size());
+    pvt.build_tree();
+
+    // The save picks fresh seeds and writes the header and body the way
+    // any saved database is written
+    db.push_key(password);
+    db.save(out);
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace kdbx
+{
+
+struct generator_options
+{
+    // Levels of groups below the root group, each group having fanout
+    // children
+    uint32_t group_depth = 2;
+    uint32_t group_fanout = 4;
+
+    // Entries are dealt round-robin over every group
+    uint32_t entry_count = 1000;
+
+    // Length of each generated field value, and custom fields per entry
+    size_t field_size = 32;
+    uint32_t custom_fields = 2;
+
+    // Share of string fields written as protected values
+    double protected_ratio = 0.2;
+
+    bool compress = true;
+    uint64_t transform_rounds = 6000;
+
+    // Seeds the contents, so equal options give equal XML
+    uint32_t seed = 1;
+};
+
+/*
+ * Writes a synthetic KDBX 3.1 database, encrypted with a single password,
+ * for benchmarks. The XML is saved by kdbx2::save(), so the header seeds
+ * are random every time.
+ */
+class generator
+{
+private:
+    generator(const generator&);
+    generator& operator=(const generator&);
+
+    generator_options _options;
+
+public:
+    explicit generator(const generator_options& options);
+
+    // Number of groups written, including the root group
+    size_t group_count() const;
+
+    void write(std::ostream& out, const std::string& password) const;
+};
+
+}
+
+#endif
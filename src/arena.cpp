@@ -0,0 +1,144 @@
+#include "arena.hpp"
+
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+
+#include "cryptopp/misc.h"
+
+namespace kdbx
+{
+
+static size_t align(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+secure_arena::secure_arena(size_t chunk_size)
+    : _chunk_size(chunk_size)
+{
+
+}
+
+secure_arena::~secure_arena()
+{
+    clear();
+}
+
+secure_arena::chunk& secure_arena::new_chunk(size_t size)
+{
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (data == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+#ifdef MADV_DONTDUMP
+    madvise(data, size, MADV_DONTDUMP);
+#endif
+
+    // Locking fails under a low RLIMIT_MEMLOCK, which is fine
+    chunk c;
+    c.data = static_cast<char*>(data);
+    c.size = size;
+    c.used = 0;
+    c.locked = mlock(data, size) == 0;
+
+    _chunks.push_back(c);
+    return _chunks.back();
+}
+
+void secure_arena::release(chunk& c)
+{
+    CryptoPP::SecureWipeBuffer(reinterpret_cast<byte*>(c.data), c.used);
+
+    if (c.locked) {
+        munlock(c.data, c.size);
+    }
+
+    munmap(c.data, c.size);
+}
+
+void* secure_arena::allocate(size_t size)
+{
+    size = align(size ? size : 1, ALIGNMENT);
+
+    if (_chunks.empty() || _chunks.back().size - _chunks.back().used < size) {
+        // Oversized requests get a chunk of their own
+        new_chunk(align(size > _chunk_size ? size : _chunk_size, _chunk_size));
+    }
+
+    chunk& c = _chunks.back();
+    void* ptr = c.data + c.used;
+    c.used += size;
+    return ptr;
+}
+
+void* secure_arena::reallocate_last(void* ptr, size_t old_size, size_t new_size)
+{
+    old_size = align(old_size ? old_size : 1, ALIGNMENT);
+    new_size = align(new_size ? new_size : 1, ALIGNMENT);
+
+    chunk& last = _chunks.back();
+    char* start = static_cast<char*>(ptr);
+
+    if (start + old_size == last.data + last.used
+            && static_cast<size_t>(start - last.data) + new_size <= last.size) {
+        last.used = static_cast<size_t>(start - last.data) + new_size;
+        return ptr;
+    }
+
+    size_t index = _chunks.size() - 1;
+    void* moved = allocate(new_size);
+    std::memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+
+    // A block that had a chunk to itself goes back right away
+    chunk& old = _chunks[index];
+
+    if (start == old.data && old.used == old_size) {
+        release(old);
+        _chunks.erase(_chunks.begin() + static_cast<std::ptrdiff_t>(index));
+    } else {
+        CryptoPP::SecureWipeBuffer(reinterpret_cast<byte*>(start), old_size);
+
+        if (start + old_size == old.data + old.used) {
+            old.used -= old_size;
+        }
+    }
+
+    return moved;
+}
+
+void secure_arena::clear()
+{
+    for (chunk& c : _chunks) {
+        release(c);
+    }
+
+    _chunks.clear();
+}
+
+size_t secure_arena::used() const
+{
+    size_t total = 0;
+
+    for (const chunk& c : _chunks) {
+        total += c.used;
+    }
+
+    return total;
+}
+
+size_t secure_arena::capacity() const
+{
+    size_t total = 0;
+
+    for (const chunk& c : _chunks) {
+        total += c.size;
+    }
+
+    return total;
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP 1
+#include <cstddef>
+#include <vector>
+
+namespace kdbx
+{
+
+/*
+ * Bump allocator for memory holding decrypted data.
+ *
+ * Memory comes in large chunks mapped straight from the kernel, locked
+ * where the limits allow it and kept out of core dumps. Nothing is freed
+ * on its own; clear() and the destructor zero every chunk in one pass and
+ * give them back.
+ */
+class secure_arena
+{
+private:
+    secure_arena(const secure_arena&);
+    secure_arena& operator=(const secure_arena&);
+
+    struct chunk
+    {
+        char* data;
+        size_t size;
+        size_t used;
+        bool locked;
+    };
+
+    size_t _chunk_size;
+    std::vector<chunk> _chunks;
+
+    chunk& new_chunk(size_t size);
+    void release(chunk& c);
+
+public:
+    static const size_t ALIGNMENT = 16;
+    static const size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
+    explicit secure_arena(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+    ~secure_arena();
+
+    // Throws std::bad_alloc when the kernel has no more memory
+    void* allocate(size_t size);
+
+    // Resizes the latest allocation, in place if there is room. When it
+    // moves, the old copy is wiped.
+    void* reallocate_last(void* ptr, size_t old_size, size_t new_size);
+
+    void clear();
+
+    // Bytes handed out and bytes mapped
+    size_t used() const;
+    size_t capacity() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,429 @@
+#include "argon2.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "cryptopp/blake2.h"
+#include "cryptopp/misc.h"
+
+#include "barrier.hpp"
+#include "errors.hpp"
+
+using CryptoPP::BLAKE2b;
+using CryptoPP::SecBlock;
+using CryptoPP::SecByteBlock;
+using CryptoPP::word64;
+
+namespace kdbx
+{
+
+static const uint32_t SYNC_POINTS = 4;
+static const size_t BLOCK_SIZE = 1024;
+static const size_t BLOCK_WORDS = BLOCK_SIZE / 8;
+static const size_t PREHASH_SIZE = 64;
+
+static const uint32_t MAX_LANES = 0xFFFFFF;
+static const uint32_t MIN_MEMORY_BLOCKS = 2 * SYNC_POINTS;
+
+struct block
+{
+    word64 v[BLOCK_WORDS];
+};
+
+static void store32(byte* out, uint32_t value)
+{
+    // Argon2 is defined little endian, like the rest of the format
+    std::memcpy(out, &value, sizeof(value));
+}
+
+static void hash_update32(BLAKE2b& hash, uint32_t value)
+{
+    byte bytes[sizeof(value)];
+    store32(bytes, value);
+    hash.Update(bytes, sizeof(bytes));
+}
+
+static void hash_update_block(BLAKE2b& hash, const SecByteBlock& data)
+{
+    hash_update32(hash, static_cast<uint32_t>(data.size()));
+    hash.Update(data.data(), data.size());
+}
+
+// H', BLAKE2b stretched to any output length
+static void hash_long(byte* out, uint32_t length, const byte* in, size_t in_length)
+{
+    if (length <= BLAKE2b::DIGESTSIZE) {
+        BLAKE2b hash(false, length);
+        hash_update32(hash, length);
+        hash.Update(in, in_length);
+        hash.Final(out);
+        return;
+    }
+
+    // Each digest contributes its first half, except the last one
+    byte digest[BLAKE2b::DIGESTSIZE];
+    BLAKE2b hash;
+    hash_update32(hash, length);
+    hash.Update(in, in_length);
+    hash.Final(digest);
+
+    std::memcpy(out, digest, BLAKE2b::DIGESTSIZE / 2);
+    out += BLAKE2b::DIGESTSIZE / 2;
+    uint32_t remaining = length - BLAKE2b::DIGESTSIZE / 2;
+
+    while (remaining > BLAKE2b::DIGESTSIZE) {
+        hash.CalculateDigest(digest, digest, sizeof(digest));
+        std::memcpy(out, digest, BLAKE2b::DIGESTSIZE / 2);
+        out += BLAKE2b::DIGESTSIZE / 2;
+        remaining -= BLAKE2b::DIGESTSIZE / 2;
+    }
+
+    BLAKE2b last(false, remaining);
+    last.CalculateDigest(out, digest, sizeof(digest));
+
+    CryptoPP::SecureWipeBuffer(digest, sizeof(digest));
+}
+
+//
+// Compression function
+//
+static inline word64 rotr(word64 x, unsigned n)
+{
+    return (x >> n) | (x << (64 - n));
+}
+
+static inline word64 blamka(word64 x, word64 y)
+{
+    word64 product = (x & 0xFFFFFFFF) * (y & 0xFFFFFFFF);
+    return x + y + 2 * product;
+}
+
+static inline void mix(word64& a, word64& b, word64& c, word64& d)
+{
+    a = blamka(a, b);
+    d = rotr(d ^ a, 32);
+    c = blamka(c, d);
+    b = rotr(b ^ c, 24);
+    a = blamka(a, b);
+    d = rotr(d ^ a, 16);
+    c = blamka(c, d);
+    b = rotr(b ^ c, 63);
+}
+
+// One BLAKE2b round over sixteen words, picked by index
+static inline void round(word64* v, const size_t* ii)
+{
+    mix(v[ii[0]], v[ii[4]], v[ii[8]], v[ii[12]]);
+    mix(v[ii[1]], v[ii[5]], v[ii[9]], v[ii[13]]);
+    mix(v[ii[2]], v[ii[6]], v[ii[10]], v[ii[14]]);
+    mix(v[ii[3]], v[ii[7]], v[ii[11]], v[ii[15]]);
+    mix(v[ii[0]], v[ii[5]], v[ii[10]], v[ii[15]]);
+    mix(v[ii[1]], v[ii[6]], v[ii[11]], v[ii[12]]);
+    mix(v[ii[2]], v[ii[7]], v[ii[8]], v[ii[13]]);
+    mix(v[ii[3]], v[ii[4]], v[ii[9]], v[ii[14]]);
+}
+
+// G(prev, ref), XORed into next on passes after the first
+static void fill_block(const block& prev, const block& ref, block& next, bool with_xor)
+{
+    block r;
+    block t;
+
+    for (size_t ii = 0; ii < BLOCK_WORDS; ii++) {
+        r.v[ii] = prev.v[ii] ^ ref.v[ii];
+        t.v[ii] = with_xor ? r.v[ii] ^ next.v[ii] : r.v[ii];
+    }
+
+    size_t index[16];
+
+    // Rows of sixteen words
+    for (size_t row = 0; row < 8; row++) {
+        for (size_t ii = 0; ii < 16; ii++) {
+            index[ii] = row * 16 + ii;
+        }
+
+        round(r.v, index);
+    }
+
+    // Columns of pairs of words
+    for (size_t column = 0; column < 8; column++) {
+        for (size_t ii = 0; ii < 8; ii++) {
+            index[2 * ii] = ii * 16 + column * 2;
+            index[2 * ii + 1] = ii * 16 + column * 2 + 1;
+        }
+
+        round(r.v, index);
+    }
+
+    for (size_t ii = 0; ii < BLOCK_WORDS; ii++) {
+        next.v[ii] = t.v[ii] ^ r.v[ii];
+    }
+}
+
+//
+// Memory filling
+//
+struct instance
+{
+    block* memory;
+    uint32_t lanes;
+    uint32_t lane_length;
+    uint32_t segment_length;
+    uint32_t memory_blocks;
+    uint32_t passes;
+    uint32_t type;
+    uint32_t version;
+
+    uint32_t reference_index(uint32_t pass, uint32_t slice, uint32_t index,
+                                uint32_t pseudo_random, bool same_lane) const;
+    void fill_segment(uint32_t pass, uint32_t slice, uint32_t lane) const;
+};
+
+// Maps a pseudo random value onto the blocks a position may reference
+uint32_t instance::reference_index(uint32_t pass, uint32_t slice, uint32_t index,
+                                    uint32_t pseudo_random, bool same_lane) const
+{
+    uint32_t area;
+
+    if (pass == 0) {
+        if (slice == 0) {
+            area = index - 1;
+        } else if (same_lane) {
+            area = slice * segment_length + index - 1;
+        } else {
+            area = slice * segment_length - (index == 0 ? 1 : 0);
+        }
+    } else if (same_lane) {
+        area = lane_length - segment_length + index - 1;
+    } else {
+        area = lane_length - segment_length - (index == 0 ? 1 : 0);
+    }
+
+    uint64_t relative = pseudo_random;
+    relative = (relative * relative) >> 32;
+    relative = area - 1 - ((area * relative) >> 32);
+
+    uint32_t start = 0;
+
+    if (pass != 0 && slice != SYNC_POINTS - 1) {
+        start = (slice + 1) * segment_length;
+    }
+
+    return static_cast<uint32_t>((start + relative) % lane_length);
+}
+
+void instance::fill_segment(uint32_t pass, uint32_t slice, uint32_t lane) const
+{
+    // Argon2id picks references independently of the data for the first
+    // half of the first pass
+    bool independent = type == argon2_parameters::ARGON2ID && pass == 0
+                        && slice < SYNC_POINTS / 2;
+
+    block zero;
+    block input;
+    block addresses;
+
+    if (independent) {
+        std::memset(&zero, 0, sizeof(zero));
+        std::memset(&input, 0, sizeof(input));
+
+        input.v[0] = pass;
+        input.v[1] = lane;
+        input.v[2] = slice;
+        input.v[3] = memory_blocks;
+        input.v[4] = passes;
+        input.v[5] = type;
+    }
+
+    auto next_addresses = [&] {
+        input.v[6]++;
+        fill_block(zero, input, addresses, false);
+        fill_block(zero, addresses, addresses, false);
+    };
+
+    // The first two blocks of each lane are already there
+    uint32_t start = 0;
+
+    if (pass == 0 && slice == 0) {
+        start = 2;
+
+        if (independent) {
+            next_addresses();
+        }
+    }
+
+    uint32_t current = lane * lane_length + slice * segment_length + start;
+    uint32_t previous = current % lane_length == 0 ? current + lane_length - 1 : current - 1;
+
+    for (uint32_t ii = start; ii < segment_length; ii++, current++, previous++) {
+        if (current % lane_length == 1) {
+            previous = current - 1;
+        }
+
+        word64 pseudo_random;
+
+        if (independent) {
+            if (ii % BLOCK_WORDS == 0) {
+                next_addresses();
+            }
+
+            pseudo_random = addresses.v[ii % BLOCK_WORDS];
+        } else {
+            pseudo_random = memory[previous].v[0];
+        }
+
+        uint32_t ref_lane = static_cast<uint32_t>((pseudo_random >> 32) % lanes);
+
+        if (pass == 0 && slice == 0) {
+            ref_lane = lane;
+        }
+
+        uint32_t ref_index = reference_index(pass, slice, ii,
+                                                static_cast<uint32_t>(pseudo_random),
+                                                ref_lane == lane);
+
+        const block& ref = memory[static_cast<size_t>(ref_lane) * lane_length + ref_index];
+
+        // Version 1.0 overwrote blocks on every pass
+        bool with_xor = version != argon2_parameters::VERSION_10 && pass != 0;
+        fill_block(memory[previous], ref, memory[current], with_xor);
+    }
+}
+
+argon2::argon2(const argon2_parameters& params, uint32_t threads)
+    : _params(params), _threads(threads)
+{
+    if (_params.type != argon2_parameters::ARGON2D
+            && _params.type != argon2_parameters::ARGON2ID) {
+        throw parse_error("unsupported argon2 type");
+    }
+
+    if (_params.version != argon2_parameters::VERSION_10
+            && _params.version != argon2_parameters::VERSION_13) {
+        throw parse_error("unsupported argon2 version");
+    }
+
+    if (_params.parallelism == 0 || _params.parallelism > MAX_LANES) {
+        throw parse_error("argon2 parallelism out of range");
+    }
+
+    if (_params.iterations == 0 || _params.iterations > 0xFFFFFFFF) {
+        throw parse_error("argon2 iterations out of range");
+    }
+
+    if (_params.salt.size() < 8) {
+        throw parse_error("argon2 salt too short");
+    }
+
+    uint64_t kib = _params.memory / 1024;
+
+    if (kib < MIN_MEMORY_BLOCKS * _params.parallelism || kib > 0xFFFFFFFF) {
+        throw parse_error("argon2 memory out of range");
+    }
+
+    if (_threads == 0) {
+        _threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _threads = std::min(_threads, _params.parallelism);
+}
+
+void argon2::apply(const byte* password, size_t length, byte* out) const
+{
+    uint32_t lanes = _params.parallelism;
+    uint32_t kib = static_cast<uint32_t>(_params.memory / 1024);
+
+    instance inst;
+    inst.lanes = lanes;
+    inst.segment_length = kib / (lanes * SYNC_POINTS);
+    inst.lane_length = inst.segment_length * SYNC_POINTS;
+    inst.memory_blocks = inst.lane_length * lanes;
+    inst.passes = static_cast<uint32_t>(_params.iterations);
+    inst.type = _params.type;
+    inst.version = _params.version;
+
+    // Wiped when it goes out of scope
+    SecBlock<word64> memory(static_cast<size_t>(inst.memory_blocks) * BLOCK_WORDS);
+    inst.memory = reinterpret_cast<block*>(memory.data());
+
+    // H0, the prehash of every parameter
+    byte seed[PREHASH_SIZE + 2 * sizeof(uint32_t)];
+
+    {
+        BLAKE2b hash;
+        hash_update32(hash, lanes);
+        hash_update32(hash, static_cast<uint32_t>(KEY_SIZE));
+        hash_update32(hash, kib);
+        hash_update32(hash, inst.passes);
+        hash_update32(hash, inst.version);
+        hash_update32(hash, inst.type);
+        hash_update32(hash, static_cast<uint32_t>(length));
+        hash.Update(password, length);
+        hash_update_block(hash, _params.salt);
+        hash_update_block(hash, _params.secret);
+        hash_update_block(hash, _params.associated);
+        hash.Final(seed);
+    }
+
+    // The first two blocks of every lane come straight from H0
+    for (uint32_t lane = 0; lane < lanes; lane++) {
+        for (uint32_t ii = 0; ii < 2; ii++) {
+            store32(seed + PREHASH_SIZE, ii);
+            store32(seed + PREHASH_SIZE + sizeof(uint32_t), lane);
+
+            block& target = inst.memory[static_cast<size_t>(lane) * inst.lane_length + ii];
+            hash_long(reinterpret_cast<byte*>(target.v), BLOCK_SIZE, seed, sizeof(seed));
+        }
+    }
+
+    CryptoPP::SecureWipeBuffer(seed, sizeof(seed));
+
+    // Each thread fills the same lanes of every slice, and the threads meet
+    // on the barrier before the next slice reads what they wrote
+    barrier slice_done(_threads);
+
+    auto fill = [&inst, &slice_done, lanes, this](uint32_t first) {
+        for (uint32_t pass = 0; pass < inst.passes; pass++) {
+            for (uint32_t slice = 0; slice < SYNC_POINTS; slice++) {
+                for (uint32_t lane = first; lane < lanes; lane += _threads) {
+                    inst.fill_segment(pass, slice, lane);
+                }
+
+                slice_done.wait();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(_threads - 1);
+
+    for (uint32_t ii = 1; ii < _threads; ii++) {
+        workers.emplace_back(fill, ii);
+    }
+
+    fill(0);
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // XOR the last block of every lane and hash it down to the key
+    block final_block = inst.memory[inst.lane_length - 1];
+
+    for (uint32_t lane = 1; lane < lanes; lane++) {
+        const block& last = inst.memory[static_cast<size_t>(lane) * inst.lane_length
+                                        + inst.lane_length - 1];
+
+        for (size_t ii = 0; ii < BLOCK_WORDS; ii++) {
+            final_block.v[ii] ^= last.v[ii];
+        }
+    }
+
+    hash_long(out, KEY_SIZE, reinterpret_cast<const byte*>(final_block.v), BLOCK_SIZE);
+
+    CryptoPP::SecureWipeBuffer(final_block.v, BLOCK_WORDS);
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef ARGON2_HPP
+#define ARGON2_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+struct argon2_parameters
+{
+    enum Type
+    {
+        ARGON2D = 0,
+        ARGON2ID = 2,
+    };
+
+    enum Version
+    {
+        VERSION_10 = 0x10,
+        VERSION_13 = 0x13,
+    };
+
+    uint32_t type = ARGON2D;
+    uint32_t version = VERSION_13;
+    CryptoPP::SecByteBlock salt;
+    CryptoPP::SecByteBlock secret;
+    CryptoPP::SecByteBlock associated;
+
+    // Memory in bytes, as KDBX 4 stores it
+    uint64_t memory = 0;
+    uint64_t iterations = 0;
+    uint32_t parallelism = 0;
+};
+
+/*
+ * The Argon2d and Argon2id key derivations used by KDBX 4.
+ *
+ * Memory is split into one lane per degree of parallelism, and each pass
+ * over it into four slices. Within a slice the lanes only read blocks from
+ * finished slices, so the lanes are shared out over threads started once per
+ * derivation, which meet on a barrier between slices.
+ */
+class argon2
+{
+private:
+    argon2(const argon2&);
+    argon2& operator=(const argon2&);
+
+    argon2_parameters _params;
+    uint32_t _threads;
+
+public:
+    static const size_t KEY_SIZE = 32;
+
+    // Throws parse_error for parameters outside what Argon2 allows. Zero
+    // threads means one per lane, up to one per hardware thread.
+    explicit argon2(const argon2_parameters& params, uint32_t threads = 0);
+
+    // Derives KEY_SIZE bytes from password into out
+    void apply(const byte* password, size_t length, byte* out) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,196 @@
+#include "attachment.hpp"
+#include "attachment_store.hpp"
+
+#include "future.hpp"
+
+#include "binarybuf.hpp"
+#include "errors.hpp"
+#include "gzipbuf.hpp"
+#include "kdbx_pvt.hpp"
+
+using std::ostream;
+
+using CryptoPP::SecByteBlock;
+
+namespace kdbx
+{
+
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+/*
+ * The contents of one attachment, inflated as they are read if they were
+ * stored compressed.
+ */
+class contents_reader
+{
+private:
+    binarybuf _source;
+    std::istream _in;
+    std::unique_ptr<gzipbuf> _inflated;
+
+public:
+    contents_reader(const binary_record& record, const protected_stream* stream)
+        : _source(record, stream), _in(&_source)
+    {
+        _in.exceptions(std::ios::badbit);
+
+        if (record.compressed) {
+            _inflated = std::make_unique<gzipbuf>(_in);
+        }
+    }
+
+    size_t read(byte* out, size_t length)
+    {
+        std::streambuf* buffer = _inflated ? static_cast<std::streambuf*>(_inflated.get()) : &_source;
+        std::streamsize count = buffer->sgetn(reinterpret_cast<char*>(out),
+                                                static_cast<std::streamsize>(length));
+        return static_cast<size_t>(count);
+    }
+};
+
+//
+// Store
+//
+void attachment_store::build(const std::vector<binary_record>& binaries)
+{
+    clear();
+
+    _index.reserve(binaries.size());
+
+    for (const binary_record& record : binaries) {
+        _index[record.id] = &record;
+    }
+}
+
+void attachment_store::clear()
+{
+    _index.clear();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _open.clear();
+}
+
+const binary_record* attachment_store::find(uint32_t id) const
+{
+    auto found = _index.find(id);
+    return found == _index.end() ? NULL : found->second;
+}
+
+attachment_store::contents attachment_store::open(const binary_record& record,
+                                                    const protected_stream* stream) const
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        contents current = _open[record.id].lock();
+
+        if (current) {
+            return current;
+        }
+    }
+
+    // Decode without holding the lock, so other attachments can be opened
+    // meanwhile. Stored sizes are exact for uncompressed attachments and a
+    // first guess otherwise.
+    std::shared_ptr<SecByteBlock> decoded = std::make_shared<SecByteBlock>();
+    contents_reader reader(record, stream);
+
+    size_t capacity = record.length < CHUNK_SIZE ? CHUNK_SIZE : record.length;
+    size_t length = 0;
+    decoded->New(capacity);
+
+    while (true) {
+        if (length == capacity) {
+            capacity *= 2;
+            decoded->Grow(capacity);
+        }
+
+        size_t count = reader.read(decoded->data() + length, capacity - length);
+
+        if (count == 0) {
+            break;
+        }
+
+        length += count;
+    }
+
+    decoded->resize(length);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::weak_ptr<const SecByteBlock>& slot = _open[record.id];
+    contents current = slot.lock();
+
+    // Someone else finished first, so theirs is the shared copy
+    if (current) {
+        return current;
+    }
+
+    slot = decoded;
+    return decoded;
+}
+
+void attachment_store::write(const binary_record& record, const protected_stream* stream,
+                                ostream& out)
+{
+    contents_reader reader(record, stream);
+    SecByteBlock chunk(CHUNK_SIZE);
+
+    while (size_t count = reader.read(chunk.data(), chunk.size())) {
+        out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(count));
+
+        if (!out) {
+            throw write_error("unable to write attachment");
+        }
+    }
+}
+
+//
+// Handle
+//
+attachment::attachment()
+    : _db(NULL), _name(NULL), _record(NULL)
+{
+
+}
+
+attachment::attachment(const kdbx2_pvt& db, const char* name, const binary_record* record)
+    : _db(&db), _name(name), _record(record)
+{
+
+}
+
+attachment::operator bool() const
+{
+    return _record != NULL;
+}
+
+const char* attachment::name() const
+{
+    return _name;
+}
+
+uint32_t attachment::pool_id() const
+{
+    return _record->id;
+}
+
+bool attachment::is_compressed() const
+{
+    return _record->compressed;
+}
+
+size_t attachment::stored_size() const
+{
+    return _record->length;
+}
+
+void attachment::write(ostream& out) const
+{
+    attachment_store::write(*_record, _db->inner_stream.get(), out);
+}
+
+std::shared_ptr<const SecByteBlock> attachment::open() const
+{
+    return _db->attachments.open(*_record, _db->inner_stream.get());
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef ATTACHMENT_HPP
+#define ATTACHMENT_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+class kdbx2_pvt;
+struct binary_record;
+
+/*
+ * A lightweight handle to a file attached to an entry.
+ *
+ * Entries refer to attachments in the database's pool by id, and entries
+ * that refer to the same id share its contents. Nothing is decoded at
+ * load; contents are decoded, decrypted and decompressed as they are
+ * read.
+ */
+class attachment
+{
+private:
+    const kdbx2_pvt* _db;
+    const char* _name;
+    const binary_record* _record;
+
+public:
+    attachment();
+    attachment(const kdbx2_pvt& db, const char* name, const binary_record* record);
+
+    // False for failed lookups and for references to missing pool ids
+    explicit operator bool() const;
+
+    const char* name() const;
+    uint32_t pool_id() const;
+    bool is_compressed() const;
+
+    // Size as stored, which for a compressed attachment is its compressed
+    // size
+    size_t stored_size() const;
+
+    // Streams the contents to out in chunks, without ever holding all of
+    // them. Throws parse_error for damaged contents and write_error if out
+    // fails.
+    void write(std::ostream& out) const;
+
+    // The whole contents in a wiping buffer. They are decoded once and
+    // shared with every other handle to the same pool id while any of the
+    // returned pointers is alive.
+    std::shared_ptr<const CryptoPP::SecByteBlock> open() const;
+};
+
+}
+
+#endif
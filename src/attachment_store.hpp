@@ -0,0 +1,56 @@
+#ifndef ATTACHMENT_STORE_HPP
+#define ATTACHMENT_STORE_HPP 1
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "cryptopp/secblock.h"
+
+#include "meta.hpp"
+#include "protected_stream.hpp"
+
+namespace kdbx
+{
+
+/*
+ * Finds pool attachments by id and keeps the ones currently open, so
+ * entries sharing an attachment share one decoded copy. Open copies are
+ * only held weakly and go away with the last handle to them.
+ *
+ * Lookups only read, so they are safe from any thread once built; the
+ * open copies are guarded by a mutex.
+ */
+class attachment_store
+{
+private:
+    attachment_store(const attachment_store&);
+    attachment_store& operator=(const attachment_store&);
+
+    typedef std::shared_ptr<const CryptoPP::SecByteBlock> contents;
+
+    std::unordered_map<uint32_t, const binary_record*> _index;
+
+    mutable std::mutex _mutex;
+    mutable std::unordered_map<uint32_t, std::weak_ptr<const CryptoPP::SecByteBlock>> _open;
+
+public:
+    attachment_store() {}
+
+    // binaries has to stay put until the next build() or clear()
+    void build(const std::vector<binary_record>& binaries);
+    void clear();
+
+    const binary_record* find(uint32_t id) const;
+
+    contents open(const binary_record& record, const protected_stream* stream) const;
+
+    // Streams one attachment's contents to out
+    static void write(const binary_record& record, const protected_stream* stream,
+                        std::ostream& out);
+};
+
+}
+
+#endif
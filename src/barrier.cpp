@@ -0,0 +1,33 @@
+#include "barrier.hpp"
+
+using std::mutex;
+using std::unique_lock;
+
+namespace kdbx
+{
+
+barrier::barrier(size_t count)
+    : _count(count), _waiting(0), _generation(0)
+{
+
+}
+
+void barrier::wait()
+{
+    unique_lock<mutex> lock(_mutex);
+
+    if (++_waiting == _count) {
+        // The last one in starts the next generation, so the barrier can
+        // be used again straight away
+        _waiting = 0;
+        _generation++;
+        lock.unlock();
+        _released.notify_all();
+        return;
+    }
+
+    size_t generation = _generation;
+    _released.wait(lock, [this, generation] { return _generation != generation; });
+}
+
+}
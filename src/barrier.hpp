@@ -0,0 +1,36 @@
+#ifndef BARRIER_HPP
+#define BARRIER_HPP 1
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace kdbx
+{
+
+/*
+ * Reusable barrier, where a fixed set of threads meets between the steps
+ * of a computation they share.
+ */
+class barrier
+{
+private:
+    barrier(const barrier&);
+    barrier& operator=(const barrier&);
+
+    std::mutex _mutex;
+    std::condition_variable _released;
+    size_t _count;
+    size_t _waiting;
+    size_t _generation;
+
+public:
+    explicit barrier(size_t count);
+
+    // Blocks until count threads are waiting, then releases them all.
+    // Everything written before the wait is visible after it.
+    void wait();
+};
+
+}
+
+#endif
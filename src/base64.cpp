@@ -0,0 +1,108 @@
+#include "base64.hpp"
+
+#include <cstdint>
+
+#include "errors.hpp"
+
+using std::string;
+
+namespace kdbx
+{
+
+static const char ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const int WHITESPACE = -2;
+static const int INVALID = -1;
+
+static int decode_char(char c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    } else if (c == '+') {
+        return 62;
+    } else if (c == '/') {
+        return 63;
+    } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        return WHITESPACE;
+    }
+
+    return INVALID;
+}
+
+size_t base64_decoded_size(const char* text, size_t length)
+{
+    size_t digits = 0;
+
+    for (size_t ii = 0; ii < length; ii++) {
+        if (decode_char(text[ii]) >= 0) {
+            digits++;
+        }
+    }
+
+    return (digits / 4) * 3 + (digits % 4 ? digits % 4 - 1 : 0);
+}
+
+size_t base64_decode(const char* text, size_t length, byte* out)
+{
+    size_t written = 0;
+    uint32_t accumulator = 0;
+    int bits = 0;
+    bool padding = false;
+
+    for (size_t ii = 0; ii < length; ii++) {
+        if (text[ii] == '=') {
+            padding = true;
+            continue;
+        }
+
+        int value = decode_char(text[ii]);
+
+        if (value == WHITESPACE) {
+            continue;
+        } else if (value == INVALID || padding) {
+            throw parse_error("invalid base64");
+        }
+
+        accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+
+        if (bits >= 8) {
+            bits -= 8;
+            out[written++] = static_cast<byte>(accumulator >> bits);
+        }
+    }
+
+    return written;
+}
+
+string base64_encode(const byte* data, size_t length)
+{
+    string encoded;
+    encoded.reserve((length + 2) / 3 * 4);
+
+    for (size_t ii = 0; ii < length; ii += 3) {
+        uint32_t group = static_cast<uint32_t>(data[ii]) << 16;
+
+        if (ii + 1 < length) {
+            group |= static_cast<uint32_t>(data[ii + 1]) << 8;
+        }
+
+        if (ii + 2 < length) {
+            group |= data[ii + 2];
+        }
+
+        encoded.push_back(ALPHABET[(group >> 18) & 0x3F]);
+        encoded.push_back(ALPHABET[(group >> 12) & 0x3F]);
+        encoded.push_back(ii + 1 < length ? ALPHABET[(group >> 6) & 0x3F] : '=');
+        encoded.push_back(ii + 2 < length ? ALPHABET[group & 0x3F] : '=');
+    }
+
+    return encoded;
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef BASE64_HPP
+#define BASE64_HPP 1
+#include <cstddef>
+#include <string>
+#include "cryptopp/config.h"
+
+namespace kdbx
+{
+
+// Number of bytes encoded by text, ignoring whitespace
+size_t base64_decoded_size(const char* text, size_t length);
+
+// Decodes text into out, which must hold base64_decoded_size() bytes
+size_t base64_decode(const char* text, size_t length, byte* out);
+
+std::string base64_encode(const byte* data, size_t length);
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "batch.hpp"
+
+#include "future.hpp"
+
+#include "semaphore.hpp"
+#include "work_pool.hpp"
+
+using std::string;
+using std::vector;
+
+namespace kdbx
+{
+
+batch_loader::batch_loader(size_t threads, size_t max_kdfs)
+    : _threads(threads)
+{
+    if (max_kdfs) {
+        _kdf_slots = std::make_shared<semaphore>(max_kdfs);
+    }
+}
+
+batch_loader::~batch_loader()
+{
+
+}
+
+void batch_loader::set_key_cache(std::shared_ptr<key_cache> cache)
+{
+    _cache = std::move(cache);
+}
+
+void batch_loader::load_one(const load_job& job, load_result& result) const
+{
+    result.path = job.path;
+
+    try {
+        std::unique_ptr<kdbx2> db = std::make_unique<kdbx2>();
+        db->set_key_cache(_cache);
+        db->set_kdf_limit(_kdf_slots);
+
+        for (const string& key : job.keys) {
+            db->push_key(key);
+        }
+
+        db->load_file(job.path);
+        result.db = std::move(db);
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+}
+
+vector<load_result> batch_loader::load(const vector<load_job>& jobs) const
+{
+    vector<load_result> results(jobs.size());
+    vector<work_pool::task> tasks;
+    tasks.reserve(jobs.size());
+
+    for (size_t ii = 0; ii < jobs.size(); ii++) {
+        const load_job* job = &jobs[ii];
+        load_result* result = &results[ii];
+        tasks.push_back([this, job, result] { load_one(*job, *result); });
+    }
+
+    work_pool pool(_threads);
+    pool.run(std::move(tasks));
+
+    return results;
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP 1
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kdbx.hpp"
+
+namespace kdbx
+{
+
+class semaphore;
+
+struct load_job
+{
+    std::string path;
+    std::vector<std::string> keys;
+};
+
+struct load_result
+{
+    std::string path;
+
+    // NULL if the load failed
+    std::unique_ptr<kdbx2> db;
+    std::string error;
+
+    explicit operator bool() const { return static_cast<bool>(db); }
+};
+
+/*
+ * Loads many databases at once on a work_pool.
+ *
+ * Each job runs the whole load (header, key transformation, decryption and
+ * XML) on one worker. Failures are reported per job. Key transformations
+ * can be limited separately from the number of threads, since they are the
+ * part that pins a core for a long time.
+ */
+class batch_loader
+{
+private:
+    batch_loader(const batch_loader&);
+    batch_loader& operator=(const batch_loader&);
+
+    size_t _threads;
+    std::shared_ptr<semaphore> _kdf_slots;
+    std::shared_ptr<key_cache> _cache;
+
+    void load_one(const load_job& job, load_result& result) const;
+
+public:
+    // Zero threads means one per hardware thread, zero KDFs means no limit
+    explicit batch_loader(size_t threads = 0, size_t max_kdfs = 0);
+    ~batch_loader();
+
+    void set_key_cache(std::shared_ptr<key_cache> cache);
+
+    // Results are returned in the same order as the jobs
+    std::vector<load_result> load(const std::vector<load_job>& jobs) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "binarybuf.hpp"
+
+#include <cstring>
+
+#include "base64.hpp"
+#include "errors.hpp"
+
+namespace kdbx
+{
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+binarybuf::binarybuf(const binary_record& record, const protected_stream* stream)
+    : _record(record), _stream(stream), _text(record.data),
+        _end(record.data + (record.raw ? record.length : std::strlen(record.data)))
+{
+    if (_record.is_protected && !_stream) {
+        throw parse_error("protected attachment without inner stream");
+    }
+
+    setg(NULL, NULL, NULL);
+}
+
+binarybuf::int_type binarybuf::underflow()
+{
+    if (gptr() < egptr()) {
+        // Still have characters in the buffer
+        return traits_type::to_int_type(*gptr());
+    }
+
+    if (_text == _end) {
+        return traits_type::eof();
+    }
+
+    size_t length;
+
+    if (_record.raw) {
+        // Already decoded, so hand out the whole thing
+        length = static_cast<size_t>(_end - _text);
+        char_type* start = const_cast<char_type*>(_text);
+        setg(start, start, start + length);
+        _text = _end;
+    } else {
+        // Take whole groups of four characters, skipping whitespace, so
+        // each chunk decodes on its own
+        static const size_t CHUNK_CHARS = CHUNK_SIZE / 3 * 4;
+
+        const char* start = _text;
+        size_t significant = 0;
+
+        while (_text != _end && significant < CHUNK_CHARS) {
+            if (!is_space(*_text)) {
+                significant++;
+            }
+
+            _text++;
+        }
+
+        if (_buffer.empty()) {
+            _buffer.New(CHUNK_SIZE);
+        }
+
+        length = base64_decode(start, static_cast<size_t>(_text - start), _buffer.data());
+
+        char_type* begin = reinterpret_cast<char_type*>(_buffer.data());
+        setg(begin, begin, begin + length);
+    }
+
+    // Raw attachments are never protected by the inner stream
+    if (_record.is_protected && !_record.raw) {
+        _stream->apply(_record.protected_offset + _position,
+                        reinterpret_cast<byte*>(eback()), length);
+    }
+
+    _position += length;
+
+    if (length == 0) {
+        return traits_type::eof();
+    }
+
+    return traits_type::to_int_type(*gptr());
+}
+
+}
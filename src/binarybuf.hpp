@@ -0,0 +1,50 @@
+#ifndef BINARYBUF_HPP
+#define BINARYBUF_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include "cryptopp/secblock.h"
+
+#include "meta.hpp"
+#include "protected_stream.hpp"
+
+namespace kdbx
+{
+
+/*
+ * Reads the stored bytes of one attachment: base64 decoded and, when
+ * protected, decrypted with the inner stream, but still compressed if it
+ * was stored compressed.
+ *
+ * The text is decoded a chunk at a time, seeking the inner stream to each
+ * chunk, so nothing larger than a chunk is ever held. Raw KDBX 4
+ * attachments are handed out where they are.
+ */
+class binarybuf : public std::streambuf
+{
+private:
+    binarybuf(binarybuf&&);
+    binarybuf(const binarybuf&);
+    binarybuf& operator=(const binarybuf&);
+
+    // Decoded bytes per chunk, a whole number of base64 groups
+    static const size_t CHUNK_SIZE = 48 * 1024;
+
+    const binary_record& _record;
+    const protected_stream* _stream;
+    const char* _text;
+    const char* _end;
+    uint64_t _position = 0;
+    CryptoPP::SecByteBlock _buffer;
+
+protected:
+    int_type underflow() override;
+
+public:
+    // The stream is only used for protected attachments
+    binarybuf(const binary_record& record, const protected_stream* stream);
+};
+
+}
+
+#endif
@@ -0,0 +1,1032 @@
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cryptopp/aes.h"
+#include "cryptopp/gcm.h"
+#include "cryptopp/hmac.h"
+#include "cryptopp/osrng.h"
+
+#include "future.hpp"
+
+#include "mapped_file.hpp"
+#include "membuf.hpp"
+
+using std::istream;
+using std::string;
+using std::vector;
+
+using CryptoPP::AES;
+using CryptoPP::AutoSeededRandomPool;
+using CryptoPP::GCM;
+using CryptoPP::HMAC;
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+
+namespace kdbx
+{
+
+/*
+ * A cache file is a plaintext header, the encrypted body and a GCM tag.
+ * The header is authenticated along with the body and ties the cache to
+ * one save of the source file.
+ *
+ * The body is a cache_layout followed by flat arrays of records and one
+ * table of NUL terminated strings. Records refer to strings by offset and
+ * to each other by index, so loading is a bounds check and one pass
+ * turning offsets into pointers. The layout is native; record sizes are
+ * stored so a cache from another build is simply not used.
+ */
+static const char CACHE_MAGIC[8] = {'K', 'D', 'B', 'X', 'C', 'A', 'C', 'H'};
+static const uint32_t CACHE_VERSION = 4;
+static const size_t NONCE_SIZE = 12;
+static const size_t TAG_SIZE = 16;
+
+static const uint32_t NO_STRING = 0xFFFFFFFF;
+
+struct cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t source_size;
+    byte source_header_hash[32];
+    byte source_hash[32];
+    byte nonce[NONCE_SIZE];
+    uint32_t reserved2;
+    uint64_t body_size;
+};
+
+struct cache_layout
+{
+    uint32_t group_size;
+    uint32_t entry_size;
+    uint32_t field_size;
+    uint32_t meta_size;
+
+    uint32_t group_count;
+    uint32_t entry_count;
+    uint32_t custom_count;
+    uint32_t deleted_count;
+    uint32_t icon_count;
+    uint32_t binary_count;
+    uint32_t first_group;
+    uint32_t binary_ref_count;
+
+    // KDBX 4 keeps these in the encrypted inner header
+    uint32_t inner_stream_id;
+    uint32_t inner_stream_key;
+
+    // Offsets from the start of the body
+    uint64_t groups;
+    uint64_t entries;
+    uint64_t custom_fields;
+    uint64_t binary_refs;
+    uint64_t deleted;
+    uint64_t icons;
+    uint64_t binaries;
+    uint64_t meta;
+    uint64_t strings;
+    uint64_t strings_size;
+    uint64_t inner_stream_key_size;
+};
+
+struct flat_field
+{
+    uint32_t key;
+    uint32_t value;
+    uint64_t length;
+    uint64_t protected_offset;
+    uint32_t is_protected;
+    uint32_t reserved;
+};
+
+struct flat_group
+{
+    uint8_t id[uuid::SIZE];
+    uint32_t uuid_text;
+    uint32_t name;
+    uint32_t notes;
+    uint32_t enable_auto_type;
+    uint32_t enable_searching;
+    uint32_t last_top_visible_entry;
+    int32_t icon_id;
+    uint32_t is_expanded;
+    int64_t last_modified;
+
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t subtree_end;
+    uint32_t first_entry;
+    uint32_t entry_count;
+    uint32_t subtree_entry_end;
+    uint32_t reserved;
+};
+
+struct flat_entry
+{
+    uint8_t id[uuid::SIZE];
+    uint32_t uuid_text;
+    uint32_t parent;
+    int64_t last_modified;
+    flat_field standard[entry::STANDARD_FIELD_COUNT];
+    uint32_t first_custom;
+    uint32_t custom_count;
+    uint32_t first_binary;
+    uint32_t binary_count;
+};
+
+struct flat_binary_ref
+{
+    uint32_t key;
+    uint32_t ref;
+};
+
+struct flat_deleted
+{
+    uint8_t id[uuid::SIZE];
+    uint32_t time;
+    uint32_t reserved;
+};
+
+struct flat_icon
+{
+    uint8_t id[uuid::SIZE];
+    uint32_t data;
+    uint32_t reserved;
+    uint64_t length;
+};
+
+struct flat_binary
+{
+    uint32_t id;
+    uint32_t compressed;
+    uint32_t is_protected;
+    uint32_t data;
+    uint32_t raw;
+    uint32_t reserved;
+    uint64_t protected_offset;
+    uint64_t length;
+};
+
+struct flat_meta
+{
+    uint32_t generator;
+    uint32_t header_hash;
+    uint32_t database_name;
+    uint32_t database_description;
+    uint32_t default_user_name;
+    uint32_t color;
+
+    int64_t database_name_changed;
+    int64_t database_description_changed;
+    int64_t default_user_name_changed;
+    int64_t master_key_changed;
+    int64_t recycle_bin_changed;
+    int64_t entry_templates_group_changed;
+
+    int64_t master_key_change_rec;
+    int64_t master_key_change_force;
+    int64_t history_max_size;
+    int32_t maintenance_history_days;
+    int32_t history_max_items;
+
+    uint32_t memory_protection;
+    uint32_t recycle_bin_enabled;
+
+    uint8_t recycle_bin_uuid[uuid::SIZE];
+    uint8_t entry_templates_group[uuid::SIZE];
+    uint8_t last_selected_group[uuid::SIZE];
+    uint8_t last_top_visible_group[uuid::SIZE];
+};
+
+static int64_t encode_time(timestamp t)
+{
+    return static_cast<int64_t>(t.time_since_epoch().count());
+}
+
+static timestamp decode_time(int64_t count)
+{
+    return timestamp(timestamp::duration(count));
+}
+
+static size_t align8(size_t offset)
+{
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+/*
+ * Collects strings for the table, sharing one copy between records that
+ * point at the same text.
+ */
+class string_table
+{
+private:
+    std::unordered_map<const char*, uint32_t> _offsets;
+    SecByteBlock _data;
+    size_t _size = 0;
+
+public:
+    uint32_t add(const char* text)
+    {
+        return text ? add(text, std::strlen(text)) : NO_STRING;
+    }
+
+    // Raw bytes, e.g. KDBX 4 attachments, still get a terminating NUL
+    uint32_t add(const char* text, size_t length)
+    {
+        auto found = _offsets.find(text);
+        if (found != _offsets.end()) {
+            return found->second;
+        }
+
+        length += 1;
+
+        if (_size + length > _data.size()) {
+            size_t capacity = _data.size() ? _data.size() * 2 : 64 * 1024;
+            while (capacity < _size + length) {
+                capacity *= 2;
+            }
+
+            _data.Grow(capacity);
+        }
+
+        uint32_t offset = static_cast<uint32_t>(_size);
+        std::memcpy(_data.data() + _size, text, length - 1);
+        _data[_size + length - 1] = 0;
+        _size += length;
+
+        _offsets[text] = offset;
+        return offset;
+    }
+
+    const byte* data() const { return _data.data(); }
+    size_t size() const { return _size; }
+};
+
+static void encode_field(const string_field& field, string_table& strings, flat_field& out)
+{
+    out.key = strings.add(field.key);
+    out.value = field.key ? strings.add(field.value) : NO_STRING;
+    out.length = field.length;
+    out.protected_offset = field.protected_offset;
+    out.is_protected = field.is_protected;
+    out.reserved = 0;
+}
+
+void kdbx2_pvt::encode_cache(SecByteBlock& out) const
+{
+    string_table strings;
+
+    vector<flat_group> groups(tree.groups.size());
+    for (size_t ii = 0; ii < groups.size(); ii++) {
+        const group_record& record = tree.groups[ii];
+        flat_group& flat = groups[ii];
+
+        std::memcpy(flat.id, record.id.bytes, uuid::SIZE);
+        flat.uuid_text = strings.add(record.uuid_text);
+        flat.name = strings.add(record.name);
+        flat.notes = strings.add(record.notes);
+        flat.enable_auto_type = strings.add(record.enable_auto_type);
+        flat.enable_searching = strings.add(record.enable_searching);
+        flat.last_top_visible_entry = strings.add(record.last_top_visible_entry);
+        flat.icon_id = record.icon_id;
+        flat.is_expanded = record.is_expanded;
+        flat.last_modified = encode_time(record.last_modified);
+        flat.parent = record.parent;
+        flat.first_child = record.first_child;
+        flat.next_sibling = record.next_sibling;
+        flat.subtree_end = record.subtree_end;
+        flat.first_entry = record.first_entry;
+        flat.entry_count = record.entry_count;
+        flat.subtree_entry_end = record.subtree_entry_end;
+        flat.reserved = 0;
+    }
+
+    vector<flat_entry> entries(tree.entries.size());
+    for (size_t ii = 0; ii < entries.size(); ii++) {
+        const entry_record& record = tree.entries[ii];
+        flat_entry& flat = entries[ii];
+
+        std::memcpy(flat.id, record.id.bytes, uuid::SIZE);
+        flat.uuid_text = strings.add(record.uuid_text);
+        flat.parent = record.parent;
+        flat.last_modified = encode_time(record.last_modified);
+
+        for (int jj = 0; jj < entry::STANDARD_FIELD_COUNT; jj++) {
+            encode_field(record.standard[jj], strings, flat.standard[jj]);
+        }
+
+        flat.first_custom = record.first_custom;
+        flat.custom_count = record.custom_count;
+        flat.first_binary = record.first_binary;
+        flat.binary_count = record.binary_count;
+    }
+
+    vector<flat_field> custom_fields(tree.custom_fields.size());
+    for (size_t ii = 0; ii < custom_fields.size(); ii++) {
+        encode_field(tree.custom_fields[ii], strings, custom_fields[ii]);
+    }
+
+    vector<flat_binary_ref> binary_refs(tree.binary_refs.size());
+    for (size_t ii = 0; ii < binary_refs.size(); ii++) {
+        binary_refs[ii].key = strings.add(tree.binary_refs[ii].key);
+        binary_refs[ii].ref = tree.binary_refs[ii].ref;
+    }
+
+    vector<flat_deleted> deleted;
+    deleted.reserve(deleted_index.size());
+    deleted_index.for_each([&](const uuid& id, const char* time) {
+        flat_deleted flat;
+        std::memcpy(flat.id, id.bytes, uuid::SIZE);
+        flat.time = strings.add(time);
+        flat.reserved = 0;
+        deleted.push_back(flat);
+    });
+
+    vector<flat_icon> icons(meta.custom_icons.size());
+    for (size_t ii = 0; ii < icons.size(); ii++) {
+        const custom_icon& icon = meta.custom_icons[ii];
+        std::memcpy(icons[ii].id, icon.id.bytes, uuid::SIZE);
+        icons[ii].data = strings.add(icon.data);
+        icons[ii].reserved = 0;
+        icons[ii].length = icon.length;
+    }
+
+    vector<flat_binary> binaries(meta.binaries.size());
+    for (size_t ii = 0; ii < binaries.size(); ii++) {
+        const binary_record& binary = meta.binaries[ii];
+        binaries[ii].id = binary.id;
+        binaries[ii].compressed = binary.compressed;
+        binaries[ii].is_protected = binary.is_protected;
+        binaries[ii].data = binary.raw ? strings.add(binary.data, binary.length)
+                                        : strings.add(binary.data);
+        binaries[ii].raw = binary.raw;
+        binaries[ii].reserved = 0;
+        binaries[ii].protected_offset = binary.protected_offset;
+        binaries[ii].length = binary.length;
+    }
+
+    flat_meta m;
+    std::memset(&m, 0, sizeof(m));
+    m.generator = strings.add(meta.generator);
+    m.header_hash = strings.add(meta.header_hash);
+    m.database_name = strings.add(meta.database_name);
+    m.database_description = strings.add(meta.database_description);
+    m.default_user_name = strings.add(meta.default_user_name);
+    m.color = strings.add(meta.color);
+    m.database_name_changed = encode_time(meta.database_name_changed);
+    m.database_description_changed = encode_time(meta.database_description_changed);
+    m.default_user_name_changed = encode_time(meta.default_user_name_changed);
+    m.master_key_changed = encode_time(meta.master_key_changed);
+    m.recycle_bin_changed = encode_time(meta.recycle_bin_changed);
+    m.entry_templates_group_changed = encode_time(meta.entry_templates_group_changed);
+    m.master_key_change_rec = meta.master_key_change_rec;
+    m.master_key_change_force = meta.master_key_change_force;
+    m.history_max_size = meta.history_max_size;
+    m.maintenance_history_days = meta.maintenance_history_days;
+    m.history_max_items = meta.history_max_items;
+    m.memory_protection = (meta.memory_protection.title ? 1 : 0)
+                        | (meta.memory_protection.user_name ? 2 : 0)
+                        | (meta.memory_protection.password ? 4 : 0)
+                        | (meta.memory_protection.url ? 8 : 0)
+                        | (meta.memory_protection.notes ? 16 : 0);
+    m.recycle_bin_enabled = meta.recycle_bin_enabled;
+    std::memcpy(m.recycle_bin_uuid, meta.recycle_bin_uuid.bytes, uuid::SIZE);
+    std::memcpy(m.entry_templates_group, meta.entry_templates_group.bytes, uuid::SIZE);
+    std::memcpy(m.last_selected_group, meta.last_selected_group.bytes, uuid::SIZE);
+    std::memcpy(m.last_top_visible_group, meta.last_top_visible_group.bytes, uuid::SIZE);
+
+    // Lay the sections out one after another, each 8 byte aligned
+    cache_layout layout;
+    std::memset(&layout, 0, sizeof(layout));
+    layout.group_size = sizeof(flat_group);
+    layout.entry_size = sizeof(flat_entry);
+    layout.field_size = sizeof(flat_field);
+    layout.meta_size = sizeof(flat_meta);
+    layout.group_count = static_cast<uint32_t>(groups.size());
+    layout.entry_count = static_cast<uint32_t>(entries.size());
+    layout.custom_count = static_cast<uint32_t>(custom_fields.size());
+    layout.binary_ref_count = static_cast<uint32_t>(binary_refs.size());
+    layout.deleted_count = static_cast<uint32_t>(deleted.size());
+    layout.icon_count = static_cast<uint32_t>(icons.size());
+    layout.binary_count = static_cast<uint32_t>(binaries.size());
+    layout.first_group = tree.first_group;
+    layout.inner_stream_id = inner_random_stream_id;
+    layout.inner_stream_key = protected_stream_key.empty()
+        ? NO_STRING
+        : strings.add(reinterpret_cast<const char*>(protected_stream_key.data()),
+                      protected_stream_key.size());
+    layout.inner_stream_key_size = protected_stream_key.size();
+
+    size_t offset = align8(sizeof(layout));
+    layout.groups = offset;
+    offset = align8(offset + groups.size() * sizeof(flat_group));
+    layout.entries = offset;
+    offset = align8(offset + entries.size() * sizeof(flat_entry));
+    layout.custom_fields = offset;
+    offset = align8(offset + custom_fields.size() * sizeof(flat_field));
+    layout.binary_refs = offset;
+    offset = align8(offset + binary_refs.size() * sizeof(flat_binary_ref));
+    layout.deleted = offset;
+    offset = align8(offset + deleted.size() * sizeof(flat_deleted));
+    layout.icons = offset;
+    offset = align8(offset + icons.size() * sizeof(flat_icon));
+    layout.binaries = offset;
+    offset = align8(offset + binaries.size() * sizeof(flat_binary));
+    layout.meta = offset;
+    offset = align8(offset + sizeof(flat_meta));
+    layout.strings = offset;
+    layout.strings_size = strings.size();
+    offset += strings.size();
+
+    out.CleanNew(offset);
+    byte* base = out.data();
+
+    std::memcpy(base, &layout, sizeof(layout));
+    std::memcpy(base + layout.groups, groups.data(), groups.size() * sizeof(flat_group));
+    std::memcpy(base + layout.entries, entries.data(), entries.size() * sizeof(flat_entry));
+    std::memcpy(base + layout.custom_fields, custom_fields.data(),
+                custom_fields.size() * sizeof(flat_field));
+    std::memcpy(base + layout.binary_refs, binary_refs.data(),
+                binary_refs.size() * sizeof(flat_binary_ref));
+    std::memcpy(base + layout.deleted, deleted.data(), deleted.size() * sizeof(flat_deleted));
+    std::memcpy(base + layout.icons, icons.data(), icons.size() * sizeof(flat_icon));
+    std::memcpy(base + layout.binaries, binaries.data(), binaries.size() * sizeof(flat_binary));
+    std::memcpy(base + layout.meta, &m, sizeof(m));
+    std::memcpy(base + layout.strings, strings.data(), strings.size());
+}
+
+//
+// Decoding
+//
+
+/*
+ * Bounds checks while turning offsets into pointers. The body is
+ * authenticated, so failures mean a bug or a cache from another build
+ * rather than an attack, but a bad cache must never read out of bounds.
+ */
+struct cache_reader
+{
+    char* base;
+    size_t size;
+    const char* strings;
+    size_t strings_size;
+    bool valid = true;
+
+    const char* string(uint32_t offset)
+    {
+        if (offset == NO_STRING) {
+            return NULL;
+        }
+
+        if (offset >= strings_size) {
+            valid = false;
+            return "";
+        }
+
+        return strings + offset;
+    }
+
+    const char* bytes(uint32_t offset, uint64_t length)
+    {
+        if (offset >= strings_size || strings_size - offset <= length) {
+            valid = false;
+            return "";
+        }
+
+        return strings + offset;
+    }
+
+    template<typename T>
+    const T* array(uint64_t offset, uint32_t count)
+    {
+        if (offset % 8 != 0 || offset > size || (size - offset) / sizeof(T) < count) {
+            valid = false;
+            return NULL;
+        }
+
+        return reinterpret_cast<const T*>(base + offset);
+    }
+
+    void index(uint32_t value, size_t limit, bool allow_none)
+    {
+        if (value >= limit && !(allow_none && value == NO_INDEX)) {
+            valid = false;
+        }
+    }
+};
+
+static void decode_field(const flat_field& flat, cache_reader& reader, string_field& out)
+{
+    out.key = reader.string(flat.key);
+    out.value = out.key ? reader.string(flat.value) : NULL;
+    out.length = flat.length;
+    out.protected_offset = flat.protected_offset;
+    out.is_protected = flat.is_protected != 0;
+
+    if (out.key && (!out.value || std::strlen(out.value) != out.length)) {
+        reader.valid = false;
+    }
+}
+
+bool kdbx2_pvt::decode_cache(char* data, size_t size)
+{
+    if (size < sizeof(cache_layout)) {
+        return false;
+    }
+
+    cache_layout layout;
+    std::memcpy(&layout, data, sizeof(layout));
+
+    if (layout.group_size != sizeof(flat_group) || layout.entry_size != sizeof(flat_entry)
+            || layout.field_size != sizeof(flat_field) || layout.meta_size != sizeof(flat_meta)) {
+        return false;
+    }
+
+    if (layout.strings > size || size - layout.strings < layout.strings_size
+            || layout.strings_size == 0 || data[layout.strings + layout.strings_size - 1] != '\0') {
+        return false;
+    }
+
+    cache_reader reader;
+    reader.base = data;
+    reader.size = size;
+    reader.strings = data + layout.strings;
+    reader.strings_size = static_cast<size_t>(layout.strings_size);
+
+    const flat_group* groups = reader.array<flat_group>(layout.groups, layout.group_count);
+    const flat_entry* entries = reader.array<flat_entry>(layout.entries, layout.entry_count);
+    const flat_field* custom = reader.array<flat_field>(layout.custom_fields, layout.custom_count);
+    const flat_binary_ref* refs = reader.array<flat_binary_ref>(layout.binary_refs,
+                                                                layout.binary_ref_count);
+    const flat_deleted* deleted = reader.array<flat_deleted>(layout.deleted, layout.deleted_count);
+    const flat_icon* icons = reader.array<flat_icon>(layout.icons, layout.icon_count);
+    const flat_binary* binaries = reader.array<flat_binary>(layout.binaries, layout.binary_count);
+    const flat_meta* m = reader.array<flat_meta>(layout.meta, 1);
+
+    if (!reader.valid) {
+        return false;
+    }
+
+    uint32_t group_count = layout.group_count;
+    uint32_t entry_count = layout.entry_count;
+    uint32_t custom_count = layout.custom_count;
+    uint32_t ref_count = layout.binary_ref_count;
+
+    tree.clear();
+    tree.first_group = layout.first_group;
+    reader.index(tree.first_group, group_count, true);
+
+    tree.groups.resize(group_count);
+    for (uint32_t ii = 0; ii < group_count; ii++) {
+        const flat_group& flat = groups[ii];
+        group_record& record = tree.groups[ii];
+
+        record.node = pugi::xml_node();
+        std::memcpy(record.id.bytes, flat.id, uuid::SIZE);
+        record.uuid_text = reader.string(flat.uuid_text);
+        record.name = reader.string(flat.name);
+        record.notes = reader.string(flat.notes);
+        record.icon_id = flat.icon_id;
+        record.is_expanded = flat.is_expanded != 0;
+        record.enable_auto_type = reader.string(flat.enable_auto_type);
+        record.enable_searching = reader.string(flat.enable_searching);
+        record.last_top_visible_entry = reader.string(flat.last_top_visible_entry);
+        record.last_modified = decode_time(flat.last_modified);
+
+        record.parent = flat.parent;
+        record.first_child = flat.first_child;
+        record.next_sibling = flat.next_sibling;
+        record.subtree_end = flat.subtree_end;
+        record.first_entry = flat.first_entry;
+        record.entry_count = flat.entry_count;
+        record.subtree_entry_end = flat.subtree_entry_end;
+
+        reader.index(record.parent, group_count, true);
+        reader.index(record.first_child, group_count, true);
+        reader.index(record.next_sibling, group_count, true);
+        reader.index(record.subtree_end, group_count + 1, false);
+        reader.index(record.first_entry, entry_count + 1, false);
+        reader.index(record.subtree_entry_end, entry_count + 1, false);
+
+        if (record.subtree_end <= ii || record.subtree_entry_end < record.first_entry
+                || record.entry_count > record.subtree_entry_end - record.first_entry) {
+            reader.valid = false;
+        }
+    }
+
+    tree.entries.resize(entry_count);
+    for (uint32_t ii = 0; ii < entry_count; ii++) {
+        const flat_entry& flat = entries[ii];
+        entry_record& record = tree.entries[ii];
+
+        record.node = pugi::xml_node();
+        std::memcpy(record.id.bytes, flat.id, uuid::SIZE);
+        record.uuid_text = reader.string(flat.uuid_text);
+        record.parent = flat.parent;
+        record.last_modified = decode_time(flat.last_modified);
+
+        for (int jj = 0; jj < entry::STANDARD_FIELD_COUNT; jj++) {
+            decode_field(flat.standard[jj], reader, record.standard[jj]);
+        }
+
+        record.first_custom = flat.first_custom;
+        record.custom_count = flat.custom_count;
+        record.first_binary = flat.first_binary;
+        record.binary_count = flat.binary_count;
+
+        reader.index(record.parent, group_count, false);
+
+        if (record.first_custom > custom_count
+                || record.custom_count > custom_count - record.first_custom
+                || record.first_binary > ref_count
+                || record.binary_count > ref_count - record.first_binary) {
+            reader.valid = false;
+        }
+    }
+
+    tree.custom_fields.resize(custom_count);
+    for (uint32_t ii = 0; ii < custom_count; ii++) {
+        decode_field(custom[ii], reader, tree.custom_fields[ii]);
+
+        if (!tree.custom_fields[ii].key) {
+            reader.valid = false;
+        }
+    }
+
+    tree.binary_refs.resize(ref_count);
+    for (uint32_t ii = 0; ii < ref_count; ii++) {
+        tree.binary_refs[ii].key = reader.string(refs[ii].key);
+        tree.binary_refs[ii].ref = refs[ii].ref;
+
+        if (!tree.binary_refs[ii].key) {
+            reader.valid = false;
+        }
+    }
+
+    inner_random_stream_id = layout.inner_stream_id;
+    if (layout.inner_stream_key != NO_STRING) {
+        const char* stream_key = reader.bytes(layout.inner_stream_key, layout.inner_stream_key_size);
+
+        if (reader.valid) {
+            protected_stream_key.Assign(reinterpret_cast<const byte*>(stream_key),
+                                        static_cast<size_t>(layout.inner_stream_key_size));
+        }
+    }
+
+    deleted_index.clear();
+    deleted_index.reserve(layout.deleted_count);
+    for (uint32_t ii = 0; ii < layout.deleted_count; ii++) {
+        uuid id;
+        std::memcpy(id.bytes, deleted[ii].id, uuid::SIZE);
+        deleted_index.insert(id, reader.string(deleted[ii].time));
+    }
+
+    meta.clear();
+
+    for (uint32_t ii = 0; ii < layout.icon_count; ii++) {
+        custom_icon icon;
+        std::memcpy(icon.id.bytes, icons[ii].id, uuid::SIZE);
+        icon.data = reader.string(icons[ii].data);
+        icon.length = icons[ii].length;
+        meta.custom_icons.push_back(icon);
+    }
+
+    for (uint32_t ii = 0; ii < layout.binary_count; ii++) {
+        binary_record binary;
+        binary.id = binaries[ii].id;
+        binary.compressed = binaries[ii].compressed != 0;
+        binary.is_protected = binaries[ii].is_protected != 0;
+        binary.protected_offset = binaries[ii].protected_offset;
+        binary.raw = binaries[ii].raw != 0;
+        binary.data = binary.raw ? reader.bytes(binaries[ii].data, binaries[ii].length)
+                                    : reader.string(binaries[ii].data);
+        binary.length = binaries[ii].length;
+        meta.binaries.push_back(binary);
+    }
+
+    meta.generator = reader.string(m->generator);
+    meta.header_hash = reader.string(m->header_hash);
+    meta.database_name = reader.string(m->database_name);
+    meta.database_description = reader.string(m->database_description);
+    meta.default_user_name = reader.string(m->default_user_name);
+    meta.color = reader.string(m->color);
+    meta.database_name_changed = decode_time(m->database_name_changed);
+    meta.database_description_changed = decode_time(m->database_description_changed);
+    meta.default_user_name_changed = decode_time(m->default_user_name_changed);
+    meta.master_key_changed = decode_time(m->master_key_changed);
+    meta.recycle_bin_changed = decode_time(m->recycle_bin_changed);
+    meta.entry_templates_group_changed = decode_time(m->entry_templates_group_changed);
+    meta.master_key_change_rec = m->master_key_change_rec;
+    meta.master_key_change_force = m->master_key_change_force;
+    meta.history_max_size = m->history_max_size;
+    meta.maintenance_history_days = m->maintenance_history_days;
+    meta.history_max_items = m->history_max_items;
+    meta.memory_protection.title = (m->memory_protection & 1) != 0;
+    meta.memory_protection.user_name = (m->memory_protection & 2) != 0;
+    meta.memory_protection.password = (m->memory_protection & 4) != 0;
+    meta.memory_protection.url = (m->memory_protection & 8) != 0;
+    meta.memory_protection.notes = (m->memory_protection & 16) != 0;
+    meta.recycle_bin_enabled = m->recycle_bin_enabled != 0;
+    std::memcpy(meta.recycle_bin_uuid.bytes, m->recycle_bin_uuid, uuid::SIZE);
+    std::memcpy(meta.entry_templates_group.bytes, m->entry_templates_group, uuid::SIZE);
+    std::memcpy(meta.last_selected_group.bytes, m->last_selected_group, uuid::SIZE);
+    std::memcpy(meta.last_top_visible_group.bytes, m->last_top_visible_group, uuid::SIZE);
+
+    // Meta strings are never NULL
+    if (!meta.generator || !meta.header_hash || !meta.database_name
+            || !meta.database_description || !meta.default_user_name || !meta.color) {
+        reader.valid = false;
+    }
+
+    if (!reader.valid) {
+        tree.clear();
+        deleted_index.clear();
+        meta.clear();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Cache files
+//
+
+static void source_digests(const mapped_file& source, size_t header_length,
+                            byte* header_hash, byte* file_hash)
+{
+    const byte* data = static_cast<const byte*>(source.data());
+    SHA256().CalculateDigest(header_hash, data, header_length);
+    SHA256().CalculateDigest(file_hash, data, source.size());
+}
+
+static void cache_key(const SecByteBlock& master_key, SecByteBlock& out)
+{
+    static const char LABEL[] = "libkdbx cache key";
+
+    HMAC<SHA256> hmac(master_key.data(), master_key.size());
+    out.New(HMAC<SHA256>::DIGESTSIZE);
+    hmac.Update(reinterpret_cast<const byte*>(LABEL), sizeof(LABEL) - 1);
+    hmac.Final(out.data());
+}
+
+// Parses the header of a mapped file and returns its length
+static size_t read_header(kdbx2& db, const mapped_file& source)
+{
+    membuf buffer(source.data(), source.size());
+    istream in(&buffer);
+    db.load_header(in);
+    return static_cast<size_t>(in.tellg());
+}
+
+bool kdbx2_pvt::read_cache(const mapped_file& source, size_t header_length,
+                            const string& cache_path)
+{
+    std::unique_ptr<mapped_file> mapping;
+
+    try {
+        mapping = std::make_unique<mapped_file>(cache_path);
+    } catch (const parse_error&) {
+        return false;
+    }
+
+    const byte* data = static_cast<const byte*>(mapping->data());
+    cache_header header;
+
+    if (mapping->size() < sizeof(header) + TAG_SIZE) {
+        return false;
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+            || header.version != CACHE_VERSION
+            || header.source_size != source.size()
+            || header.body_size != mapping->size() - sizeof(header) - TAG_SIZE) {
+        return false;
+    }
+
+    byte header_hash[SHA256::DIGESTSIZE];
+    byte file_hash[SHA256::DIGESTSIZE];
+    source_digests(source, header_length, header_hash, file_hash);
+
+    if (std::memcmp(header_hash, header.source_header_hash, sizeof(header_hash)) != 0
+            || std::memcmp(file_hash, header.source_hash, sizeof(file_hash)) != 0) {
+        return false;
+    }
+
+    load_stats* stats = this->stats.get();
+
+    SecByteBlock master_key;
+    bool cached;
+
+    {
+        phase_timer timer(stats, &load_stats::key_transform);
+        cached = derive_master_key(master_key);
+    }
+
+    if (stats) {
+        stats->key_cached = cached;
+    }
+
+    phase_timer build_timer(stats, &load_stats::build);
+
+    SecByteBlock key;
+    cache_key(master_key, key);
+
+    clear_document();
+
+    size_t size = static_cast<size_t>(header.body_size);
+    char* body = static_cast<char*>(arena.allocate(size));
+
+    // Decrypt straight from the mapping into the arena. A wrong key fails
+    // here just like a damaged cache.
+    GCM<AES>::Decryption gcm;
+    gcm.SetKeyWithIV(key.data(), key.size(), header.nonce, NONCE_SIZE);
+
+    bool authentic = gcm.DecryptAndVerify(reinterpret_cast<byte*>(body),
+                                            data + sizeof(header) + size, TAG_SIZE,
+                                            header.nonce, NONCE_SIZE,
+                                            data, sizeof(header),
+                                            data + sizeof(header), size);
+
+    if (!authentic || !decode_cache(body, size)) {
+        clear_document();
+        return false;
+    }
+
+    // Only remember keys that are known to be correct
+    if (cache && !cached) {
+        cache->insert(composite_key, transform_seed, transform_rounds, transformed_key);
+    }
+
+    inner_stream = std::make_unique<protected_stream>(inner_random_stream_id,
+                                                        protected_stream_key);
+    protected_values.clear();
+
+    index_tree();
+    urls.build(tree);
+    attachments.build(meta.binaries);
+
+    if (search) {
+        search->build(tree);
+    }
+
+    from_cache = true;
+    return true;
+}
+
+void kdbx2_pvt::write_cache(const mapped_file& source, size_t header_length,
+                            const string& cache_path) const
+{
+    SecByteBlock body;
+    encode_cache(body);
+
+    cache_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.source_size = source.size();
+    header.body_size = body.size();
+    source_digests(source, header_length, header.source_header_hash, header.source_hash);
+
+    AutoSeededRandomPool rng;
+    rng.GenerateBlock(header.nonce, NONCE_SIZE);
+
+    SecByteBlock master_key;
+    combine_master_key(master_seed, master_key);
+
+    SecByteBlock key;
+    cache_key(master_key, key);
+
+    // Header, ciphertext and tag, written in one go
+    SecByteBlock file(sizeof(header) + body.size() + TAG_SIZE);
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    GCM<AES>::Encryption gcm;
+    gcm.SetKeyWithIV(key.data(), key.size(), header.nonce, NONCE_SIZE);
+    gcm.EncryptAndAuthenticate(file.data() + sizeof(header),
+                                file.data() + sizeof(header) + body.size(), TAG_SIZE,
+                                header.nonce, NONCE_SIZE,
+                                file.data(), sizeof(header),
+                                body.data(), body.size());
+
+    // Write a temporary file and rename it over the old cache, so readers
+    // never see half a cache
+    string temporary = cache_path + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+    if (fd < 0) {
+        throw write_error("unable to write cache");
+    }
+
+    size_t written = 0;
+
+    while (written < file.size()) {
+        ssize_t count = ::write(fd, file.data() + written, file.size() - written);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            close(fd);
+            unlink(temporary.c_str());
+            throw write_error("unable to write cache");
+        }
+
+        written += static_cast<size_t>(count);
+    }
+
+    if (close(fd) < 0 || rename(temporary.c_str(), cache_path.c_str()) < 0) {
+        unlink(temporary.c_str());
+        throw write_error("unable to write cache");
+    }
+}
+
+bool kdbx2::load_cached(const string& path, const string& cache_path)
+{
+    file_stamp stamp;
+    if (!stamp.read(path)) {
+        throw parse_error("unable to open file");
+    }
+
+    mapped_file file(path);
+
+    _pvt->merged = false;
+
+    load_stats* stats = _pvt->stats.get();
+
+    if (stats) {
+        stats->clear();
+    }
+
+    bool used;
+
+    {
+        phase_timer total(stats, &load_stats::total);
+        size_t header_length;
+
+        {
+            phase_timer header(stats, &load_stats::header);
+            header_length = read_header(*this, file);
+        }
+
+        used = _pvt->read_cache(file, header_length, cache_path);
+
+        if (!used) {
+            load(file.data(), file.size());
+
+            // The database is loaded either way, the cache is only a bonus
+            try {
+                _pvt->write_cache(file, header_length, cache_path);
+            } catch (const write_error&) {
+            }
+        }
+    }
+
+    _pvt->source_path = path;
+    _pvt->source_stamp = stamp;
+
+    if (used && stats && _pvt->stats_callback) {
+        _pvt->stats_callback(*stats);
+    }
+
+    return used;
+}
+
+void kdbx2::save_cache(const string& cache_path) const
+{
+    if (_pvt->source_path.empty() || _pvt->from_cache) {
+        throw write_error("no file to cache");
+    }
+
+    if (_pvt->merged) {
+        throw write_error("database has changed since it was loaded");
+    }
+
+    mapped_file file(_pvt->source_path);
+
+    // Make sure the file is still the one that was loaded
+    kdbx2 header;
+    size_t header_length = read_header(header, file);
+
+    const kdbx2_pvt& current = *header._pvt;
+
+    if (current.master_seed != _pvt->master_seed
+            || current.encryption_iv != _pvt->encryption_iv
+            || current.stream_start_bytes != _pvt->stream_start_bytes) {
+        throw write_error("source file has changed");
+    }
+
+    _pvt->write_cache(file, header_length, cache_path);
+}
+
+}
@@ -0,0 +1,38 @@
+#ifndef CHANGES_HPP
+#define CHANGES_HPP 1
+#include <vector>
+
+#include "uuid.hpp"
+
+namespace kdbx
+{
+
+/*
+ * What a reload or merge changed, by UUID. Groups and entries count as
+ * modified when their LastModificationTime differs or they moved to another
+ * group.
+ */
+struct change_set
+{
+    // False when the file was unchanged and nothing was reloaded, and
+    // always false for a merge
+    bool reloaded = false;
+
+    std::vector<uuid> added_groups;
+    std::vector<uuid> modified_groups;
+    std::vector<uuid> removed_groups;
+
+    std::vector<uuid> added_entries;
+    std::vector<uuid> modified_entries;
+    std::vector<uuid> removed_entries;
+
+    bool empty() const
+    {
+        return added_groups.empty() && modified_groups.empty() && removed_groups.empty()
+            && added_entries.empty() && modified_entries.empty() && removed_entries.empty();
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "cryptbuf.hpp"
+
+#include <cstring>
+
+#include "errors.hpp"
+
+namespace kdbx
+{
+
+cryptbuf::cryptbuf(std::istream& in, CryptoPP::StreamTransformation& cipher)
+    : _in(&in), _cipher(cipher), _padded(cipher.MandatoryBlockSize() > 1),
+        _buffer(BLOCK_SIZE + CHUNK_SIZE)
+{
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+    setg(start, start, start);
+}
+
+cryptbuf::cryptbuf(const byte* data, size_t length,
+                    CryptoPP::StreamTransformation& cipher)
+    : _source(data), _source_length(length), _cipher(cipher),
+        _padded(cipher.MandatoryBlockSize() > 1), _buffer(BLOCK_SIZE + CHUNK_SIZE)
+{
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+    setg(start, start, start);
+}
+
+size_t cryptbuf::fill(byte* out)
+{
+    size_t count;
+
+    if (_in) {
+        _in->read(reinterpret_cast<char*>(out), CHUNK_SIZE);
+        count = static_cast<size_t>(_in->gcount());
+    } else {
+        count = _source_length < CHUNK_SIZE ? _source_length : CHUNK_SIZE;
+    }
+
+    if (_padded && count % BLOCK_SIZE != 0) {
+        throw parse_error("ciphertext truncated");
+    }
+
+    if (_in) {
+        _cipher.ProcessData(out, out, count);
+    } else {
+        _cipher.ProcessData(out, _source, count);
+        _source += count;
+        _source_length -= count;
+    }
+
+    return count;
+}
+
+cryptbuf::int_type cryptbuf::underflow()
+{
+    if (gptr() < egptr()) {
+        // Still have characters in the buffer
+        return traits_type::to_int_type(*gptr());
+    }
+
+    if (_eof) {
+        return traits_type::eof();
+    }
+
+    byte* start = _buffer.begin();
+
+    // Move the block held back from the last chunk to the front
+    if (_held) {
+        std::memmove(start, egptr(), _held);
+    }
+
+    size_t count = fill(start + _held);
+    size_t length = _held + count;
+
+    if (count < CHUNK_SIZE) {
+        // Input is exhausted, so the last block carries the padding
+        _eof = true;
+        _held = 0;
+
+        if (_padded) {
+            length = unpad(length);
+        }
+    } else if (_padded) {
+        _held = BLOCK_SIZE;
+        length -= BLOCK_SIZE;
+    }
+
+    char_type* begin = reinterpret_cast<char_type*>(start);
+    setg(begin, begin, begin + length);
+
+    if (length == 0) {
+        return traits_type::eof();
+    }
+
+    return traits_type::to_int_type(*gptr());
+}
+
+size_t cryptbuf::unpad(size_t length) const
+{
+    if (length == 0) {
+        throw parse_error("invalid padding");
+    }
+
+    const byte* end = _buffer.begin() + length;
+    byte padding = *(end - 1);
+
+    if (padding == 0 || padding > BLOCK_SIZE || padding > length) {
+        throw parse_error("invalid padding");
+    }
+
+    for (const byte* ii = end - padding; ii < end; ii++) {
+        if (*ii != padding) {
+            throw parse_error("invalid padding");
+        }
+    }
+
+    return length - padding;
+}
+
+}
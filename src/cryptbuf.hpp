@@ -0,0 +1,57 @@
+#ifndef CRYPTBUF_HPP
+#define CRYPTBUF_HPP 1
+#include <cstddef>
+#include <iostream>
+#include <streambuf>
+#include "cryptopp/cryptlib.h"
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * Decrypts a padded block cipher stream in fixed size chunks.
+ *
+ * The final block of every chunk is held back until more ciphertext has been
+ * read, so that the PKCS#7 padding can be stripped from the very last block
+ * without ever buffering the whole stream.
+ *
+ * The ciphertext can also come from memory (e.g. a mapped file), in which
+ * case it is decrypted straight into the chunk buffer without staging.
+ *
+ * Stream ciphers (e.g. ChaCha20 in KDBX 4) have no padding, so nothing is
+ * held back for them.
+ */
+class cryptbuf : public std::streambuf
+{
+private:
+    cryptbuf(cryptbuf&&);
+    cryptbuf(const cryptbuf&);
+    cryptbuf& operator=(const cryptbuf&);
+
+    static const size_t BLOCK_SIZE = 16;
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    std::istream* _in = nullptr;
+    const byte* _source = nullptr;
+    size_t _source_length = 0;
+    CryptoPP::StreamTransformation& _cipher;
+    bool _padded;
+    CryptoPP::SecByteBlock _buffer;
+    size_t _held = 0;
+    bool _eof = false;
+
+    size_t fill(byte* out);
+    size_t unpad(size_t length) const;
+
+protected:
+    int_type underflow() override;
+
+public:
+    cryptbuf(std::istream& in, CryptoPP::StreamTransformation& cipher);
+    cryptbuf(const byte* data, size_t length, CryptoPP::StreamTransformation& cipher);
+};
+
+}
+
+#endif
@@ -1,65 +1,161 @@
 #include "entry.hpp"
 
+#include <algorithm>
 #include <cstring>
 
-#include "pugixml.hpp"
-#include "future.hpp"
+#include "base64.hpp"
+#include "group.hpp"
+#include "kdbx_pvt.hpp"
+#include "tree.hpp"
 
 using std::string;
 
-using pugi::xml_node;
+using CryptoPP::SecByteBlock;
 
 namespace kdbx
 {
 
-class entry_pvt
+static bool key_less(const string_field& field, const char* key)
 {
-public:
-    const kdbx2& root;
-    xml_node node;
-
-    entry_pvt(const kdbx2& root, xml_node node)
-        : root(root), node(node) {}
-};
+    return std::strcmp(field.key, key) < 0;
+}
 
-entry::entry(const kdbx2& root, xml_node& node)
-    : _pvt(std::make_unique<entry_pvt>(root, node))
+entry::entry()
+    : _db(NULL), _index(NO_INDEX)
 {
 
 }
 
-entry::entry(entry&& other)
-    : _pvt(std::move(other._pvt))
+entry::entry(const kdbx2_pvt& db, uint32_t index)
+    : _db(&db), _index(index)
 {
 
 }
 
-entry::~entry()
+entry::operator bool() const
 {
+    return _index != NO_INDEX;
+}
 
+uint32_t entry::index() const
+{
+    return _index;
+}
+
+const entry_record& entry::record() const
+{
+    return _db->tree.entries[_index];
 }
 
 const char* entry::uuid() const
 {
-    return _pvt->node.first_element_by_path("UUID", '/').text().get();
+    return record().uuid_text;
+}
+
+const kdbx::uuid& entry::id() const
+{
+    return record().id;
+}
+
+timestamp entry::last_modified() const
+{
+    return record().last_modified;
+}
+
+group entry::parent() const
+{
+    return group(*_db, record().parent);
+}
+
+const string_field* entry::find_string(Field field) const
+{
+    const string_field& found = record().standard[field];
+    return found.key ? &found : NULL;
+}
+
+const string_field* entry::find_string(const string& key) const
+{
+    int slot = standard_slot(key.c_str(), key.size());
+
+    if (slot >= 0) {
+        return find_string(static_cast<Field>(slot));
+    }
+
+    const entry_record& r = record();
+    const string_field* begin = _db->tree.custom_fields.data() + r.first_custom;
+    const string_field* end = begin + r.custom_count;
+    const string_field* found = std::lower_bound(begin, end, key.c_str(), key_less);
+
+    if (found == end || std::strcmp(found->key, key.c_str()) != 0) {
+        return NULL;
+    }
+
+    return found;
+}
+
+static const char* field_text(const string_field* field)
+{
+    if (!field) {
+        return NULL;
+    }
+
+    if (field->is_protected) {
+        return "Protected";
+    } else {
+        return field->value;
+    }
+}
+
+const char* entry::get_string(Field field) const
+{
+    return field_text(find_string(field));
 }
 
 const char* entry::get_string(const string& key) const
 {
-    for (xml_node& outer : _pvt->node) {
-        if (std::strcmp("String", outer.name()) == 0) {
-            if (std::strcmp(key.c_str(), outer.child("Key").text().get()) == 0) {
-                xml_node value = outer.child("Value");
-
-                if (value.attribute("Protected").as_bool(false)) {
-                    return "Protected";
-                } else {
-                    return value.text().get();
-                }
-            }
+    return field_text(find_string(key));
+}
+
+bool entry::get_protected_string(const string& key, SecByteBlock& out) const
+{
+    const string_field* field = find_string(key);
+
+    if (!field) {
+        return false;
+    }
+
+    if (!field->is_protected) {
+        out.Assign(reinterpret_cast<const byte*>(field->value), field->length);
+        return true;
+    }
+
+    out.CleanNew(base64_decoded_size(field->value, field->length));
+    base64_decode(field->value, field->length, out.data());
+    _db->inner_stream->apply(field->protected_offset, out.data(), out.size());
+    return true;
+}
+
+size_t entry::attachment_count() const
+{
+    return record().binary_count;
+}
+
+attachment entry::get_attachment(size_t index) const
+{
+    const binary_ref& ref = _db->tree.binary_refs[record().first_binary + index];
+    return attachment(*_db, ref.key, _db->attachments.find(ref.ref));
+}
+
+attachment entry::find_attachment(const string& name) const
+{
+    for (size_t ii = 0; ii < attachment_count(); ii++) {
+        attachment found = get_attachment(ii);
+
+        if (name == found.name()) {
+            return found;
         }
     }
 
-    return NULL;
+    return attachment();
 }
 }
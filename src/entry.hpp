@@ -1,34 +1,86 @@
 #ifndef ENTRY_HPP
 #define ENTRY_HPP 1
 
-#include <memory>
-#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 
-namespace pugi
-{
-    class xml_node;
-}
+#include "cryptopp/secblock.h"
+
+#include "attachment.hpp"
+#include "timestamp.hpp"
+#include "uuid.hpp"
 
 namespace kdbx
 {
 
-class entry_pvt;
-class kdbx2;
+class group;
+class kdbx2_pvt;
+struct entry_record;
 
+struct string_field
+{
+    const char* key;
+    const char* value;
+    size_t length;
+    bool is_protected;
+    uint64_t protected_offset;
+};
+
+/*
+ * A lightweight handle to an entry stored in its database.
+ */
 class entry
 {
 private:
-    std::unique_ptr<entry_pvt> _pvt;
+    const kdbx2_pvt* _db;
+    uint32_t _index;
+
+    const entry_record& record() const;
 
 public:
-    entry(const kdbx2& root, pugi::xml_node& node);
-    entry(entry&&);
-    ~entry();
+    enum Field
+    {
+        TITLE = 0,
+        USER_NAME,
+        PASSWORD,
+        URL,
+        NOTES,
+        STANDARD_FIELD_COUNT,
+    };
+
+    entry();
+    entry(const kdbx2_pvt& db, uint32_t index);
+
+    // False for the handle returned by failed lookups
+    explicit operator bool() const;
+    uint32_t index() const;
 
     const char* uuid() const;
+    const kdbx::uuid& id() const;
+    timestamp last_modified() const;
     // TODO: All the other fields
 
+    group parent() const;
+
+    // NULL if the entry has no such string
+    const string_field* find_string(Field field) const;
+    const string_field* find_string(const std::string& key) const;
+
+    // Protected values are returned as "Protected"
+    const char* get_string(Field field) const;
     const char* get_string(const std::string& key) const;
+
+    // Decrypts a single value, protected or not, into a wiping buffer
+    bool get_protected_string(const std::string& key, CryptoPP::SecByteBlock& out) const;
+
+    // Attachments in document order. A reference to a missing pool id
+    // gives a false handle.
+    size_t attachment_count() const;
+    attachment get_attachment(size_t index) const;
+
+    // A false handle if there is no attachment with that name
+    attachment find_attachment(const std::string& name) const;
 };
 
 }
@@ -15,6 +15,15 @@ public:
         : runtime_error(what_arg) {}
 };
 
+class write_error : public std::runtime_error
+{
+public:
+    explicit write_error(const std::string& what_arg)
+        : runtime_error(what_arg) {}
+    explicit write_error(const char* what_arg)
+        : runtime_error(what_arg) {}
+};
+
 }
 
 #endif
@@ -1,79 +1,102 @@
 #include "group.hpp"
 
-#include <cstring>
-#include <vector>
+#include "kdbx_pvt.hpp"
+#include "tree.hpp"
 
-#include "future.hpp"
-#include "pugixml.hpp"
-
-#include "entry.hpp"
+namespace kdbx
+{
 
-using pugi::xml_document;
-using pugi::xml_node;
-using pugi::xml_parse_result;
+group::group()
+    : _db(NULL), _index(NO_INDEX)
+{
 
-using std::string;
-using std::vector;
+}
 
-namespace kdbx
+group::group(const kdbx2_pvt& db, uint32_t index)
+    : _db(&db), _index(index)
 {
 
-class group_pvt
-{
-public:
-    const kdbx2& root;
-    xml_node node;
+}
 
-    vector<entry> entries;
+group::operator bool() const
+{
+    return _index != NO_INDEX;
+}
 
-    group_pvt(const kdbx2& root, xml_node& node)
-        : root(root), node(node) {}
-};
+uint32_t group::index() const
+{
+    return _index;
+}
 
-group::group(const kdbx2& root, xml_node& node)
-    : _pvt(std::make_unique<group_pvt>(root, node))
+const group_record& group::record() const
 {
-    // Find entries
-    for (xml_node child : node) {
-        if (0 == std::strcmp(child.name(), "Entry")) {
-            _pvt->entries.emplace_back(_pvt->root, child);
-        }
-    }
+    return _db->tree.groups[_index];
 }
 
-group::group(group&& other)
-    : _pvt(std::move(other._pvt))
+const char* group::uuid() const { return record().uuid_text; }
+const kdbx::uuid& group::id() const { return record().id; }
+const char* group::name() const { return record().name; }
+const char* group::notes() const { return record().notes; }
+int group::icon_id() const { return record().icon_id; }
+timestamp group::last_modified() const { return record().last_modified; }
+bool group::is_expanded() const { return record().is_expanded; }
+const char* group::enable_auto_type() const { return record().enable_auto_type; }
+const char* group::enable_searching() const { return record().enable_searching; }
+const char* group::last_top_visible_entry() const { return record().last_top_visible_entry; }
+
+group group::parent() const
 {
+    return group(*_db, record().parent);
+}
 
+group_range group::groups() const
+{
+    return group_range(_db, record().first_child);
 }
 
-group::~group()
+index_range<entry> group::entries() const
 {
+    const group_record& r = record();
+    return index_range<entry>(_db, r.first_entry, r.first_entry + r.entry_count);
+}
 
+index_range<group> group::subtree() const
+{
+    return index_range<group>(_db, _index, record().subtree_end);
 }
 
-const char* group::uuid() const
+index_range<entry> group::subtree_entries() const
 {
-    return _pvt->node.first_element_by_path("UUID", '/').text().get();
+    const group_record& r = record();
+    return index_range<entry>(_db, r.first_entry, r.subtree_entry_end);
 }
 
-const char* group::name() const
+size_t group::subtree_group_count() const
 {
-    return _pvt->node.first_element_by_path("Name", '/').text().get();
+    return record().subtree_end - _index;
 }
 
-int group::icon_id() const
+size_t group::subtree_entry_count() const
 {
-    return _pvt->node.first_element_by_path("IconId", '/').text().as_int();
+    const group_record& r = record();
+    return r.subtree_entry_end - r.first_entry;
 }
 
-bool group::is_expanded() const
+group_range::iterator& group_range::iterator::operator++()
 {
-    return _pvt->node.first_element_by_path("IsExpanded", '/').text().as_bool(false);
+    _index = _db->tree.groups[_index].next_sibling;
+    return *this;
 }
 
-const vector<entry>& group::entries() const
+size_t group_range::size() const
 {
-    return _pvt->entries;
+    size_t count = 0;
+
+    for (iterator ii = begin(); ii != end(); ++ii) {
+        count++;
+    }
+
+    return count;
 }
+
 }
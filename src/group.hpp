@@ -1,40 +1,52 @@
 #ifndef GROUP_HPP
 #define GROUP_HPP 1
 
-#include <memory>
-#include <utility>
-#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
 
 #include "entry.hpp"
-
-namespace pugi
-{
-    class xml_node;
-}
+#include "range.hpp"
+#include "timestamp.hpp"
+#include "uuid.hpp"
 
 namespace kdbx
 {
 
-class group_pvt;
+class group_range;
+class kdbx2_pvt;
+struct group_record;
 
+/*
+ * A lightweight handle to a group stored in its database.
+ */
 class group
 {
 private:
-    std::unique_ptr<group_pvt> _pvt;
+    const kdbx2_pvt* _db;
+    uint32_t _index;
+
+    const group_record& record() const;
 
 public:
-    group(const kdbx2& root, pugi::xml_node& node);
-    group(group&&);
-    ~group();
+    group();
+    group(const kdbx2_pvt& db, uint32_t index);
+
+    // False for the handle returned by failed lookups
+    explicit operator bool() const;
+    uint32_t index() const;
 
     //
     // Group Information
     //
     const char* uuid() const;
+    const kdbx::uuid& id() const;
     const char* name() const;
-    // TODO: Notes
+    const char* notes() const;
     int icon_id() const;
-    // TODO: Times
+    timestamp last_modified() const;
+    // TODO: The other times
     bool is_expanded() const;
     // TODO: DefaultAutoTypeSequence
     const char* enable_auto_type() const;
@@ -42,9 +54,60 @@ public:
     const char* last_top_visible_entry() const;
 
     //
-    // Entries
+    // Hierarchy
     //
-    const std::vector<entry>& entries() const;
+    group parent() const;
+    group_range groups() const;
+    index_range<entry> entries() const;
+
+    // This group and all of its descendants, in pre-order
+    index_range<group> subtree() const;
+    index_range<entry> subtree_entries() const;
+
+    size_t subtree_group_count() const;
+    size_t subtree_entry_count() const;
+};
+
+/*
+ * The direct children of a group, following the sibling links.
+ */
+class group_range
+{
+private:
+    const kdbx2_pvt* _db;
+    uint32_t _first;
+
+public:
+    class iterator
+    {
+    private:
+        const kdbx2_pvt* _db;
+        uint32_t _index;
+
+    public:
+        typedef std::ptrdiff_t difference_type;
+        typedef group value_type;
+        typedef const group* pointer;
+        typedef group reference;
+        typedef std::forward_iterator_tag iterator_category;
+
+        iterator(const kdbx2_pvt* db, uint32_t index) : _db(db), _index(index) {}
+
+        group operator*() const { return group(*_db, _index); }
+        iterator& operator++();
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator& other) const { return _index == other._index; }
+        bool operator!=(const iterator& other) const { return _index != other._index; }
+    };
+
+    group_range(const kdbx2_pvt* db, uint32_t first) : _db(db), _first(first) {}
+
+    iterator begin() const { return iterator(_db, _first); }
+    iterator end() const { return iterator(_db, NO_INDEX); }
+
+    bool empty() const { return _first == NO_INDEX; }
+    size_t size() const;
 };
 
 }
@@ -0,0 +1,71 @@
+#include "gzipbuf.hpp"
+
+#include <cstring>
+
+#include "errors.hpp"
+
+namespace kdbx
+{
+
+gzipbuf::gzipbuf(std::istream& in)
+    : _in(in), _input(CHUNK_SIZE), _buffer(CHUNK_SIZE)
+{
+    std::memset(&_stream, 0, sizeof(_stream));
+
+    // 16 selects the GZip wrapper instead of raw zlib
+    if (inflateInit2(&_stream, 16 + MAX_WBITS) != Z_OK) {
+        throw parse_error("unable to initialize decompression");
+    }
+
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+    setg(start, start, start);
+}
+
+gzipbuf::~gzipbuf()
+{
+    inflateEnd(&_stream);
+}
+
+gzipbuf::int_type gzipbuf::underflow()
+{
+    if (gptr() < egptr()) {
+        // Still have characters in the buffer
+        return traits_type::to_int_type(*gptr());
+    }
+
+    _stream.next_out = _buffer.begin();
+    _stream.avail_out = static_cast<uInt>(_buffer.size());
+
+    while (!_eof && _stream.avail_out == _buffer.size()) {
+        if (_stream.avail_in == 0) {
+            _in.read(reinterpret_cast<char*>(_input.begin()), CHUNK_SIZE);
+
+            _stream.next_in = _input.begin();
+            _stream.avail_in = static_cast<uInt>(_in.gcount());
+
+            if (_stream.avail_in == 0) {
+                throw parse_error("compressed stream truncated");
+            }
+        }
+
+        int result = inflate(&_stream, Z_NO_FLUSH);
+
+        if (result == Z_STREAM_END) {
+            _eof = true;
+        } else if (result != Z_OK) {
+            throw parse_error("compressed stream invalid");
+        }
+    }
+
+    size_t length = _buffer.size() - _stream.avail_out;
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+    setg(start, start, start + length);
+
+    if (length == 0) {
+        return traits_type::eof();
+    }
+
+    return traits_type::to_int_type(*gptr());
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef GZIPBUF_HPP
+#define GZIPBUF_HPP 1
+#include <cstddef>
+#include <iostream>
+#include <streambuf>
+#include <zlib.h>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * Inflates a GZip stream in fixed size chunks.
+ */
+class gzipbuf : public std::streambuf
+{
+private:
+    gzipbuf(gzipbuf&&);
+    gzipbuf(const gzipbuf&);
+    gzipbuf& operator=(const gzipbuf&);
+
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    std::istream& _in;
+    z_stream _stream;
+    CryptoPP::SecByteBlock _input;
+    CryptoPP::SecByteBlock _buffer;
+    bool _eof = false;
+
+protected:
+    int_type underflow() override;
+
+public:
+    explicit gzipbuf(std::istream& in);
+    ~gzipbuf();
+};
+
+}
+
+#endif
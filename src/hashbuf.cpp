@@ -3,13 +3,45 @@
 #include "io.hpp"
 #include "errors.hpp"
 
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
 namespace kdbx
 {
 
-hashbuf::hashbuf(std::istream& in)
-    : _in(in)
+hashbuf::hashbuf(std::istream& in, size_t read_ahead)
+    : _in(in), _read_ahead(read_ahead)
 {
     update_ptr();
+
+    if (_read_ahead) {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, _read_ahead);
+
+        for (size_t ii = 0; ii < threads; ii++) {
+            _workers.emplace_back(&hashbuf::work, this);
+        }
+    }
+}
+
+hashbuf::~hashbuf()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+    }
+
+    _queued.notify_all();
+
+    for (std::thread& worker : _workers) {
+        worker.join();
+    }
+}
+
+uint32_t hashbuf::blocks() const
+{
+    return _blk_idx;
 }
 
 hashbuf::int_type hashbuf::underflow()
@@ -19,34 +51,153 @@ hashbuf::int_type hashbuf::underflow()
         return traits_type::to_int_type(*gptr());
     }
 
-    read_header();
-    read_body();
+    return _read_ahead ? next_pending() : next_block();
+}
+
+hashbuf::int_type hashbuf::next_block()
+{
+    if (_eof) {
+        return hashbuf::traits_type::eof();
+    }
+
+    block blk;
+    read_header(blk);
+    read_body(blk);
 
-    if (_buffer.size() == 0) {
+    if (blk.data.size() == 0) {
+        _eof = true;
         return hashbuf::traits_type::eof();
     }
 
-    verify();
+    if (!verify(blk)) {
+        throw parse_error("block signature invalid");
+    }
+
+    _buffer.swap(blk.data);
     update_ptr();
 
+    return hashbuf::traits_type::to_int_type(*gptr());
+}
+
+hashbuf::int_type hashbuf::next_pending()
+{
+    fill();
+
+    if (_pending.empty()) {
+        return hashbuf::traits_type::eof();
+    }
+
+    std::unique_ptr<block> blk = std::move(_pending.front());
+    _pending.pop_front();
+
+    {
+        unique_lock<mutex> lock(_mutex);
+        _verified.wait(lock, [&blk] { return blk->state != block::PENDING; });
+    }
+
+    if (!blk->error.empty()) {
+        throw parse_error(blk->error);
+    }
+
+    if (blk->state == block::INVALID) {
+        throw parse_error("block signature invalid");
+    }
+
+    if (blk->data.size() == 0) {
+        return hashbuf::traits_type::eof();
+    }
+
+    _buffer.swap(blk->data);
+    update_ptr();
+
+    // Keep the workers busy while this block is parsed
+    fill();
 
     return hashbuf::traits_type::to_int_type(*gptr());
 }
 
-void hashbuf::read_header() {
-    read(_in, _blk_idx);
-    read(_in, _blk_hash, 32);
-    read(_in, _blk_len);
+void hashbuf::fill()
+{
+    while (!_eof && _pending.size() < _read_ahead) {
+        std::unique_ptr<block> blk(new block);
+
+        try {
+            read_header(*blk);
+            read_body(*blk);
+        } catch (const parse_error& e) {
+            // Raised when the consumer gets here
+            blk->error = e.what();
+            blk->state = block::INVALID;
+        }
+
+        if (blk->state == block::INVALID || blk->data.size() == 0) {
+            // The final block is empty and has no digest to check
+            _eof = true;
+            if (blk->state == block::PENDING) {
+                blk->state = block::VALID;
+            }
+            _pending.push_back(std::move(blk));
+            break;
+        }
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            _queue.push_back(blk.get());
+        }
+
+        _queued.notify_one();
+        _pending.push_back(std::move(blk));
+    }
 }
 
-void hashbuf::read_body() {
-    read(_in, _buffer, _blk_len);
+void hashbuf::work()
+{
+    unique_lock<mutex> lock(_mutex);
+
+    for (;;) {
+        _queued.wait(lock, [this] { return _stop || !_queue.empty(); });
+
+        if (_stop) {
+            return;
+        }
+
+        block* blk = _queue.front();
+        _queue.pop_front();
+
+        lock.unlock();
+        bool valid = verify(*blk);
+        lock.lock();
+
+        blk->state = valid ? block::VALID : block::INVALID;
+        _verified.notify_all();
+    }
 }
 
-void hashbuf::verify() {
-    if (!_hash.VerifyDigest(_blk_hash.data(), _buffer.data(), _buffer.size())) {
-        throw parse_error("block signature invalid");
+void hashbuf::read_header(block& blk) {
+    read(_in, blk.index);
+    read(_in, blk.hash, 32);
+
+    read(_in, blk.length);
+
+    if (!_in) {
+        throw parse_error("block header truncated");
+    }
+
+    if (blk.index != _blk_idx) {
+        throw parse_error("block index out of order");
     }
+
+    _blk_idx++;
+}
+
+void hashbuf::read_body(block& blk) {
+    read(_in, blk.data, blk.length);
+}
+
+bool hashbuf::verify(const block& blk) const {
+    // SHA256 keeps per-message state, so each caller needs its own
+    CryptoPP::SHA256 hash;
+    return hash.VerifyDigest(blk.hash.data(), blk.data.data(), blk.data.size());
 }
 
 void hashbuf::update_ptr()
@@ -1,14 +1,30 @@
 #ifndef HASHBUF_HPP
 #define HASHBUF_HPP 1
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
 #include "cryptopp/secblock.h"
 #include "cryptopp/sha.h"
 
 namespace kdbx
 {
 
+/*
+ * Reads the hashed block stream, verifying each block before its bytes are
+ * handed out.
+ *
+ * With read-ahead enabled the next blocks are read while the current one is
+ * consumed and their digests are checked on worker threads. Errors are kept
+ * with the block they belong to and only raised once the consumer reaches
+ * it, so both modes fail at the same point in the stream.
+ */
 class hashbuf : public std::streambuf
 {
 private:
@@ -16,25 +32,59 @@ private:
     hashbuf(const hashbuf&);
     hashbuf& operator=(const hashbuf&);
 
-    CryptoPP::SHA256 _hash;
+    struct block
+    {
+        enum State
+        {
+            PENDING,
+            VALID,
+            INVALID,
+        };
+
+        uint32_t index;
+        uint32_t length;
+        CryptoPP::SecByteBlock hash;
+        CryptoPP::SecByteBlock data;
+        State state = PENDING;
+        std::string error;
+    };
 
     std::istream& _in;
     CryptoPP::SecByteBlock _buffer;
     bool _error = false;
-    uint32_t _blk_idx;
-    uint32_t _blk_len;
-    CryptoPP::SecByteBlock _blk_hash;
+    bool _eof = false;
+    uint32_t _blk_idx = 0;
+
+    // Read-ahead
+    size_t _read_ahead;
+    std::deque<std::unique_ptr<block>> _pending;
+    std::deque<block*> _queue;
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _queued;
+    std::condition_variable _verified;
+    bool _stop = false;
 
     void update_ptr();
-    void read_header();
-    void read_body();
-    void verify();
+    void read_header(block& blk);
+    void read_body(block& blk);
+    bool verify(const block& blk) const;
+
+    int_type next_block();
+    int_type next_pending();
+    void fill();
+    void work();
 
 protected:
     int_type underflow() override;
 
 public:
-    explicit hashbuf(std::istream& in);
+    // Zero read-ahead verifies each block inline as it is reached
+    explicit hashbuf(std::istream& in, size_t read_ahead = 0);
+    ~hashbuf();
+
+    // Blocks read so far, including the empty block ending the stream
+    uint32_t blocks() const;
 };
 
 }
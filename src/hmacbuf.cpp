@@ -0,0 +1,121 @@
+#include "hmacbuf.hpp"
+
+#include "cryptopp/hmac.h"
+#include "cryptopp/sha.h"
+
+#include "errors.hpp"
+#include "io.hpp"
+#include "membuf.hpp"
+
+using CryptoPP::HMAC;
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+using CryptoPP::SHA512;
+
+namespace kdbx
+{
+
+hmacbuf::hmacbuf(std::istream& in, const SecByteBlock& key)
+    : _in(in), _key(key)
+{
+    setg(NULL, NULL, NULL);
+}
+
+uint64_t hmacbuf::blocks() const
+{
+    return _blk_idx;
+}
+
+void hmacbuf::block_key(const SecByteBlock& key, uint64_t index, SecByteBlock& out)
+{
+    SHA512 hash;
+    out.New(SHA512::DIGESTSIZE);
+    hash.Update(reinterpret_cast<const byte*>(&index), sizeof(index));
+    hash.Update(key.data(), key.size());
+    hash.Final(out.data());
+}
+
+hmacbuf::int_type hmacbuf::underflow()
+{
+    if (gptr() < egptr()) {
+        // Still have characters in the buffer
+        return traits_type::to_int_type(*gptr());
+    }
+
+    if (_eof) {
+        return traits_type::eof();
+    }
+
+    /*
+     * Each block is:
+     *
+     * struct {
+     *    uint8_t hmac[32];
+     *    int32_t length;
+     *    uint8_t data[];
+     * };
+     *
+     * and the stream ends with an empty block.
+     */
+    SecByteBlock stored;
+    int32_t length;
+
+    read(_in, stored, SHA256::DIGESTSIZE);
+    read(_in, length);
+
+    if (!_in) {
+        throw parse_error("block header truncated");
+    }
+
+    if (length < 0) {
+        throw parse_error("block length invalid");
+    }
+
+    // Take the block straight from memory when it is already there
+    membuf* mapped = dynamic_cast<membuf*>(_in.rdbuf());
+    const byte* data;
+
+    if (mapped) {
+        if (mapped->remaining() < static_cast<size_t>(length)) {
+            throw parse_error("block truncated");
+        }
+
+        data = mapped->current();
+        _in.seekg(length, std::ios::cur);
+    } else {
+        read(_in, _buffer, static_cast<size_t>(length));
+
+        if (!_in && length) {
+            throw parse_error("block truncated");
+        }
+
+        data = _buffer.data();
+    }
+
+    SecByteBlock key;
+    block_key(_key, _blk_idx, key);
+
+    HMAC<SHA256> hmac(key.data(), key.size());
+    hmac.Update(reinterpret_cast<const byte*>(&_blk_idx), sizeof(_blk_idx));
+    hmac.Update(reinterpret_cast<const byte*>(&length), sizeof(length));
+    hmac.Update(data, static_cast<size_t>(length));
+
+    if (!hmac.Verify(stored.data())) {
+        throw parse_error("block signature invalid");
+    }
+
+    _blk_idx++;
+
+    if (length == 0) {
+        _eof = true;
+        return traits_type::eof();
+    }
+
+    // Nothing writes through the get area, so it can point at the mapping
+    char_type* start = reinterpret_cast<char_type*>(const_cast<byte*>(data));
+    setg(start, start, start + length);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+}
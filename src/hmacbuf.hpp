@@ -0,0 +1,51 @@
+#ifndef HMACBUF_HPP
+#define HMACBUF_HPP 1
+#include <cstdint>
+#include <iostream>
+#include <streambuf>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * Reads the KDBX 4 HMAC block stream, authenticating each block before its
+ * bytes are handed out.
+ *
+ * Every block has its own HMAC-SHA256 key, derived from the block index
+ * and the database's HMAC key, so blocks can't be dropped, reordered or
+ * moved between files. When reading from memory (e.g. a mapped file) the
+ * blocks are authenticated and handed out where they are, without a copy.
+ */
+class hmacbuf : public std::streambuf
+{
+private:
+    hmacbuf(hmacbuf&&);
+    hmacbuf(const hmacbuf&);
+    hmacbuf& operator=(const hmacbuf&);
+
+    std::istream& _in;
+    const CryptoPP::SecByteBlock& _key;
+    CryptoPP::SecByteBlock _buffer;
+    uint64_t _blk_idx = 0;
+    bool _eof = false;
+
+protected:
+    int_type underflow() override;
+
+public:
+    // key is the 64 byte HMAC key, and has to outlive the buffer
+    hmacbuf(std::istream& in, const CryptoPP::SecByteBlock& key);
+
+    // Blocks read so far, including the empty block ending the stream
+    uint64_t blocks() const;
+
+    // The HMAC-SHA256 key for one block, or for the header with index
+    // UINT64_MAX
+    static void block_key(const CryptoPP::SecByteBlock& key, uint64_t index,
+                            CryptoPP::SecByteBlock& out);
+};
+
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include "cryptopp/secblock.h"
 
 namespace kdbx
@@ -11,15 +12,11 @@ inline void read(std::istream& in, T& v)
 
 inline void read(std::istream& in, std::string& str, std::string::size_type size)
 {
-    // TODO: There is probably a better way to read in strings
-    str.clear();
-    str.reserve(size);
-
-    for (std::string::size_type ii = 0; ii < size; ii++) {
-        str.push_back(static_cast<char>(in.get()));
+    str.resize(size);
+    if (size) {
+        in.read(&str[0], static_cast<std::streamsize>(size));
+        str.resize(static_cast<std::string::size_type>(in.gcount()));
     }
-
-    str.shrink_to_fit();
 }
 
 inline void read(std::istream& in, CryptoPP::SecByteBlock& buf,
@@ -29,13 +26,19 @@ inline void read(std::istream& in, CryptoPP::SecByteBlock& buf,
     in.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(size));
 }
 
-inline void read_to_end(std::istream& in, std::string& out)
+template<typename T>
+inline void write(std::ostream& out, const T& v)
 {
-    char buffer[1024];
-    while (in.good()) {
-        in.read(buffer, 1024);
-        std::string str(buffer, static_cast<std::string::size_type>(in.gcount()));
-        out += str;
-    }
+    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void write(std::ostream& out, const std::string& str)
+{
+    out.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+inline void write(std::ostream& out, const CryptoPP::SecByteBlock& buf)
+{
+    out.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
 }
 }
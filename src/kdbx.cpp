@@ -1,32 +1,38 @@
 #include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
 
+#include <algorithm>
 #include <iostream>
-#include <sstream>
 #include <fstream>
 #include <cstring>
 #include <unordered_map>
 
 #include "cryptopp/aes.h"
 #include "cryptopp/ccm.h"
-#include "cryptopp/filters.h"
-#include "cryptopp/files.h"
 
 #include "pugixml.hpp"
 
 #include "future.hpp"
 
+#include "base64.hpp"
 #include "io.hpp"
+#include "arena.hpp"
+#include "cryptbuf.hpp"
+#include "gzipbuf.hpp"
 #include "hashbuf.hpp"
+#include "keycache.hpp"
+#include "mapped_file.hpp"
+#include "membuf.hpp"
+#include "meterbuf.hpp"
+#include "transform.hpp"
+#include "xml_memory.hpp"
 
 using pugi::xml_document;
 using pugi::xml_node;
 using pugi::xml_parse_result;
 
 using std::string;
-using std::stringstream;
-using std::cout;
 using std::endl;
-using std::ifstream;
 using std::istream;
 using std::unordered_map;
 using std::vector;
@@ -34,167 +40,139 @@ using std::vector;
 using CryptoPP::SecByteBlock;
 using CryptoPP::SHA256;
 using CryptoPP::CBC_Mode;
-using CryptoPP::ECB_Mode;
 using CryptoPP::AES;
-using CryptoPP::StringSource;
-using CryptoPP::StreamTransformationFilter;
-using CryptoPP::StringSink;
 
-int main(int argc, char** argv)
+namespace kdbx
 {
-    if (argc < 2) {
-        cout << "Usage:" << endl;
-        cout << "\t" << argv[0] << " <database>" << endl;
-        return 1;
-    }
 
-    ifstream input(argv[1], std::ios::in | std::ios::binary);
-    kdbx::kdbx2 db;
-    db.push_key("test123");
-    db.load(input);
-
-    for (const kdbx::group& g : db.groups()) {
-        cout << g.uuid() << endl;
-        for (const kdbx::entry& e : g.entries()) {
-            cout << "\t" << e.uuid() << " " << e.get_string("UserName") << endl;
-        }
-    }
+kdbx2::kdbx2()
+    : _pvt(std::make_unique<kdbx2_pvt>(*this))
+{
 
-#if 0
-    cout << "Signature: " << db.signature1() << ", " << db.signature2() << endl;
-    cout << "File Version: " << db.file_version() << endl;
-    cout << "Comment: (" << db.comment().size() << ") " << db.comment() << endl;
-    cout << "Cipher ID: (" << db.cipher_id().size() << ") " << db.cipher_id() << endl;
-    cout << "Compression Flags: " << db.compression_flags() << endl;
-    cout << "Transform Rounds: " << db.transform_rounds() << endl;
-#endif
 }
 
-namespace kdbx
+kdbx2::~kdbx2()
 {
 
-class kdbx2_pvt
+}
+
+void kdbx2::push_key(const string& key)
 {
-private:
-    kdbx2& _pub;
+    SecByteBlock hash(SHA256::DIGESTSIZE);
+    SHA256().CalculateDigest(hash.data(), reinterpret_cast<const byte*>(key.data()), key.size());
+    _pvt->keys.Update(hash.data(), hash.size());
+}
 
-public:
-    kdbx2_pvt(kdbx2& pub) : _pub(pub) {}
+void kdbx2::clear_keys()
+{
+    _pvt->keys.Restart();
+}
 
-    //
-    // Header
-    //
-    const uint32_t SIGNATURE[2] = {0x9AA2D903, 0xB54BFB67};
+void kdbx2::set_key_cache(std::shared_ptr<key_cache> cache)
+{
+    _pvt->cache = std::move(cache);
+}
 
-    enum FieldID
-    {
-        END_OF_HEADER = 0,
-        COMMENT,
-        CIPHER_ID,
-        COMPRESSION_FLAGS,
-        MASTER_SEED,
-        TRANSFORM_SEED,
-        TRANSFORM_ROUNDS,
-        ENCRYPTION_IV,
-        PROTECTED_STREAM_KEY,
-        STREAM_START_BYTES,
-        INNER_RANDOM_STREAM_ID,
-    };
+void kdbx2::set_kdf_limit(std::shared_ptr<semaphore> slots)
+{
+    _pvt->kdf_slots = std::move(slots);
+}
 
+void kdbx2::set_read_ahead(size_t blocks)
+{
+    _pvt->read_ahead = blocks;
+}
 
-    uint32_t signature1;
-    uint32_t signature2;
-    uint32_t file_version;
+void kdbx2::set_load_stats(bool enabled)
+{
+    if (!enabled) {
+        _pvt->stats.reset();
+        _pvt->stats_callback = nullptr;
+    } else if (!_pvt->stats) {
+        _pvt->stats = std::make_unique<load_stats>();
+        _pvt->stats->clear();
+    }
+}
 
-    std::string comment;
-    std::string cipher_id;
-    uint32_t compression_flags;
-    CryptoPP::SecByteBlock master_seed;
-    CryptoPP::SecByteBlock transform_seed;
-    uint64_t transform_rounds;
-    CryptoPP::SecByteBlock encryption_iv;
-    CryptoPP::SecByteBlock protected_stream_key;
-    CryptoPP::SecByteBlock stream_start_bytes;
-    uint32_t inner_random_stream_id;
+void kdbx2::set_load_stats_callback(load_stats_callback callback)
+{
+    set_load_stats(true);
+    _pvt->stats_callback = std::move(callback);
+}
 
+const load_stats* kdbx2::stats() const
+{
+    return _pvt->stats.get();
+}
 
-    CryptoPP::SHA256 keys;
+void kdbx2::load(istream& in)
+{
+    load_stats* stats = _pvt->stats.get();
 
-    void parse_signature(std::istream& in);
-    void parse_fields(std::istream& in);
-    void parse_fields_v1(std::istream& in);
+    if (stats) {
+        stats->clear();
+    }
 
-    void parse_body(std::istream& in);
-    void parse_body_v1(std::istream& in);
+    _pvt->from_cache = false;
+    _pvt->merged = false;
 
-    //
-    // Groups
-    //
-    vector<group> groups;
+    {
+        phase_timer total(stats, &load_stats::total);
 
-    //
-    // XML
-    //
-    xml_document document;
-    xml_node meta;
-};
+        {
+            phase_timer header(stats, &load_stats::header);
+            load_header(in);
+        }
 
-static bool starts_with(const string& str, const SecByteBlock& prefix)
-{
-    if (prefix.size() == 0) {
-        return true;
+        _pvt->parse_body(in);
     }
 
-    if (str.size() < prefix.size()) {
-        return false;
+    if (stats && _pvt->stats_callback) {
+        _pvt->stats_callback(*stats);
     }
-
-    return !memcmp(str.data(), prefix.data(), prefix.size());
 }
 
-kdbx2::kdbx2()
-    : _pvt(std::make_unique<kdbx2_pvt>(*this))
+void kdbx2::load_header(istream& in)
 {
+    _pvt->parse_signature(in);
 
-}
-
-kdbx2::~kdbx2()
-{
+    // Read the file version
+    read(in, _pvt->file_version);
 
+    _pvt->parse_fields(in);
 }
 
-void kdbx2::push_key(const string& key)
+void kdbx2::load(const void* data, size_t length)
 {
-    SecByteBlock hash(SHA256::DIGESTSIZE);
-    SHA256().CalculateDigest(hash.data(), reinterpret_cast<const byte*>(key.data()), key.size());
-    _pvt->keys.Update(hash.data(), hash.size());
+    membuf buffer(data, length);
+    istream in(&buffer);
+    load(in);
 }
 
-void kdbx2::clear_keys()
+void kdbx2::load_file(const string& path)
 {
-    _pvt->keys.Restart();
-}
-
-void kdbx2::load(istream& in)
-{
-    _pvt->parse_signature(in);
+    // Stat first, so a file replaced while loading looks changed later
+    file_stamp stamp;
+    if (!stamp.read(path)) {
+        throw parse_error("unable to open file");
+    }
 
-    // Read the file version
-    read(in, _pvt->file_version);
+    mapped_file file(path);
+    load(file.data(), file.size());
 
-    _pvt->parse_fields(in);
-    _pvt->parse_body(in);
+    _pvt->source_path = path;
+    _pvt->source_stamp = stamp;
 }
 
 void kdbx2_pvt::parse_signature(istream& in)
 {
     read(in, signature1);
-    if (signature1 != SIGNATURE[0]) {
+    if (!in || signature1 != SIGNATURE[0]) {
         throw parse_error("invalid signature (0)");
     }
 
     read(in, signature2);
-    if (signature2 != SIGNATURE[1]) {
+    if (!in || signature2 != SIGNATURE[1]) {
         throw parse_error("invalid signature (1)");
     }
 }
@@ -208,6 +186,10 @@ void kdbx2_pvt::parse_fields(istream& in)
             parse_fields_v1(in);
             break;
 
+        case 0x04:
+            parse_fields_v4(in);
+            break;
+
         default:
             throw parse_error("unknown file version");
     }
@@ -222,6 +204,10 @@ void kdbx2_pvt::parse_body(istream& in)
             parse_body_v1(in);
             break;
 
+        case 0x04:
+            parse_body_v4(in);
+            break;
+
         default:
             throw parse_error("unknown file version");
     }
@@ -242,10 +228,16 @@ void kdbx2_pvt::parse_fields_v1(istream& in)
     uint8_t field_id;
     uint16_t length;
 
+    kdf = KDF::AES_KDF;
+
     while (true) {
         read(in, field_id);
         read(in, length);
 
+        if (!in) {
+            throw parse_error("header truncated");
+        }
+
         switch (field_id) {
             case FieldID::END_OF_HEADER:
                 in.seekg(length, std::ios::cur); // Skip the end contents
@@ -312,82 +304,337 @@ void kdbx2_pvt::parse_fields_v1(istream& in)
     }
 }
 
-void kdbx2_pvt::parse_body_v1(istream& in)
+void kdbx2_pvt::compute_composite_key(SecByteBlock& out) const
+{
+    // Hash a copy, so the pushed keys can be used again
+    SHA256 hash(keys);
+    out.New(hash.DigestSize());
+    hash.Final(out.data());
+}
+
+bool kdbx2_pvt::transform_key()
 {
-    // Build the master key
-    SecByteBlock master_key(keys.DigestSize());
-    keys.Final(master_key.data());
+    bool cached = cache && cache->find(composite_key, transform_seed,
+                                        transform_rounds, transformed_key);
 
-    // Encrypt the key _transform_rounds times
-    ECB_Mode<AES>::Encryption key_transform(transform_seed,
-                                            transform_seed.size());
+    if (!cached) {
+        semaphore_guard slot(kdf_slots.get());
 
-    for (uint64_t ii = 0; ii < transform_rounds; ii++) {
-        key_transform.ProcessData(master_key.data(),
-                                    master_key.data(),
-                                    master_key.size());
+        if (kdf == KDF::ARGON2) {
+            transformed_key.New(argon2::KEY_SIZE);
+            argon2(argon2_params).apply(composite_key.data(), composite_key.size(),
+                                        transformed_key.data());
+        } else {
+            // Encrypt the key _transform_rounds times
+            transformed_key = composite_key;
+            key_transform transform(transform_seed);
+            transform.apply(transformed_key.data(), transform_rounds);
+
+            // Hash the transformed key
+            SHA256().CalculateDigest(transformed_key.data(),
+                                        transformed_key.data(),
+                                        transformed_key.size());
+        }
     }
 
-    // Hash the transformed key
-    SHA256 hash;
-    hash.Update(master_key.data(), master_key.size());
-    hash.Final(master_key.data());
+    transformed_seed = transform_seed;
+    transformed_rounds = transform_rounds;
+
+    return cached;
+}
 
+void kdbx2_pvt::combine_master_key(const SecByteBlock& seed,
+                                    SecByteBlock& master_key) const
+{
     // Combine the key with the master seed
-    hash.Update(master_seed.data(), master_seed.size());
-    hash.Update(master_key.data(), master_key.size());
+    SHA256 hash;
+    master_key.New(hash.DigestSize());
+    hash.Update(seed.data(), seed.size());
+    hash.Update(transformed_key.data(), transformed_key.size());
     hash.Final(master_key.data());
+}
+
+bool kdbx2_pvt::derive_master_key(SecByteBlock& master_key)
+{
+    SecByteBlock current;
+    compute_composite_key(current);
+
+    // Loading again with the same keys and transform parameters can use
+    // the key transformed last time
+    bool cached = !transformed_key.empty() && current == composite_key
+        && transform_seed == transformed_seed && transform_rounds == transformed_rounds;
+
+    if (!cached) {
+        composite_key = current;
+        cached = transform_key();
+    }
+
+    combine_master_key(master_seed, master_key);
+    return cached;
+}
+
+void kdbx2_pvt::parse_body_v1(istream& in)
+{
+    load_stats* stats = this->stats.get();
+
+    SecByteBlock master_key;
+    bool cached;
+
+    {
+        phase_timer timer(stats, &load_stats::key_transform);
+        cached = derive_master_key(master_key);
+    }
+
+    if (stats) {
+        stats->key_cached = cached;
+    }
+
+    // With statistics on, each stage reads through a meterbuf that counts
+    // what it is handed and how long that took
+    stage_meters meters(stats);
 
     CBC_Mode<AES>::Decryption decryption(master_key,
                                             master_key.size(),
                                             encryption_iv.data());
 
-    string ciphertext;
-    read_to_end(in, ciphertext);
-    string plaintext;
+    // Decrypt the body in chunks as it is read, straight from memory if the
+    // input is already there
+    membuf* mapped = dynamic_cast<membuf*>(in.rdbuf());
+    istream cipher_stream(mapped ? in.rdbuf()
+                                 : meters.add(in.rdbuf(), &load_stats::read, &load_stats::bytes_read));
+    std::unique_ptr<cryptbuf> decrypted = mapped
+        ? std::make_unique<cryptbuf>(mapped->current(), mapped->remaining(), decryption)
+        : std::make_unique<cryptbuf>(cipher_stream, decryption);
+
+    if (stats && mapped) {
+        stats->bytes_read = mapped->remaining();
+    }
+
+    istream crypt_stream(meters.add(decrypted.get(), &load_stats::decrypt,
+                                    &load_stats::bytes_decrypted));
+    crypt_stream.exceptions(std::ios::badbit);
 
-    StringSource s(ciphertext, true,
-        new StreamTransformationFilter(decryption,
-            new StringSink(plaintext)
-        ) // StreamTransformationFilter
-    ); // StringSource
+    SecByteBlock start_bytes;
 
-    if (!starts_with(plaintext, stream_start_bytes)) {
+    try {
+        read(crypt_stream, start_bytes, stream_start_bytes.size());
+    } catch (const parse_error&) {
         throw parse_error("incorrect password");
     }
 
-    plaintext = plaintext.substr(stream_start_bytes.size());
+    if (!crypt_stream || start_bytes != stream_start_bytes) {
+        throw parse_error("incorrect password");
+    }
+
+    // Only remember keys that are known to be correct
+    if (cache && !cached) {
+        cache->insert(composite_key, transform_seed, transform_rounds, transformed_key);
+    }
 
     // Read the plaintext using a validating stream buffer
-    stringstream ss(plaintext);
-    hashbuf buffer(ss);
-    istream hash_stream(&buffer);
+    hashbuf buffer(crypt_stream, read_ahead);
+    istream hash_stream(meters.add(&buffer, &load_stats::verify, NULL));
+    hash_stream.exceptions(std::ios::badbit);
+
+    // Decompress the XML as it is read, if needed
+    std::unique_ptr<gzipbuf> inflated;
+
+    switch (compression_flags) {
+        case Compression::NONE:
+            break;
+
+        case Compression::GZIP:
+            inflated = std::make_unique<gzipbuf>(hash_stream);
+            break;
+
+        default:
+            throw parse_error("unknown compression algorithm");
+    }
+
+    istream xml_stream(inflated
+        ? meters.add(inflated.get(), &load_stats::decompress, &load_stats::bytes_decompressed)
+        : hash_stream.rdbuf());
+    xml_stream.exceptions(std::ios::badbit);
+
+    // The old document's memory goes before anything new is counted
+    clear_document();
+
+    {
+        phase_timer timer(stats, &load_stats::xml_parse);
+
+        // Gather the plaintext into the arena and let pugixml parse it
+        // where it is, so the XML is never copied again. A mapped file
+        // gives a fair guess of the size up front.
+        size_t estimate = mapped ? mapped->remaining() : 0;
+
+        if (inflated) {
+            estimate *= 4;
+        }
+
+        size_t length;
+        char* text = read_text(xml_stream, estimate, length);
+        parse_xml(text, length);
+    }
+
+    meters.finish();
+
+    if (stats) {
+        stats->hashed_blocks = buffer.blocks();
+    }
+
+    build_tree();
+}
 
-    xml_document& doc = document;
-    xml_parse_result result = doc.load(hash_stream);
+void kdbx2_pvt::parse_xml(char* text, size_t length)
+{
+    xml_memory_scope scope(&arena, stats.get());
+    xml_parse_result result = document.load_buffer_inplace(text, length);
 
     if (!result) {
         throw parse_error("XML error: " + string(result.description()));
     }
+}
 
+void kdbx2_pvt::build_tree()
+{
+    load_stats* stats = this->stats.get();
+    phase_timer build_timer(stats, &load_stats::build);
+
+    // Record where each protected value sits in the inner stream
+    inner_stream = std::make_unique<protected_stream>(inner_random_stream_id,
+                                                        protected_stream_key);
+    protected_values.clear();
+    protected_offset = 0;
+    element_count = 0;
+    index_protected(document);
+
+    if (stats) {
+        stats->xml_nodes = element_count;
+    }
 
-    xml_node kee = doc.child("KeePassFile");
+    xml_node kee = document.child("KeePassFile");
 
     // Read the Meta tag
-    meta = kee.child("Meta");
+    parse_meta(kee.child("Meta"));
 
     // Read the Root tag
     xml_node root = kee.child("Root");
 
+    tree.build(root, protected_values);
+    deleted_index.clear();
+
     for (xml_node child : root) {
         if (!std::strcmp(child.name(), "Group")) {
-            groups.emplace_back(_pub, child);
+            continue;
         } else if (!std::strcmp(child.name(), "DeletedObjects")) {
-            // TODO: Do something with these
+            index_deleted(child);
         } else {
             std::cerr << "Unknown root node: " << child.name() << endl;
         }
     }
+
+    index_tree();
+    urls.build(tree);
+    attachments.build(meta.binaries);
+
+    if (search) {
+        search->build(tree);
+    }
+}
+
+void kdbx2_pvt::clear_document()
+{
+    tree.clear();
+    group_index.clear();
+    entry_index.clear();
+    deleted_index.clear();
+    protected_values.clear();
+    meta.clear();
+    attachments.clear();
+    urls.clear();
+
+    if (search) {
+        search->clear();
+    }
+
+    document.reset();
+    arena.clear();
+}
+
+char* kdbx2_pvt::read_text(istream& in, size_t estimate, size_t& length)
+{
+    static const size_t MIN_CAPACITY = 64 * 1024;
+
+    size_t capacity = estimate < MIN_CAPACITY ? MIN_CAPACITY : estimate;
+    char* text = static_cast<char*>(arena.allocate(capacity));
+    length = 0;
+
+    while (true) {
+        if (length == capacity) {
+            text = static_cast<char*>(arena.reallocate_last(text, capacity, capacity * 2));
+            capacity *= 2;
+        }
+
+        in.read(text + length, static_cast<std::streamsize>(capacity - length));
+        length += static_cast<size_t>(in.gcount());
+
+        if (!in) {
+            break;
+        }
+    }
+
+    // Give back what the guess overshot
+    return static_cast<char*>(arena.reallocate_last(text, capacity, length));
+}
+
+void kdbx2_pvt::index_tree()
+{
+    group_index.clear();
+    group_index.reserve(tree.groups.size());
+
+    for (uint32_t ii = 0; ii < tree.groups.size(); ii++) {
+        group_index.insert(tree.groups[ii].id, ii);
+    }
+
+    entry_index.clear();
+    entry_index.reserve(tree.entries.size());
+
+    for (uint32_t ii = 0; ii < tree.entries.size(); ii++) {
+        entry_index.insert(tree.entries[ii].id, ii);
+    }
+}
+
+void kdbx2_pvt::index_deleted(const xml_node& node)
+{
+    for (xml_node deleted : node) {
+        if (std::strcmp(deleted.name(), "DeletedObject")) {
+            continue;
+        }
+
+        uuid id = uuid::from_base64(deleted.child("UUID").text().get());
+        deleted_index.insert(id, deleted.child("DeletionTime").text().get());
+    }
+}
+
+void kdbx2_pvt::index_protected(const xml_node& node)
+{
+    for (xml_node child : node) {
+        if (child.type() != pugi::node_element) {
+            continue;
+        }
+
+        element_count++;
+
+        if (child.attribute("Protected").as_bool(false)) {
+            const char* text = child.text().get();
+            size_t length = base64_decoded_size(text, std::strlen(text));
+
+            protected_values[child.internal_object()] = {protected_offset, length};
+            protected_offset += length;
+        }
+
+        index_protected(child);
+    }
 }
 
 //
@@ -407,32 +654,155 @@ uint32_t kdbx2::inner_random_stream_id() const { return _pvt->inner_random_strea
 //
 // Meta
 //
-const char* kdbx2::generator() const { return _pvt->meta.child("Generator").text().get(); }
-const char* kdbx2::header_hash() const { return _pvt->meta.child("HeaderHash").text().get(); }
-const char* kdbx2::database_name() const { return _pvt->meta.child("DatabaseName").text().get(); }
-const char* kdbx2::database_name_changed() const { return _pvt->meta.child("DatabaseNameChanged").text().get(); }
-const char* kdbx2::database_description() const { return _pvt->meta.child("DatabaseDescription").text().get(); }
-const char* kdbx2::database_description_changed() const { return _pvt->meta.child("DatabaseDescriptionChanged").text().get(); }
-const char* kdbx2::default_user_name() const { return _pvt->meta.child("DefaultUserName").text().get(); }
-const char* kdbx2::default_user_name_changed() const { return _pvt->meta.child("DefaultUserNameChanged").text().get(); }
-const char* kdbx2::maintenance_history_days() const { return _pvt->meta.child("MaintenanceHistoryDays").text().get(); }
-const char* kdbx2::color() const { return _pvt->meta.child("Color").text().get(); }
-const char* kdbx2::master_key_changed() const { return _pvt->meta.child("MasterKeyChanged").text().get(); }
-int kdbx2::master_key_change_rec() const { return _pvt->meta.child("MasterKeyChangeRec").text().as_int(); }
-int kdbx2::master_key_change_force() const { return _pvt->meta.child("MasterKeyChangeForce").text().as_int(); }
-bool kdbx2::recycle_bin_enabled() const { return _pvt->meta.child("RecycleBinEnabled").text().as_bool(); }
-const char* kdbx2::recycle_bin_uuid() const { return _pvt->meta.child("RecycleBinUUID").text().get(); }
-const char* kdbx2::recycle_bin_changed() const { return _pvt->meta.child("RecycleBinChanged").text().get(); }
-const char* kdbx2::entry_templates_group() const { return _pvt->meta.child("EntryTemplatesGroup").text().get(); }
-const char* kdbx2::entry_templates_group_changed() const { return _pvt->meta.child("EntryTemplatesGroupChanged").text().get(); }
-const char* kdbx2::history_max_items() const { return _pvt->meta.child("HistoryMaxItems").text().get(); }
-const char* kdbx2::history_max_size() const { return _pvt->meta.child("HistoryMaxSize").text().get(); }
-const char* kdbx2::last_selected_group() const { return _pvt->meta.child("LastSelectedGroup").text().get(); }
-const char* kdbx2::last_top_visible_group() const { return _pvt->meta.child("LastTopVisibleGroup").text().get(); }
+const char* kdbx2::generator() const { return _pvt->meta.generator; }
+const char* kdbx2::header_hash() const { return _pvt->meta.header_hash; }
+const char* kdbx2::database_name() const { return _pvt->meta.database_name; }
+timestamp kdbx2::database_name_changed() const { return _pvt->meta.database_name_changed; }
+const char* kdbx2::database_description() const { return _pvt->meta.database_description; }
+timestamp kdbx2::database_description_changed() const { return _pvt->meta.database_description_changed; }
+const char* kdbx2::default_user_name() const { return _pvt->meta.default_user_name; }
+timestamp kdbx2::default_user_name_changed() const { return _pvt->meta.default_user_name_changed; }
+int kdbx2::maintenance_history_days() const { return _pvt->meta.maintenance_history_days; }
+const char* kdbx2::color() const { return _pvt->meta.color; }
+timestamp kdbx2::master_key_changed() const { return _pvt->meta.master_key_changed; }
+int64_t kdbx2::master_key_change_rec() const { return _pvt->meta.master_key_change_rec; }
+int64_t kdbx2::master_key_change_force() const { return _pvt->meta.master_key_change_force; }
+const memory_protection& kdbx2::memory_protection() const { return _pvt->meta.memory_protection; }
+bool kdbx2::recycle_bin_enabled() const { return _pvt->meta.recycle_bin_enabled; }
+const uuid& kdbx2::recycle_bin_uuid() const { return _pvt->meta.recycle_bin_uuid; }
+timestamp kdbx2::recycle_bin_changed() const { return _pvt->meta.recycle_bin_changed; }
+const uuid& kdbx2::entry_templates_group() const { return _pvt->meta.entry_templates_group; }
+timestamp kdbx2::entry_templates_group_changed() const { return _pvt->meta.entry_templates_group_changed; }
+int kdbx2::history_max_items() const { return _pvt->meta.history_max_items; }
+int64_t kdbx2::history_max_size() const { return _pvt->meta.history_max_size; }
+const uuid& kdbx2::last_selected_group() const { return _pvt->meta.last_selected_group; }
+const uuid& kdbx2::last_top_visible_group() const { return _pvt->meta.last_top_visible_group; }
+const std::vector<custom_icon>& kdbx2::custom_icons() const { return _pvt->meta.custom_icons; }
+const std::vector<binary_record>& kdbx2::binaries() const { return _pvt->meta.binaries; }
 
 //
 // Groups
 //
-const std::vector<group>& kdbx2::groups() const { return _pvt->groups; }
+group_range kdbx2::groups() const
+{
+    return group_range(_pvt.get(), _pvt->tree.first_group);
+}
+
+index_range<group> kdbx2::all_groups() const
+{
+    return index_range<group>(_pvt.get(), 0, static_cast<uint32_t>(_pvt->tree.groups.size()));
+}
+
+index_range<entry> kdbx2::all_entries() const
+{
+    return index_range<entry>(_pvt.get(), 0, static_cast<uint32_t>(_pvt->tree.entries.size()));
+}
+
+group kdbx2::find_group_by_path(const std::string& path) const
+{
+    group_range candidates = groups();
+    group found;
+    string::size_type start = 0;
+
+    while (true) {
+        string::size_type end = path.find('/', start);
+        string name = path.substr(start, end == string::npos ? string::npos : end - start);
+
+        found = group();
+
+        for (group g : candidates) {
+            if (name == g.name()) {
+                found = g;
+                break;
+            }
+        }
+
+        if (!found || end == string::npos) {
+            return found;
+        }
+
+        candidates = found.groups();
+        start = end + 1;
+    }
+}
+
+//
+// Lookup by UUID
+//
+group kdbx2::find_group(const uuid& id) const
+{
+    const uint32_t* found = _pvt->group_index.find(id);
+    return found ? group(*_pvt, *found) : group();
+}
+
+entry kdbx2::find_entry(const uuid& id) const
+{
+    const uint32_t* found = _pvt->entry_index.find(id);
+    return found ? entry(*_pvt, *found) : entry();
+}
+
+bool kdbx2::is_deleted(const uuid& id) const
+{
+    return _pvt->deleted_index.find(id) != NULL;
+}
+
+group kdbx2::recycle_bin() const
+{
+    const meta_info& meta = _pvt->meta;
+
+    if (!meta.recycle_bin_enabled || meta.recycle_bin_uuid.is_nil()) {
+        return group();
+    }
+
+    return find_group(meta.recycle_bin_uuid);
+}
+
+void kdbx2::set_search_index(bool enabled)
+{
+    if (!enabled) {
+        _pvt->search.reset();
+    } else if (!_pvt->search) {
+        _pvt->search = std::make_unique<search_index>();
+        _pvt->search->build(_pvt->tree);
+    }
+}
+
+vector<entry> kdbx2::search(const string& query, size_t limit) const
+{
+    vector<uint32_t> found = _pvt->search
+        ? _pvt->search->search(query, limit)
+        : search_index::scan(_pvt->tree, query, limit);
+
+    vector<entry> results;
+    results.reserve(found.size());
+
+    for (uint32_t index : found) {
+        results.push_back(entry(*_pvt, index));
+    }
+
+    return results;
+}
+
+void kdbx2::reindex(const entry& e)
+{
+    if (_pvt->search && e) {
+        _pvt->search->update(e.index());
+    }
+}
+
+vector<entry> kdbx2::match_url(const string& url, size_t limit) const
+{
+    vector<url_index::match> found;
+    _pvt->urls.find(url, found);
+
+    vector<entry> results;
+    results.reserve(std::min(found.size(), limit));
+
+    for (size_t ii = 0; ii < found.size() && ii < limit; ii++) {
+        results.push_back(entry(*_pvt, found[ii].entry));
+    }
+
+    return results;
+}
 
 }
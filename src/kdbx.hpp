@@ -6,17 +6,35 @@
 #include <vector>
 #include <memory>
 
+#include "changes.hpp"
 #include "errors.hpp"
 #include "group.hpp"
+#include "load_stats.hpp"
+#include "meta.hpp"
+#include "uuid.hpp"
 
 namespace kdbx
 {
 
 class kdbx2_pvt;
+class key_cache;
+class semaphore;
 
+/*
+ * Const members may be called from any number of threads at once, as long
+ * as nothing calls the others meanwhile. Share a finished database between
+ * threads as a snapshot (see snapshot.hpp).
+ *
+ * The library replaces pugixml's process wide memory management functions
+ * before main runs, so documents can live in secure memory. A program that
+ * also uses pugixml must not call pugi::set_memory_management_functions();
+ * once it has, loads, merges and reloads throw std::logic_error.
+ */
 class kdbx2
 {
 private:
+    friend class kdbx2_pvt;
+
     std::unique_ptr<kdbx2_pvt> _pvt;
 
 public:
@@ -34,6 +52,8 @@ public:
     const std::string& comment() const;
     const std::string& cipher_id() const;
     uint32_t compression_flags() const;
+
+    // AES-KDF rounds, or Argon2 iterations for KDBX 4
     uint64_t transform_rounds() const;
     uint32_t inner_random_stream_id() const;
 
@@ -43,34 +63,133 @@ public:
     const char* generator() const;
     const char* header_hash() const;
     const char* database_name() const;
-    const char* database_name_changed() const;
+    timestamp database_name_changed() const;
     const char* database_description() const;
-    const char* database_description_changed() const;
+    timestamp database_description_changed() const;
     const char* default_user_name() const;
-    const char* default_user_name_changed() const;
-    const char* maintenance_history_days() const;
+    timestamp default_user_name_changed() const;
+    int maintenance_history_days() const;
     const char* color() const;
-    const char* master_key_changed() const;
-    int master_key_change_rec() const;
-    int master_key_change_force() const;
+    timestamp master_key_changed() const;
+    int64_t master_key_change_rec() const;
+    int64_t master_key_change_force() const;
+    const kdbx::memory_protection& memory_protection() const;
     bool recycle_bin_enabled() const;
-    const char* recycle_bin_uuid() const;
-    const char* recycle_bin_changed() const;
-    const char* entry_templates_group() const;
-    const char* entry_templates_group_changed() const;
-    const char* history_max_items() const;
-    const char* history_max_size() const;
-    const char* last_selected_group() const;
-    const char* last_top_visible_group() const;
+    const uuid& recycle_bin_uuid() const;
+    timestamp recycle_bin_changed() const;
+    const uuid& entry_templates_group() const;
+    timestamp entry_templates_group_changed() const;
+    int history_max_items() const;
+    int64_t history_max_size() const;
+    const uuid& last_selected_group() const;
+    const uuid& last_top_visible_group() const;
+    const std::vector<custom_icon>& custom_icons() const;
+    const std::vector<binary_record>& binaries() const;
 
     //
     // Groups
     //
-    const std::vector<group>& groups() const;
+    group_range groups() const;
+
+    // Every group and entry, in pre-order
+    index_range<group> all_groups() const;
+    index_range<entry> all_entries() const;
+
+    // Slash separated group names, starting at a top level group
+    group find_group_by_path(const std::string& path) const;
+
+    //
+    // Lookup by UUID, across the whole tree
+    //
+    group find_group(const uuid& id) const;
+    entry find_entry(const uuid& id) const;
+    bool is_deleted(const uuid& id) const;
+    group recycle_bin() const;
+
+    //
+    // Search
+    //
+
+    // Keep a trigram index of entry fields, built now and after each load
+    void set_search_index(bool enabled);
+
+    // Entries whose non-protected Title, UserName, URL or Notes contain the
+    // query, ignoring ASCII case. Scans every entry when there's no index.
+    std::vector<entry> search(const std::string& query, size_t limit) const;
+
+    // Refresh the index after an entry's fields have changed
+    void reindex(const entry& e);
+
+    // Entries whose URL host is the host of url or a parent domain of it,
+    // best match first
+    std::vector<entry> match_url(const std::string& url, size_t limit) const;
 
     void push_key(const std::string& key);
     void clear_keys();
+
+    // Share transformed keys with other loads (pass nullptr to disable)
+    void set_key_cache(std::shared_ptr<key_cache> cache);
+
+    // Hold a slot while transforming the key (pass nullptr to disable)
+    void set_kdf_limit(std::shared_ptr<semaphore> slots);
+
+    // Verify up to this many hashed blocks ahead of the parser on worker
+    // threads (zero verifies each block inline)
+    void set_read_ahead(size_t blocks);
+
+    // Record timings and counters during each load
+    void set_load_stats(bool enabled);
+
+    // Called with the statistics after each successful load. Setting a
+    // callback also turns the statistics on.
+    void set_load_stats_callback(load_stats_callback callback);
+
+    // Statistics of the last load, NULL unless they are enabled
+    const load_stats* stats() const;
+
+    // A load that fails once the body is being read leaves no groups or
+    // entries behind (use reload() to keep the old ones)
     void load(std::istream& in);
+
+    // Read only the signature, version and header fields, leaving in at
+    // the start of the body. Needs no keys.
+    void load_header(std::istream& in);
+
+    // Parse a database held in memory, without copying the ciphertext
+    void load(const void* data, size_t length);
+
+    // Map the file and load it from memory
+    void load_file(const std::string& path);
+
+    // Load the file given to load_file again if it has changed, reusing the
+    // transformed key while the transform seed and rounds are the same.
+    // Handles from before a reload are invalid afterwards. If the reload
+    // fails, the database is left as it was.
+    change_set reload();
+
+    // Load from an encrypted cache of the file's groups, entries and meta
+    // when it still matches the file, skipping decryption and XML parsing.
+    // Otherwise load the file and write a new cache, unless that fails.
+    // Returns true if the cache was used. A database loaded from a cache
+    // can't be saved, since it has no XML.
+    bool load_cached(const std::string& path, const std::string& cache_path);
+
+    // Write a cache of the database loaded from path by load_file
+    void save_cache(const std::string& cache_path) const;
+
+    // Merge another copy of the database into this one. Groups and entries
+    // are matched by UUID and the version with the later modification time
+    // wins, with the other kept in the entry's History. Deleted objects on
+    // either side remove what hasn't been modified since. Both databases
+    // need their XML (so neither loaded from a cache) and the same major
+    // version. Handles from before a merge are invalid afterwards, and the
+    // merged database can be saved but not cached.
+    change_set merge(const kdbx2& other);
+
+    // Write the database with fresh seeds. The key transformed at load is
+    // reused unless different keys have been pushed since. Only KDBX 3
+    // databases can be written.
+    void save(std::ostream& out);
 };
 
 
@@ -0,0 +1,478 @@
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+
+#include <cstring>
+
+#include "cryptopp/aes.h"
+#include "cryptopp/chacha.h"
+#include "cryptopp/hmac.h"
+#include "cryptopp/modes.h"
+
+#include "future.hpp"
+
+#include "argon2.hpp"
+#include "cryptbuf.hpp"
+#include "gzipbuf.hpp"
+#include "hmacbuf.hpp"
+#include "io.hpp"
+#include "membuf.hpp"
+#include "meterbuf.hpp"
+
+using std::istream;
+using std::string;
+using std::vector;
+
+using CryptoPP::AES;
+using CryptoPP::CBC_Mode;
+using CryptoPP::ChaChaTLS;
+using CryptoPP::HMAC;
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+using CryptoPP::SHA512;
+using CryptoPP::StreamTransformation;
+
+namespace kdbx
+{
+
+static const byte AES_KDF_ID[] = {
+    0xC9, 0xD9, 0xF3, 0x9A, 0x62, 0x8A, 0x44, 0x60,
+    0xBF, 0x74, 0x0D, 0x08, 0xC1, 0x8A, 0x4F, 0xEA,
+};
+
+static const byte ARGON2D_KDF_ID[] = {
+    0xEF, 0x63, 0x6D, 0xDF, 0x8C, 0x29, 0x44, 0x4B,
+    0x91, 0xF7, 0xA9, 0xA4, 0x03, 0xE3, 0x0A, 0x0C,
+};
+
+static const byte ARGON2ID_KDF_ID[] = {
+    0x9E, 0x29, 0x8B, 0x19, 0x56, 0xDB, 0x47, 0x73,
+    0xB2, 0x3D, 0xFC, 0x3E, 0xC6, 0xF0, 0xA1, 0xE6,
+};
+
+static const size_t AES_IV_SIZE = 16;
+static const size_t CHACHA20_IV_SIZE = 12;
+
+// Far more than any real header field, but keeps a damaged length from
+// allocating gigabytes
+static const uint32_t MAX_FIELD_SIZE = 16 * 1024 * 1024;
+
+static const uint64_t HEADER_BLOCK_INDEX = 0xFFFFFFFFFFFFFFFFull;
+
+template<size_t N>
+static bool matches(const byte (&id)[N], const void* data, size_t length)
+{
+    return length == N && !std::memcmp(id, data, N);
+}
+
+template<typename T>
+static void append(SecByteBlock& out, const T& value)
+{
+    SecByteBlock bytes(reinterpret_cast<const byte*>(&value), sizeof(value));
+    out += bytes;
+}
+
+void kdbx2_pvt::parse_fields_v4(istream& in)
+{
+    /*
+     * Like KDBX 3, except that lengths are 32 bits:
+     *
+     * struct {
+     *    uint8_t field_id;
+     *    uint32_t data_length;
+     *    uint8_t data[];
+     * };
+     *
+     * The header is followed by its SHA-256 digest and an HMAC-SHA256 that
+     * can only be checked once the key is known.
+     */
+
+    // Nothing may carry over from a previous load
+    master_seed.New(0);
+    encryption_iv.New(0);
+    transform_seed.New(0);
+    stream_start_bytes.New(0);
+    public_custom_data.clear();
+
+    // Keep the header as read, for the digest and the HMAC
+    header_data.New(0);
+    append(header_data, signature1);
+    append(header_data, signature2);
+    append(header_data, file_version);
+
+    uint8_t field_id;
+    uint32_t length;
+    SecByteBlock data;
+
+    while (true) {
+        read(in, field_id);
+        read(in, length);
+
+        if (!in) {
+            throw parse_error("header truncated");
+        }
+
+        if (length > MAX_FIELD_SIZE) {
+            throw parse_error("header field too large");
+        }
+
+        read(in, data, length);
+
+        if (!in) {
+            throw parse_error("header truncated");
+        }
+
+        append(header_data, field_id);
+        append(header_data, length);
+        header_data += data;
+
+        switch (field_id) {
+            case FieldID::END_OF_HEADER:
+                break;
+
+            case FieldID::COMMENT:
+                comment.assign(reinterpret_cast<const char*>(data.data()), data.size());
+                continue;
+
+            case FieldID::CIPHER_ID:
+                cipher_id.assign(reinterpret_cast<const char*>(data.data()), data.size());
+                continue;
+
+            case FieldID::COMPRESSION_FLAGS:
+                if (length != sizeof(compression_flags)) {
+                    throw parse_error("compression flags format unknown");
+                }
+                std::memcpy(&compression_flags, data.data(), sizeof(compression_flags));
+                continue;
+
+            case FieldID::MASTER_SEED:
+                if (length != 32) {
+                    throw parse_error("master seed unknown format");
+                }
+                master_seed = data;
+                continue;
+
+            case FieldID::ENCRYPTION_IV:
+                encryption_iv = data;
+                continue;
+
+            case FieldID::KDF_PARAMETERS:
+                parse_kdf_parameters(data);
+                continue;
+
+            case FieldID::PUBLIC_CUSTOM_DATA:
+                public_custom_data.parse(data.data(), data.size());
+                continue;
+
+            default:
+                throw parse_error("unknown header field");
+        }
+
+        break;
+    }
+
+    SecByteBlock digest;
+    read(in, digest, SHA256::DIGESTSIZE);
+    read(in, header_hmac, SHA256::DIGESTSIZE);
+
+    if (!in) {
+        throw parse_error("header truncated");
+    }
+
+    // Damage shows up here, a wrong key only once the HMAC is checked
+    if (!SHA256().VerifyDigest(digest.data(), header_data.data(), header_data.size())) {
+        throw parse_error("header hash mismatch");
+    }
+
+    // Nothing below the header is optional
+    if (master_seed.empty() || encryption_iv.empty() || transform_seed.empty()) {
+        throw parse_error("header incomplete");
+    }
+}
+
+void kdbx2_pvt::parse_kdf_parameters(const SecByteBlock& data)
+{
+    variant_dictionary params;
+    params.parse(data.data(), data.size());
+
+    SecByteBlock id;
+
+    if (!params.get("$UUID", id)) {
+        throw parse_error("KDF parameters incomplete");
+    }
+
+    if (matches(AES_KDF_ID, id.data(), id.size())) {
+        kdf = KDF::AES_KDF;
+
+        if (!params.get("R", transform_rounds) || !params.get("S", transform_seed)) {
+            throw parse_error("KDF parameters incomplete");
+        }
+
+        return;
+    }
+
+    argon2_parameters& a = argon2_params;
+
+    if (matches(ARGON2D_KDF_ID, id.data(), id.size())) {
+        a.type = argon2_parameters::ARGON2D;
+    } else if (matches(ARGON2ID_KDF_ID, id.data(), id.size())) {
+        a.type = argon2_parameters::ARGON2ID;
+    } else {
+        throw parse_error("unsupported KDF");
+    }
+
+    kdf = KDF::ARGON2;
+
+    if (!params.get("S", a.salt) || !params.get("P", a.parallelism)
+            || !params.get("M", a.memory) || !params.get("I", a.iterations)
+            || !params.get("V", a.version)) {
+        throw parse_error("KDF parameters incomplete");
+    }
+
+    // The secret key and associated data are optional
+    if (!params.get("K", a.secret)) {
+        a.secret.New(0);
+    }
+
+    if (!params.get("A", a.associated)) {
+        a.associated.New(0);
+    }
+
+    // Reject bad parameters before anyone waits for a key
+    argon2 check(a);
+
+    transform_rounds = a.iterations;
+    transform_seed.New(SHA256::DIGESTSIZE);
+    SHA256().CalculateDigest(transform_seed.data(), data.data(), data.size());
+}
+
+void kdbx2_pvt::parse_body_v4(istream& in)
+{
+    load_stats* stats = this->stats.get();
+
+    SecByteBlock master_key;
+    bool cached;
+
+    {
+        phase_timer timer(stats, &load_stats::key_transform);
+        cached = derive_master_key(master_key);
+    }
+
+    if (stats) {
+        stats->key_cached = cached;
+    }
+
+    // Blocks are authenticated with a key of their own
+    SecByteBlock hmac_key(SHA512::DIGESTSIZE);
+
+    {
+        const byte one = 1;
+        SHA512 hash;
+        hash.Update(master_seed.data(), master_seed.size());
+        hash.Update(transformed_key.data(), transformed_key.size());
+        hash.Update(&one, sizeof(one));
+        hash.Final(hmac_key.data());
+    }
+
+    // The header's HMAC is the first thing that needs the key, so a
+    // mismatch means the key is wrong
+    {
+        SecByteBlock header_key;
+        hmacbuf::block_key(hmac_key, HEADER_BLOCK_INDEX, header_key);
+
+        HMAC<SHA256> hmac(header_key.data(), header_key.size());
+        hmac.Update(header_data.data(), header_data.size());
+
+        if (!hmac.Verify(header_hmac.data())) {
+            throw parse_error("incorrect password");
+        }
+    }
+
+    // Only remember keys that are known to be correct
+    if (cache && !cached) {
+        cache->insert(composite_key, transform_seed, transform_rounds, transformed_key);
+    }
+
+    // With statistics on, each stage reads through a meterbuf that counts
+    // what it is handed and how long that took
+    stage_meters meters(stats);
+
+    // Authenticate the ciphertext, block by block
+    membuf* mapped = dynamic_cast<membuf*>(in.rdbuf());
+    size_t estimate = mapped ? mapped->remaining() : 0;
+
+    if (stats) {
+        stats->bytes_read = estimate;
+    }
+
+    hmacbuf blocks(in, hmac_key);
+    istream block_stream(meters.add(&blocks, &load_stats::verify, NULL));
+    block_stream.exceptions(std::ios::badbit);
+
+    // Then decrypt it
+    std::unique_ptr<StreamTransformation> cipher;
+
+    if (matches(AES_CIPHER_ID, cipher_id.data(), cipher_id.size())) {
+        if (encryption_iv.size() != AES_IV_SIZE) {
+            throw parse_error("encryption iv unknown format");
+        }
+
+        cipher = std::make_unique<CBC_Mode<AES>::Decryption>(master_key, master_key.size(),
+                                                                encryption_iv.data());
+    } else if (matches(CHACHA20_CIPHER_ID, cipher_id.data(), cipher_id.size())) {
+        if (encryption_iv.size() != CHACHA20_IV_SIZE) {
+            throw parse_error("encryption iv unknown format");
+        }
+
+        std::unique_ptr<ChaChaTLS::Decryption> chacha = std::make_unique<ChaChaTLS::Decryption>();
+        chacha->SetKeyWithIV(master_key.data(), master_key.size(),
+                                encryption_iv.data(), encryption_iv.size());
+        cipher = std::move(chacha);
+    } else {
+        throw parse_error("unsupported cipher");
+    }
+
+    cryptbuf decrypted(block_stream, *cipher);
+    istream crypt_stream(meters.add(&decrypted, &load_stats::decrypt, &load_stats::bytes_decrypted));
+    crypt_stream.exceptions(std::ios::badbit);
+
+    // Decompress the inner header and XML as they are read, if needed
+    std::unique_ptr<gzipbuf> inflated;
+
+    switch (compression_flags) {
+        case Compression::NONE:
+            break;
+
+        case Compression::GZIP:
+            inflated = std::make_unique<gzipbuf>(crypt_stream);
+            estimate *= 4;
+            break;
+
+        default:
+            throw parse_error("unknown compression algorithm");
+    }
+
+    istream xml_stream(inflated
+        ? meters.add(inflated.get(), &load_stats::decompress, &load_stats::bytes_decompressed)
+        : crypt_stream.rdbuf());
+    xml_stream.exceptions(std::ios::badbit);
+
+    // The old document's memory goes before anything new is counted
+    clear_document();
+
+    vector<binary_record> binaries;
+
+    {
+        phase_timer timer(stats, &load_stats::xml_parse);
+
+        parse_inner_header(xml_stream, binaries);
+
+        size_t length;
+        char* text = read_text(xml_stream, estimate, length);
+        parse_xml(text, length);
+    }
+
+    meters.finish();
+
+    if (stats) {
+        stats->hashed_blocks = blocks.blocks();
+    }
+
+    build_tree();
+
+    // Attachments live in the inner header rather than in Meta
+    meta.binaries.insert(meta.binaries.end(), binaries.begin(), binaries.end());
+    attachments.build(meta.binaries);
+}
+
+void kdbx2_pvt::parse_inner_header(istream& in, vector<binary_record>& binaries)
+{
+    /*
+     * The fields are:
+     *
+     * struct {
+     *    uint8_t field_id;
+     *    int32_t data_length;
+     *    uint8_t data[];
+     * };
+     *
+     * Binaries are numbered in the order they appear, which is how entries
+     * refer to them.
+     */
+    inner_random_stream_id = protected_stream::NONE;
+    protected_stream_key.New(0);
+
+    uint8_t field_id;
+    int32_t length;
+
+    while (true) {
+        read(in, field_id);
+        read(in, length);
+
+        if (!in) {
+            throw parse_error("inner header truncated");
+        }
+
+        if (length < 0) {
+            throw parse_error("inner header field invalid");
+        }
+
+        switch (field_id) {
+            case InnerFieldID::END_OF_INNER_HEADER:
+                in.ignore(length);
+                break;
+
+            case InnerFieldID::INNER_STREAM_ID:
+                if (length != sizeof(inner_random_stream_id)) {
+                    throw parse_error("inner random stream id unknown format");
+                }
+                read(in, inner_random_stream_id);
+                break;
+
+            case InnerFieldID::INNER_STREAM_KEY:
+                read(in, protected_stream_key, static_cast<size_t>(length));
+                break;
+
+            case InnerFieldID::BINARY:
+            {
+                if (length < 1) {
+                    throw parse_error("inner header binary unknown format");
+                }
+
+                // Bit 0 asks for the contents to be kept protected in
+                // memory, which the arena always does
+                uint8_t flags;
+                read(in, flags);
+
+                size_t size = static_cast<size_t>(length) - 1;
+                char* data = static_cast<char*>(arena.allocate(size ? size : 1));
+                in.read(data, static_cast<std::streamsize>(size));
+
+                binary_record record;
+                record.id = static_cast<uint32_t>(binaries.size());
+                record.compressed = false;
+                record.is_protected = false;
+                record.protected_offset = 0;
+                record.data = data;
+                record.length = size;
+                record.raw = true;
+                binaries.push_back(record);
+                break;
+            }
+
+            default:
+                // Newer fields can be skipped
+                in.ignore(length);
+                break;
+        }
+
+        if (!in) {
+            throw parse_error("inner header truncated");
+        }
+
+        if (field_id == InnerFieldID::END_OF_INNER_HEADER) {
+            return;
+        }
+    }
+}
+
+}
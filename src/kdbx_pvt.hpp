@@ -0,0 +1,286 @@
+#ifndef KDBX_PVT_HPP
+#define KDBX_PVT_HPP 1
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cryptopp/secblock.h"
+#include "cryptopp/sha.h"
+
+#include "pugixml.hpp"
+
+#include "arena.hpp"
+#include "argon2.hpp"
+#include "attachment_store.hpp"
+#include "kdbx.hpp"
+#include "keycache.hpp"
+#include "load_stats.hpp"
+#include "mapped_file.hpp"
+#include "meta.hpp"
+#include "protected_stream.hpp"
+#include "search_index.hpp"
+#include "semaphore.hpp"
+#include "tree.hpp"
+#include "url_index.hpp"
+#include "uuid_index.hpp"
+#include "variant_dictionary.hpp"
+
+namespace kdbx
+{
+
+// Outer ciphers, as named by the CIPHER_ID header field
+static const byte AES_CIPHER_ID[] = {
+    0x31, 0xC1, 0xF2, 0xE6, 0xBF, 0x71, 0x43, 0x50,
+    0xBE, 0x58, 0x05, 0x21, 0x6A, 0xFC, 0x5A, 0xFF,
+};
+
+static const byte CHACHA20_CIPHER_ID[] = {
+    0xD6, 0x03, 0x8A, 0x2B, 0x8B, 0x6F, 0x4C, 0xB5,
+    0xA5, 0x24, 0x33, 0x9A, 0x31, 0xDB, 0xB5, 0x9A,
+};
+
+class kdbx2_pvt
+{
+private:
+    kdbx2& _pub;
+
+public:
+    kdbx2_pvt(kdbx2& pub) : _pub(pub) {}
+
+    // The state behind a database, for tests and tools that build one
+    // without a file
+    static kdbx2_pvt& of(kdbx2& db) { return *db._pvt; }
+
+    //
+    // Header
+    //
+    const uint32_t SIGNATURE[2] = {0x9AA2D903, 0xB54BFB67};
+
+    enum FieldID
+    {
+        END_OF_HEADER = 0,
+        COMMENT,
+        CIPHER_ID,
+        COMPRESSION_FLAGS,
+        MASTER_SEED,
+        TRANSFORM_SEED,
+        TRANSFORM_ROUNDS,
+        ENCRYPTION_IV,
+        PROTECTED_STREAM_KEY,
+        STREAM_START_BYTES,
+        INNER_RANDOM_STREAM_ID,
+        KDF_PARAMETERS,
+        PUBLIC_CUSTOM_DATA,
+    };
+
+    // Fields of the KDBX 4 inner header, ahead of the XML
+    enum InnerFieldID
+    {
+        END_OF_INNER_HEADER = 0,
+        INNER_STREAM_ID,
+        INNER_STREAM_KEY,
+        BINARY,
+    };
+
+    enum KDF
+    {
+        AES_KDF = 0,
+        ARGON2,
+    };
+
+    enum Compression
+    {
+        NONE = 0,
+        GZIP,
+    };
+
+
+    uint32_t signature1;
+    uint32_t signature2;
+    uint32_t file_version = 0x00030001;
+
+    std::string comment;
+    std::string cipher_id;
+    uint32_t compression_flags = Compression::GZIP;
+    CryptoPP::SecByteBlock master_seed;
+    CryptoPP::SecByteBlock transform_seed;
+    uint64_t transform_rounds = 6000;
+    CryptoPP::SecByteBlock encryption_iv;
+    CryptoPP::SecByteBlock protected_stream_key;
+    CryptoPP::SecByteBlock stream_start_bytes;
+    uint32_t inner_random_stream_id = protected_stream::SALSA20;
+
+    // KDBX 4 only. For Argon2, transform_seed is a digest of every KDF
+    // parameter and transform_rounds the iterations, so the key cache and
+    // reloads tell parameter sets apart.
+    uint32_t kdf = KDF::AES_KDF;
+    argon2_parameters argon2_params;
+    variant_dictionary public_custom_data;
+
+    // The header as read, and the HMAC stored after it
+    CryptoPP::SecByteBlock header_data;
+    CryptoPP::SecByteBlock header_hmac;
+
+    //
+    // Protected values
+    //
+    std::unique_ptr<protected_stream> inner_stream;
+    protected_map protected_values;
+    uint64_t protected_offset;
+    uint64_t element_count;
+
+    void index_protected(const pugi::xml_node& node);
+
+    CryptoPP::SHA256 keys;
+    CryptoPP::SecByteBlock composite_key;
+    CryptoPP::SecByteBlock transformed_key;
+
+    // What transformed_key was derived with
+    CryptoPP::SecByteBlock transformed_seed;
+    uint64_t transformed_rounds = 0;
+
+    std::shared_ptr<key_cache> cache;
+    std::shared_ptr<semaphore> kdf_slots;
+    size_t read_ahead = 0;
+
+    std::unique_ptr<load_stats> stats;
+    load_stats_callback stats_callback;
+
+    void compute_composite_key(CryptoPP::SecByteBlock& out) const;
+    bool transform_key();
+    void combine_master_key(const CryptoPP::SecByteBlock& seed,
+                            CryptoPP::SecByteBlock& master_key) const;
+    bool derive_master_key(CryptoPP::SecByteBlock& master_key);
+
+    //
+    // Reloading
+    //
+    std::string source_path;
+    file_stamp source_stamp;
+
+    // Copies the keys and options set on another instance. Statistics are
+    // turned on or off to match, but their figures stay this instance's.
+    void take_settings(const kdbx2_pvt& other);
+
+    // Copies the key another instance derived from the same keys. A load
+    // only uses it while the transform seed and rounds still match.
+    void take_derived_key(const kdbx2_pvt& other);
+
+    // Lists what differs between before and the current tree
+    void diff_tree(const kdbx::tree& before, const uuid_index<uint32_t>& groups_before,
+                    const uuid_index<uint32_t>& entries_before, change_set& changes) const;
+
+    //
+    // Merging
+    //
+
+    // Another database has been merged in since the load, so the document
+    // no longer matches the file
+    bool merged = false;
+
+    //
+    // Cache
+    //
+    bool from_cache = false;
+
+    // The header has already been read from source
+    bool read_cache(const mapped_file& source, size_t header_length,
+                    const std::string& cache_path);
+    void write_cache(const mapped_file& source, size_t header_length,
+                        const std::string& cache_path) const;
+    void encode_cache(CryptoPP::SecByteBlock& out) const;
+    bool decode_cache(char* data, size_t size);
+
+    void parse_signature(std::istream& in);
+    void parse_fields(std::istream& in);
+    void parse_fields_v1(std::istream& in);
+    void parse_fields_v4(std::istream& in);
+    void parse_kdf_parameters(const CryptoPP::SecByteBlock& data);
+
+    void parse_body(std::istream& in);
+    void parse_body_v1(std::istream& in);
+    void parse_body_v4(std::istream& in);
+
+    // Reads the KDBX 4 inner header, keeping attachments in the arena
+    void parse_inner_header(std::istream& in, std::vector<binary_record>& binaries);
+
+    // Parses the XML in place and builds the tree and indices from it
+    void parse_xml(char* text, size_t length);
+    void build_tree();
+
+    // Frees the document and the arena along with everything that points
+    // into them, so a failed load leaves nothing dangling
+    void clear_document();
+
+    // Reads the rest of in into the arena
+    char* read_text(std::istream& in, size_t estimate, size_t& length);
+
+    //
+    // Writing
+    //
+    struct save_state
+    {
+        CryptoPP::SecByteBlock master_seed;
+        CryptoPP::SecByteBlock encryption_iv;
+        CryptoPP::SecByteBlock protected_stream_key;
+        CryptoPP::SecByteBlock stream_start_bytes;
+        std::string header_hash;
+    };
+
+    void prepare_key();
+    void write_header(std::ostream& out, save_state& state) const;
+    void write_body(std::ostream& out, const save_state& state) const;
+    void write_body_v1(std::ostream& out, const save_state& state) const;
+
+    //
+    // Meta
+    //
+    meta_info meta;
+
+    void parse_meta(const pugi::xml_node& node);
+
+    //
+    // Attachments
+    //
+
+    // Indexes meta.binaries, so it is rebuilt whenever they change
+    attachment_store attachments;
+
+    //
+    // Groups and entries
+    //
+    kdbx::tree tree;
+
+    //
+    // UUID index
+    //
+    uuid_index<uint32_t> group_index;
+    uuid_index<uint32_t> entry_index;
+    uuid_index<const char*> deleted_index;
+
+    void index_tree();
+    void index_deleted(const pugi::xml_node& node);
+
+    //
+    // Search
+    //
+    std::unique_ptr<search_index> search;
+    url_index urls;
+
+    //
+    // XML
+    //
+
+    // Holds the XML text, parsed in place, and the document's nodes. It
+    // has to outlive the document.
+    secure_arena arena;
+    pugi::xml_document document;
+};
+
+}
+
+#endif
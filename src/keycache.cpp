@@ -0,0 +1,95 @@
+#include "keycache.hpp"
+
+#include "cryptopp/sha.h"
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+
+namespace kdbx
+{
+
+key_cache::key_cache()
+{
+
+}
+
+key_cache::~key_cache()
+{
+    clear();
+}
+
+string key_cache::fingerprint(const SecByteBlock& composite,
+                                const SecByteBlock& seed,
+                                uint64_t rounds)
+{
+    byte encoded[sizeof(rounds)];
+    for (size_t ii = 0; ii < sizeof(rounds); ii++) {
+        encoded[ii] = static_cast<byte>(rounds >> (8 * ii));
+    }
+
+    SHA256 hash;
+    hash.Update(composite.data(), composite.size());
+    hash.Update(seed.data(), seed.size());
+    hash.Update(encoded, sizeof(encoded));
+
+    string digest(SHA256::DIGESTSIZE, '\0');
+    hash.Final(reinterpret_cast<byte*>(&digest[0]));
+    return digest;
+}
+
+bool key_cache::find(const SecByteBlock& composite,
+                        const SecByteBlock& seed,
+                        uint64_t rounds,
+                        SecByteBlock& transformed) const
+{
+    string key = fingerprint(composite, seed, rounds);
+
+    lock_guard<mutex> lock(_mutex);
+    auto found = _entries.find(key);
+
+    if (found == _entries.end()) {
+        return false;
+    }
+
+    transformed = found->second;
+    return true;
+}
+
+void key_cache::insert(const SecByteBlock& composite,
+                        const SecByteBlock& seed,
+                        uint64_t rounds,
+                        const SecByteBlock& transformed)
+{
+    string key = fingerprint(composite, seed, rounds);
+
+    lock_guard<mutex> lock(_mutex);
+    _entries[key] = transformed;
+}
+
+bool key_cache::evict(const SecByteBlock& composite,
+                        const SecByteBlock& seed,
+                        uint64_t rounds)
+{
+    string key = fingerprint(composite, seed, rounds);
+
+    lock_guard<mutex> lock(_mutex);
+    return _entries.erase(key) != 0;
+}
+
+void key_cache::clear()
+{
+    lock_guard<mutex> lock(_mutex);
+    _entries.clear();
+}
+
+size_t key_cache::size() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _entries.size();
+}
+
+}
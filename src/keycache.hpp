@@ -0,0 +1,57 @@
+#ifndef KEYCACHE_HPP
+#define KEYCACHE_HPP 1
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * In-process cache of transformed keys.
+ *
+ * Entries are looked up by a SHA-256 fingerprint of the composite key, the
+ * transform seed and the number of transform rounds, so a database with an
+ * unchanged header can skip the key derivation entirely. The transformed
+ * keys are kept in SecByteBlocks and wiped when evicted or cleared.
+ */
+class key_cache
+{
+private:
+    key_cache(const key_cache&);
+    key_cache& operator=(const key_cache&);
+
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, CryptoPP::SecByteBlock> _entries;
+
+    static std::string fingerprint(const CryptoPP::SecByteBlock& composite,
+                                    const CryptoPP::SecByteBlock& seed,
+                                    uint64_t rounds);
+
+public:
+    key_cache();
+    ~key_cache();
+
+    bool find(const CryptoPP::SecByteBlock& composite,
+                const CryptoPP::SecByteBlock& seed,
+                uint64_t rounds,
+                CryptoPP::SecByteBlock& transformed) const;
+
+    void insert(const CryptoPP::SecByteBlock& composite,
+                const CryptoPP::SecByteBlock& seed,
+                uint64_t rounds,
+                const CryptoPP::SecByteBlock& transformed);
+
+    bool evict(const CryptoPP::SecByteBlock& composite,
+                const CryptoPP::SecByteBlock& seed,
+                uint64_t rounds);
+
+    void clear();
+    size_t size() const;
+};
+
+}
+
+#endif
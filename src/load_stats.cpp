@@ -0,0 +1,47 @@
+#include "load_stats.hpp"
+
+namespace kdbx
+{
+
+void load_stats::clear()
+{
+    total = duration::zero();
+    header = duration::zero();
+    key_transform = duration::zero();
+    read = duration::zero();
+    decrypt = duration::zero();
+    verify = duration::zero();
+    decompress = duration::zero();
+    xml_parse = duration::zero();
+    build = duration::zero();
+
+    key_cached = false;
+
+    bytes_read = 0;
+    bytes_decrypted = 0;
+    bytes_decompressed = 0;
+
+    hashed_blocks = 0;
+    xml_nodes = 0;
+
+    allocations = 0;
+    allocated_bytes = 0;
+    peak_allocations = 0;
+}
+
+phase_timer::phase_timer(load_stats* stats, load_stats::duration load_stats::* phase)
+    : _phase(stats ? &(stats->*phase) : nullptr)
+{
+    if (_phase) {
+        _start = load_stats::clock::now();
+    }
+}
+
+phase_timer::~phase_timer()
+{
+    if (_phase) {
+        *_phase += load_stats::clock::now() - _start;
+    }
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef LOAD_STATS_HPP
+#define LOAD_STATS_HPP 1
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace kdbx
+{
+
+/*
+ * What one load spent its time and memory on.
+ *
+ * Decryption, verification, decompression and XML parsing run interleaved,
+ * each pulling from the one before it, so each of those phases is measured
+ * without the time it spent waiting on the phases below it.
+ */
+struct load_stats
+{
+    typedef std::chrono::steady_clock clock;
+    typedef clock::duration duration;
+
+    duration total;
+    duration header;
+    duration key_transform;
+    duration read;
+    duration decrypt;
+    duration verify;
+    duration decompress;
+    duration xml_parse;
+
+    // Meta, the group tree and the indices built over it
+    duration build;
+
+    bool key_cached;
+
+    // Ciphertext read, plaintext out of the cipher (including the stream
+    // start bytes and block framing) and XML out of the inflater
+    uint64_t bytes_read;
+    uint64_t bytes_decrypted;
+    uint64_t bytes_decompressed;
+
+    uint64_t hashed_blocks;
+    uint64_t xml_nodes;
+
+    // Allocations made for the XML document while it was parsed
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    uint64_t peak_allocations;
+
+    void clear();
+};
+
+typedef std::function<void(const load_stats&)> load_stats_callback;
+
+/*
+ * Adds the time until it is destroyed to one phase of a load_stats.
+ */
+class phase_timer
+{
+private:
+    phase_timer(const phase_timer&);
+    phase_timer& operator=(const phase_timer&);
+
+    load_stats::duration* _phase;
+    load_stats::clock::time_point _start;
+
+public:
+    // NULL stats do nothing
+    phase_timer(load_stats* stats, load_stats::duration load_stats::* phase);
+    ~phase_timer();
+};
+
+}
+
+#endif
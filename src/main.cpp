@@ -0,0 +1,35 @@
+#include <iostream>
+
+#include "kdbx.hpp"
+
+using std::cout;
+using std::endl;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        cout << "Usage:" << endl;
+        cout << "\t" << argv[0] << " <database>" << endl;
+        return 1;
+    }
+
+    kdbx::kdbx2 db;
+    db.push_key("test123");
+    db.load_file(argv[1]);
+
+    for (const kdbx::group& g : db.groups()) {
+        cout << g.uuid() << endl;
+        for (const kdbx::entry& e : g.entries()) {
+            cout << "\t" << e.uuid() << " " << e.get_string("UserName") << endl;
+        }
+    }
+
+#if 0
+    cout << "Signature: " << db.signature1() << ", " << db.signature2() << endl;
+    cout << "File Version: " << db.file_version() << endl;
+    cout << "Comment: (" << db.comment().size() << ") " << db.comment() << endl;
+    cout << "Cipher ID: (" << db.cipher_id().size() << ") " << db.cipher_id() << endl;
+    cout << "Compression Flags: " << db.compression_flags() << endl;
+    cout << "Transform Rounds: " << db.transform_rounds() << endl;
+#endif
+}
@@ -0,0 +1,91 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "errors.hpp"
+
+namespace kdbx
+{
+
+bool file_stamp::read(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) < 0) {
+        return false;
+    }
+
+    device = static_cast<uint64_t>(info.st_dev);
+    inode = static_cast<uint64_t>(info.st_ino);
+    size = static_cast<uint64_t>(info.st_size);
+    modified_sec = static_cast<int64_t>(info.st_mtim.tv_sec);
+    modified_nsec = static_cast<int64_t>(info.st_mtim.tv_nsec);
+    changed_sec = static_cast<int64_t>(info.st_ctim.tv_sec);
+    changed_nsec = static_cast<int64_t>(info.st_ctim.tv_nsec);
+    return true;
+}
+
+bool file_stamp::operator==(const file_stamp& other) const
+{
+    return device == other.device && inode == other.inode && size == other.size
+        && modified_sec == other.modified_sec && modified_nsec == other.modified_nsec
+        && changed_sec == other.changed_sec && changed_nsec == other.changed_nsec;
+}
+
+bool file_stamp::operator!=(const file_stamp& other) const
+{
+    return !(*this == other);
+}
+
+mapped_file::mapped_file(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw parse_error("unable to open file");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        throw parse_error("unable to open file");
+    }
+
+    _size = static_cast<size_t>(info.st_size);
+
+    // Zero length mappings are not allowed
+    if (_size) {
+        _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        throw parse_error("unable to map file");
+    }
+
+    if (_data) {
+        madvise(_data, _size, MADV_SEQUENTIAL);
+    }
+}
+
+mapped_file::~mapped_file()
+{
+    if (_data) {
+        munmap(_data, _size);
+    }
+}
+
+const void* mapped_file::data() const
+{
+    return _data;
+}
+
+size_t mapped_file::size() const
+{
+    return _size;
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kdbx
+{
+
+/*
+ * What stat() says about a file, enough to tell that it has been replaced
+ * or written to without reading it.
+ */
+struct file_stamp
+{
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t modified_sec = 0;
+    int64_t modified_nsec = 0;
+    int64_t changed_sec = 0;
+    int64_t changed_nsec = 0;
+
+    // False if the file can't be stat'ed
+    bool read(const std::string& path);
+
+    bool operator==(const file_stamp& other) const;
+    bool operator!=(const file_stamp& other) const;
+};
+
+/*
+ * Read only memory mapping of a whole file, unmapped on destruction.
+ */
+class mapped_file
+{
+private:
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+
+    void* _data = nullptr;
+    size_t _size = 0;
+
+public:
+    explicit mapped_file(const std::string& path);
+    ~mapped_file();
+
+    const void* data() const;
+    size_t size() const;
+};
+
+}
+
+#endif
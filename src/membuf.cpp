@@ -0,0 +1,57 @@
+#include "membuf.hpp"
+
+namespace kdbx
+{
+
+membuf::membuf(const void* data, size_t length)
+{
+    // The get area is never written to
+    char_type* start = const_cast<char_type*>(static_cast<const char_type*>(data));
+    setg(start, start, start + length);
+}
+
+const byte* membuf::current() const
+{
+    return reinterpret_cast<const byte*>(gptr());
+}
+
+size_t membuf::remaining() const
+{
+    return static_cast<size_t>(egptr() - gptr());
+}
+
+membuf::pos_type membuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                    std::ios_base::openmode which)
+{
+    off_type base;
+
+    switch (dir) {
+        case std::ios_base::beg:
+            base = 0;
+            break;
+
+        case std::ios_base::cur:
+            base = gptr() - eback();
+            break;
+
+        default:
+            base = egptr() - eback();
+            break;
+    }
+
+    return seekpos(pos_type(base + off), which);
+}
+
+membuf::pos_type membuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    off_type offset = pos;
+
+    if (!(which & std::ios_base::in) || offset < 0 || offset > egptr() - eback()) {
+        return pos_type(off_type(-1));
+    }
+
+    setg(eback(), eback() + offset, egptr());
+    return pos;
+}
+
+}
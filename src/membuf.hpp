@@ -0,0 +1,35 @@
+#ifndef MEMBUF_HPP
+#define MEMBUF_HPP 1
+#include <cstddef>
+#include <streambuf>
+#include "cryptopp/config.h"
+
+namespace kdbx
+{
+
+/*
+ * Read only stream buffer over memory owned by someone else, so a mapped
+ * file can go through the istream parsers without being copied. Consumers
+ * that know about it can take the unread bytes directly instead.
+ */
+class membuf : public std::streambuf
+{
+private:
+    membuf(const membuf&);
+    membuf& operator=(const membuf&);
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                        std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+public:
+    membuf(const void* data, size_t length);
+
+    const byte* current() const;
+    size_t remaining() const;
+};
+
+}
+
+#endif
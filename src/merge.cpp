@@ -0,0 +1,662 @@
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "cryptopp/osrng.h"
+
+#include "base64.hpp"
+#include "xml_memory.hpp"
+
+using pugi::xml_node;
+
+using std::string;
+using std::vector;
+
+using CryptoPP::AutoSeededRandomPool;
+using CryptoPP::SecByteBlock;
+
+namespace kdbx
+{
+
+static const size_t STREAM_KEY_SIZE = 32;
+
+static bool is_named(const xml_node& node, const char* name)
+{
+    return node.type() == pugi::node_element && !std::strcmp(node.name(), name);
+}
+
+// Items are the Entry and Group children; a group's own elements come first
+static bool is_item(const xml_node& node)
+{
+    return is_named(node, "Entry") || is_named(node, "Group");
+}
+
+static xml_node first_item(const xml_node& group)
+{
+    for (xml_node child : group) {
+        if (is_item(child)) {
+            return child;
+        }
+    }
+
+    return xml_node();
+}
+
+// A missing or malformed time counts as the earliest
+static timestamp read_time(const xml_node& node)
+{
+    timestamp value;
+    return parse_timestamp(node.text().get(), value) ? value : timestamp();
+}
+
+static timestamp last_modified(const xml_node& node)
+{
+    return read_time(node.child("Times").child("LastModificationTime"));
+}
+
+static timestamp location_changed(const xml_node& node)
+{
+    return read_time(node.child("Times").child("LocationChanged"));
+}
+
+static bool is_within(xml_node node, const xml_node& ancestor)
+{
+    for (; node; node = node.parent()) {
+        if (node == ancestor) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Merges another database's document into this one's.
+ *
+ * Groups and entries are matched through the UUID indices of both sides,
+ * so each object is looked at once. Copied nodes keep the other side's
+ * encrypted protected values until the end, when every protected value
+ * in the document is encrypted again in document order with a new key.
+ */
+class merger
+{
+private:
+    struct pending_value
+    {
+        const protected_stream* stream;
+        protected_value value;
+    };
+
+    kdbx2_pvt& _db;
+    const kdbx2_pvt& _other;
+
+    // Copied protected values, still encrypted with the other side's stream
+    std::unordered_map<const pugi::xml_node_struct*, pending_value> _pending;
+
+    // Where each of the other side's groups ended up, if anywhere
+    vector<xml_node> _groups;
+    xml_node _root;
+
+    // The first subgroup of each group entries were placed in, which new
+    // entries go ahead of. Every group has been placed by then, so each
+    // group's children are only searched once.
+    std::unordered_map<const pugi::xml_node_struct*, xml_node> _first_groups;
+
+    // The other side's pool ids, as renumbered here
+    std::unordered_map<uint32_t, uint32_t> _binary_ids;
+    std::unordered_map<uint32_t, xml_node> _binary_nodes;
+    uint32_t _next_binary = 0;
+    xml_node _binaries;
+
+    // KDBX 4 attachments live in the arena rather than the document, so
+    // they are put back after the tree is rebuilt
+    vector<binary_record> _raw_binaries;
+
+    bool is_deleted(const uuid& id, timestamp modified) const;
+    xml_node first_group(const xml_node& group);
+
+    void import_values(const xml_node& copy, const xml_node& source);
+    xml_node import(xml_node parent, const xml_node& source, const xml_node& before);
+    xml_node import_entry(xml_node parent, const xml_node& source, const xml_node& before,
+                            bool with_history);
+    uint32_t import_binary(uint32_t id);
+    void remap_binaries(const xml_node& entry);
+
+    void merge_group(uint32_t index);
+    void merge_entry(uint32_t index);
+    void merge_history(xml_node winner, xml_node loser, bool imported);
+    void merge_deleted();
+
+    void reencrypt(const xml_node& node, const protected_stream& next, uint64_t& offset);
+
+public:
+    merger(kdbx2_pvt& db, const kdbx2_pvt& other);
+
+    void run();
+};
+
+merger::merger(kdbx2_pvt& db, const kdbx2_pvt& other)
+    : _db(db), _other(other), _groups(other.tree.groups.size())
+{
+    _root = _db.tree.groups[_db.tree.first_group].node;
+
+    for (const binary_record& record : _db.meta.binaries) {
+        _next_binary = std::max(_next_binary, record.id + 1);
+
+        if (record.raw) {
+            _raw_binaries.push_back(record);
+        }
+    }
+
+    xml_node binaries = _other.document.child("KeePassFile").child("Meta").child("Binaries");
+
+    for (xml_node binary : binaries) {
+        if (is_named(binary, "Binary")) {
+            _binary_nodes[binary.attribute("ID").as_uint()] = binary;
+        }
+    }
+}
+
+bool merger::is_deleted(const uuid& id, timestamp modified) const
+{
+    const char* const* found = _db.deleted_index.find(id);
+    timestamp deleted;
+
+    return found && parse_timestamp(*found, deleted) && deleted >= modified;
+}
+
+xml_node merger::first_group(const xml_node& group)
+{
+    auto found = _first_groups.find(group.internal_object());
+
+    if (found != _first_groups.end()) {
+        return found->second;
+    }
+
+    xml_node first = group.child("Group");
+    _first_groups[group.internal_object()] = first;
+    return first;
+}
+
+void merger::import_values(const xml_node& copy, const xml_node& source)
+{
+    auto found = _other.protected_values.find(source.internal_object());
+
+    if (found != _other.protected_values.end()) {
+        _pending[copy.internal_object()] = {_other.inner_stream.get(), found->second};
+    }
+
+    xml_node c = copy.first_child();
+    xml_node s = source.first_child();
+
+    for (; c && s; c = c.next_sibling(), s = s.next_sibling()) {
+        import_values(c, s);
+    }
+}
+
+xml_node merger::import(xml_node parent, const xml_node& source, const xml_node& before)
+{
+    xml_node copy = before ? parent.insert_copy_before(source, before) : parent.append_copy(source);
+    import_values(copy, source);
+    return copy;
+}
+
+xml_node merger::import_entry(xml_node parent, const xml_node& source, const xml_node& before,
+                                bool with_history)
+{
+    xml_node copy;
+
+    if (with_history) {
+        copy = import(parent, source, before);
+    } else {
+        copy = before ? parent.insert_child_before("Entry", before) : parent.append_child("Entry");
+
+        for (xml_node child : source) {
+            if (!is_named(child, "History")) {
+                import(copy, child, xml_node());
+            }
+        }
+    }
+
+    remap_binaries(copy);
+    return copy;
+}
+
+uint32_t merger::import_binary(uint32_t id)
+{
+    auto found = _binary_ids.find(id);
+
+    if (found != _binary_ids.end()) {
+        return found->second;
+    }
+
+    uint32_t next = _next_binary++;
+    _binary_ids[id] = next;
+
+    // A reference to a missing attachment stays one
+    const binary_record* record = _other.attachments.find(id);
+
+    if (!record) {
+        return next;
+    }
+
+    if (record->raw) {
+        char* data = static_cast<char*>(_db.arena.allocate(record->length));
+        std::memcpy(data, record->data, record->length);
+
+        binary_record copy = *record;
+        copy.id = next;
+        copy.data = data;
+        _raw_binaries.push_back(copy);
+        return next;
+    }
+
+    auto node = _binary_nodes.find(id);
+
+    if (node == _binary_nodes.end()) {
+        return next;
+    }
+
+    if (!_binaries) {
+        xml_node meta = _db.document.child("KeePassFile").child("Meta");
+        _binaries = meta.child("Binaries");
+
+        if (!_binaries) {
+            _binaries = meta.append_child("Binaries");
+        }
+    }
+
+    xml_node copy = import(_binaries, node->second, xml_node());
+    copy.attribute("ID").set_value(next);
+    return next;
+}
+
+void merger::remap_binaries(const xml_node& entry)
+{
+    for (xml_node child : entry) {
+        if (is_named(child, "Binary")) {
+            pugi::xml_attribute ref = child.child("Value").attribute("Ref");
+
+            if (ref) {
+                ref.set_value(import_binary(ref.as_uint()));
+            }
+        } else if (is_named(child, "History")) {
+            for (xml_node old : child) {
+                if (is_named(old, "Entry")) {
+                    remap_binaries(old);
+                }
+            }
+        }
+    }
+}
+
+void merger::merge_group(uint32_t index)
+{
+    const group_record& theirs = _other.tree.groups[index];
+    const uint32_t* mine = _db.group_index.find(theirs.id);
+    xml_node parent = theirs.parent == NO_INDEX ? xml_node() : _groups[theirs.parent];
+
+    if (!mine) {
+        // The other side's top level group stands for ours
+        if (theirs.parent == NO_INDEX) {
+            _groups[index] = _root;
+            return;
+        }
+
+        if (is_deleted(theirs.id, theirs.last_modified)) {
+            return;
+        }
+
+        xml_node group = (parent ? parent : _root).append_child("Group");
+
+        for (xml_node child : theirs.node) {
+            if (!is_item(child)) {
+                import(group, child, xml_node());
+            }
+        }
+
+        _groups[index] = group;
+        return;
+    }
+
+    const group_record& ours = _db.tree.groups[*mine];
+    xml_node group = ours.node;
+    timestamp moved = location_changed(group);
+    _groups[index] = group;
+
+    if (theirs.last_modified > ours.last_modified) {
+        xml_node items = first_item(group);
+
+        for (xml_node child = group.first_child(); child != items; ) {
+            xml_node next = child.next_sibling();
+            group.remove_child(child);
+            child = next;
+        }
+
+        for (xml_node child : theirs.node) {
+            if (!is_item(child)) {
+                import(group, child, items);
+            }
+        }
+    }
+
+    if (parent && group.parent() != parent
+            && location_changed(theirs.node) > moved
+            && !is_within(parent, group)) {
+        parent.append_move(group);
+    }
+}
+
+void merger::merge_entry(uint32_t index)
+{
+    const entry_record& theirs = _other.tree.entries[index];
+    const uint32_t* mine = _db.entry_index.find(theirs.id);
+    xml_node parent = theirs.parent == NO_INDEX ? xml_node() : _groups[theirs.parent];
+
+    if (!mine) {
+        if (is_deleted(theirs.id, theirs.last_modified)) {
+            return;
+        }
+
+        // Entries go ahead of the subgroups
+        xml_node target = parent ? parent : _root;
+        import_entry(target, theirs.node, first_group(target), true);
+        return;
+    }
+
+    const entry_record& ours = _db.tree.entries[*mine];
+    xml_node current = ours.node;
+    timestamp moved = location_changed(current);
+
+    if (theirs.last_modified > ours.last_modified) {
+        xml_node copy = import_entry(current.parent(), theirs.node, current, true);
+        merge_history(copy, current, false);
+        current = copy;
+    } else {
+        merge_history(current, theirs.node, true);
+    }
+
+    if (parent && current.parent() != parent && location_changed(theirs.node) > moved) {
+        xml_node before = first_group(parent);
+
+        if (before) {
+            parent.insert_move_before(current, before);
+        } else {
+            parent.append_move(current);
+        }
+    }
+}
+
+void merger::merge_history(xml_node winner, xml_node loser, bool imported)
+{
+    /*
+     * The loser and its own history join the winner's history, leaving out
+     * versions whose LastModificationTime is the winner's or already there.
+     * Ours are moved, the other side's copied.
+     */
+    xml_node history = winner.child("History");
+
+    if (!history) {
+        history = winner.append_child("History");
+    }
+
+    timestamp current = last_modified(winner);
+    vector<std::pair<timestamp, xml_node>> items;
+
+    for (xml_node old : history) {
+        if (is_named(old, "Entry")) {
+            items.emplace_back(last_modified(old), old);
+        }
+    }
+
+    auto add = [&](const xml_node& version, bool with_history) -> bool {
+        timestamp time = last_modified(version);
+
+        if (time == current) {
+            return false;
+        }
+
+        for (const auto& item : items) {
+            if (item.first == time) {
+                return false;
+            }
+        }
+
+        xml_node added;
+
+        if (imported) {
+            added = import_entry(history, version, xml_node(), with_history);
+        } else {
+            added = history.append_move(version);
+        }
+
+        items.emplace_back(time, added);
+        return true;
+    };
+
+    xml_node old_history = loser.child("History");
+
+    for (xml_node old = old_history.first_child(); old; ) {
+        xml_node next = old.next_sibling();
+
+        if (is_named(old, "Entry")) {
+            add(old, true);
+        }
+
+        old = next;
+    }
+
+    if (imported) {
+        add(loser, false);
+    } else {
+        // Whatever wasn't moved was already in the winner's history
+        if (old_history) {
+            loser.remove_child(old_history);
+        }
+
+        if (!add(loser, false)) {
+            loser.parent().remove_child(loser);
+        }
+    }
+
+    // Oldest first, as KeePass keeps them
+    std::stable_sort(items.begin(), items.end(),
+                        [](const std::pair<timestamp, xml_node>& a,
+                            const std::pair<timestamp, xml_node>& b) {
+                            return a.first < b.first;
+                        });
+
+    for (const auto& item : items) {
+        history.append_move(item.second);
+    }
+}
+
+void merger::merge_deleted()
+{
+    xml_node theirs = _other.document.child("KeePassFile").child("Root").child("DeletedObjects");
+
+    if (!theirs) {
+        return;
+    }
+
+    xml_node root = _db.document.child("KeePassFile").child("Root");
+    xml_node deleted = root.child("DeletedObjects");
+
+    if (!deleted) {
+        deleted = root.append_child("DeletedObjects");
+    }
+
+    vector<uint32_t> groups;
+
+    for (xml_node object : theirs) {
+        if (!is_named(object, "DeletedObject")) {
+            continue;
+        }
+
+        xml_node time_node = object.child("DeletionTime");
+        uuid id = uuid::from_base64(object.child("UUID").text().get());
+        timestamp time = read_time(time_node);
+
+        if (_db.deleted_index.insert(id, time_node.text().get())) {
+            import(deleted, object, xml_node());
+        }
+
+        // Objects the other side still has were merged above
+        const uint32_t* entry = _db.entry_index.find(id);
+
+        if (entry && !_other.entry_index.find(id)) {
+            const entry_record& ours = _db.tree.entries[*entry];
+
+            if (ours.last_modified <= time) {
+                ours.node.parent().remove_child(ours.node);
+            }
+
+            continue;
+        }
+
+        const uint32_t* group = _db.group_index.find(id);
+
+        if (group && !_other.group_index.find(id)
+                && _db.tree.groups[*group].last_modified <= time) {
+            groups.push_back(*group);
+        }
+    }
+
+    // Subgroups come after their parents in pre-order, so going backwards
+    // empties them first. Groups still holding anything are kept.
+    std::sort(groups.begin(), groups.end(), std::greater<uint32_t>());
+
+    for (uint32_t index : groups) {
+        xml_node node = _db.tree.groups[index].node;
+
+        if (node.parent() != root && !first_item(node)) {
+            node.parent().remove_child(node);
+        }
+    }
+}
+
+void merger::reencrypt(const xml_node& node, const protected_stream& next, uint64_t& offset)
+{
+    // Walks the document as index_protected() does, so the offsets match
+    for (xml_node child : node) {
+        if (child.type() != pugi::node_element) {
+            continue;
+        }
+
+        if (child.attribute("Protected").as_bool(false)) {
+            const protected_stream* stream = _db.inner_stream.get();
+            const char* text = child.text().get();
+            size_t length = std::strlen(text);
+            protected_value value = {0, base64_decoded_size(text, length)};
+
+            auto pending = _pending.find(child.internal_object());
+
+            if (pending != _pending.end()) {
+                stream = pending->second.stream;
+                value = pending->second.value;
+            } else {
+                auto found = _db.protected_values.find(child.internal_object());
+
+                if (found != _db.protected_values.end()) {
+                    value = found->second;
+                }
+            }
+
+            SecByteBlock plain(value.length);
+            base64_decode(text, length, plain.data());
+
+            stream->apply(value.offset, plain.data(), plain.size());
+            next.apply(offset, plain.data(), plain.size());
+            offset += plain.size();
+
+            child.text().set(base64_encode(plain.data(), plain.size()).c_str());
+        }
+
+        reencrypt(child, next, offset);
+    }
+}
+
+void merger::run()
+{
+    // Groups in pre-order, so a parent is placed before its children
+    for (uint32_t ii = 0; ii < _other.tree.groups.size(); ii++) {
+        merge_group(ii);
+    }
+
+    for (uint32_t ii = 0; ii < _other.tree.entries.size(); ii++) {
+        merge_entry(ii);
+    }
+
+    merge_deleted();
+
+    // Protected values have moved around, and some came from another
+    // stream, so they all get a fresh key in their new order
+    AutoSeededRandomPool rng;
+    SecByteBlock key(STREAM_KEY_SIZE);
+    rng.GenerateBlock(key.data(), key.size());
+
+    protected_stream next(_db.inner_random_stream_id, key);
+    uint64_t offset = 0;
+    reencrypt(_db.document, next, offset);
+
+    _db.protected_stream_key = key;
+
+    vector<binary_record> raw_binaries;
+    raw_binaries.swap(_raw_binaries);
+
+    _db.build_tree();
+
+    if (!raw_binaries.empty()) {
+        _db.meta.binaries.insert(_db.meta.binaries.end(), raw_binaries.begin(), raw_binaries.end());
+        _db.attachments.build(_db.meta.binaries);
+    }
+}
+
+change_set kdbx2::merge(const kdbx2& other)
+{
+    change_set changes;
+
+    if (&other == this) {
+        return changes;
+    }
+
+    const kdbx2_pvt& theirs = *other._pvt;
+
+    if (_pvt->from_cache || theirs.from_cache) {
+        throw parse_error("database was loaded from a cache");
+    }
+
+    if (!_pvt->document.child("KeePassFile") || !theirs.document.child("KeePassFile")) {
+        throw parse_error("no database to merge");
+    }
+
+    if (file_version_major() != other.file_version_major()) {
+        throw parse_error("databases have different file versions");
+    }
+
+    if (_pvt->tree.first_group == NO_INDEX) {
+        throw parse_error("database has no groups");
+    }
+
+    // Enough of the old tree to tell what changed
+    kdbx::tree before;
+    before.groups = _pvt->tree.groups;
+    before.entries = _pvt->tree.entries;
+
+    uuid_index<uint32_t> groups_before = _pvt->group_index;
+    uuid_index<uint32_t> entries_before = _pvt->entry_index;
+
+    {
+        xml_memory_scope scope(&_pvt->arena, NULL);
+        merger(*_pvt, theirs).run();
+    }
+
+    _pvt->merged = true;
+    _pvt->diff_tree(before, groups_before, entries_before, changes);
+    return changes;
+}
+
+}
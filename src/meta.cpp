@@ -0,0 +1,159 @@
+#include "meta.hpp"
+#include "kdbx_pvt.hpp"
+
+#include <cstring>
+
+#include "base64.hpp"
+
+using pugi::xml_node;
+
+namespace kdbx
+{
+
+void meta_info::clear()
+{
+    generator = "";
+    header_hash = "";
+    database_name = "";
+    database_name_changed = timestamp();
+    database_description = "";
+    database_description_changed = timestamp();
+    default_user_name = "";
+    default_user_name_changed = timestamp();
+    maintenance_history_days = 365;
+    color = "";
+    master_key_changed = timestamp();
+    master_key_change_rec = -1;
+    master_key_change_force = -1;
+    memory_protection = {false, false, true, false, false};
+    recycle_bin_enabled = true;
+    recycle_bin_uuid = uuid();
+    recycle_bin_changed = timestamp();
+    entry_templates_group = uuid();
+    entry_templates_group_changed = timestamp();
+    history_max_items = 10;
+    history_max_size = 6 * 1024 * 1024;
+    last_selected_group = uuid();
+    last_top_visible_group = uuid();
+
+    custom_icons.clear();
+    binaries.clear();
+}
+
+static void read_time(const xml_node& node, timestamp& out)
+{
+    if (node) {
+        parse_timestamp(node.text().get(), out);
+    }
+}
+
+static void read_uuid(const xml_node& node, uuid& out)
+{
+    const char* text = node.text().get();
+
+    if (*text) {
+        out = uuid::from_base64(text);
+    }
+}
+
+static void read_flag(const xml_node& node, bool& out)
+{
+    if (node) {
+        out = node.text().as_bool(out);
+    }
+}
+
+void kdbx2_pvt::parse_meta(const xml_node& node)
+{
+    meta.clear();
+
+    for (xml_node child : node) {
+        const char* name = child.name();
+        pugi::xml_text text = child.text();
+
+        if (!std::strcmp(name, "Generator")) {
+            meta.generator = text.get();
+        } else if (!std::strcmp(name, "HeaderHash")) {
+            meta.header_hash = text.get();
+        } else if (!std::strcmp(name, "DatabaseName")) {
+            meta.database_name = text.get();
+        } else if (!std::strcmp(name, "DatabaseNameChanged")) {
+            read_time(child, meta.database_name_changed);
+        } else if (!std::strcmp(name, "DatabaseDescription")) {
+            meta.database_description = text.get();
+        } else if (!std::strcmp(name, "DatabaseDescriptionChanged")) {
+            read_time(child, meta.database_description_changed);
+        } else if (!std::strcmp(name, "DefaultUserName")) {
+            meta.default_user_name = text.get();
+        } else if (!std::strcmp(name, "DefaultUserNameChanged")) {
+            read_time(child, meta.default_user_name_changed);
+        } else if (!std::strcmp(name, "MaintenanceHistoryDays")) {
+            meta.maintenance_history_days = text.as_int(meta.maintenance_history_days);
+        } else if (!std::strcmp(name, "Color")) {
+            meta.color = text.get();
+        } else if (!std::strcmp(name, "MasterKeyChanged")) {
+            read_time(child, meta.master_key_changed);
+        } else if (!std::strcmp(name, "MasterKeyChangeRec")) {
+            meta.master_key_change_rec = text.as_llong(meta.master_key_change_rec);
+        } else if (!std::strcmp(name, "MasterKeyChangeForce")) {
+            meta.master_key_change_force = text.as_llong(meta.master_key_change_force);
+        } else if (!std::strcmp(name, "MemoryProtection")) {
+            read_flag(child.child("ProtectTitle"), meta.memory_protection.title);
+            read_flag(child.child("ProtectUserName"), meta.memory_protection.user_name);
+            read_flag(child.child("ProtectPassword"), meta.memory_protection.password);
+            read_flag(child.child("ProtectURL"), meta.memory_protection.url);
+            read_flag(child.child("ProtectNotes"), meta.memory_protection.notes);
+        } else if (!std::strcmp(name, "RecycleBinEnabled")) {
+            read_flag(child, meta.recycle_bin_enabled);
+        } else if (!std::strcmp(name, "RecycleBinUUID")) {
+            read_uuid(child, meta.recycle_bin_uuid);
+        } else if (!std::strcmp(name, "RecycleBinChanged")) {
+            read_time(child, meta.recycle_bin_changed);
+        } else if (!std::strcmp(name, "EntryTemplatesGroup")) {
+            read_uuid(child, meta.entry_templates_group);
+        } else if (!std::strcmp(name, "EntryTemplatesGroupChanged")) {
+            read_time(child, meta.entry_templates_group_changed);
+        } else if (!std::strcmp(name, "HistoryMaxItems")) {
+            meta.history_max_items = text.as_int(meta.history_max_items);
+        } else if (!std::strcmp(name, "HistoryMaxSize")) {
+            meta.history_max_size = text.as_llong(meta.history_max_size);
+        } else if (!std::strcmp(name, "LastSelectedGroup")) {
+            read_uuid(child, meta.last_selected_group);
+        } else if (!std::strcmp(name, "LastTopVisibleGroup")) {
+            read_uuid(child, meta.last_top_visible_group);
+        } else if (!std::strcmp(name, "CustomIcons")) {
+            for (xml_node icon : child) {
+                if (std::strcmp(icon.name(), "Icon")) {
+                    continue;
+                }
+
+                custom_icon record;
+                read_uuid(icon.child("UUID"), record.id);
+                record.data = icon.child("Data").text().get();
+                record.length = base64_decoded_size(record.data, std::strlen(record.data));
+                meta.custom_icons.push_back(record);
+            }
+        } else if (!std::strcmp(name, "Binaries")) {
+            for (xml_node binary : child) {
+                if (std::strcmp(binary.name(), "Binary")) {
+                    continue;
+                }
+
+                binary_record record;
+                record.id = binary.attribute("ID").as_uint();
+                record.compressed = binary.attribute("Compressed").as_bool(false);
+                record.data = binary.text().get();
+                record.length = base64_decoded_size(record.data, std::strlen(record.data));
+                record.raw = false;
+
+                auto found = protected_values.find(binary.internal_object());
+                record.is_protected = found != protected_values.end();
+                record.protected_offset = record.is_protected ? found->second.offset : 0;
+
+                meta.binaries.push_back(record);
+            }
+        }
+    }
+}
+
+}
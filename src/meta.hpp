@@ -0,0 +1,83 @@
+#ifndef META_HPP
+#define META_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "timestamp.hpp"
+#include "uuid.hpp"
+
+namespace kdbx
+{
+
+struct custom_icon
+{
+    uuid id;
+
+    // Base64 encoded image, owned by the document
+    const char* data;
+    size_t length;
+};
+
+struct binary_record
+{
+    uint32_t id;
+    bool compressed;
+    bool is_protected;
+    uint64_t protected_offset;
+
+    // Base64 encoded contents, owned by the document. KDBX 4 keeps them
+    // in the inner header instead, read as raw bytes into the arena.
+    const char* data;
+    size_t length;
+    bool raw;
+};
+
+struct memory_protection
+{
+    bool title;
+    bool user_name;
+    bool password;
+    bool url;
+    bool notes;
+};
+
+/*
+ * The Meta element, converted once at load. Strings point into the parsed
+ * document and are never NULL; missing elements get KeePass' defaults.
+ */
+struct meta_info
+{
+    const char* generator;
+    const char* header_hash;
+    const char* database_name;
+    timestamp database_name_changed;
+    const char* database_description;
+    timestamp database_description_changed;
+    const char* default_user_name;
+    timestamp default_user_name_changed;
+    int maintenance_history_days;
+    const char* color;
+    timestamp master_key_changed;
+    int64_t master_key_change_rec;
+    int64_t master_key_change_force;
+    kdbx::memory_protection memory_protection;
+    bool recycle_bin_enabled;
+    uuid recycle_bin_uuid;
+    timestamp recycle_bin_changed;
+    uuid entry_templates_group;
+    timestamp entry_templates_group_changed;
+    int history_max_items;
+    int64_t history_max_size;
+    uuid last_selected_group;
+    uuid last_top_visible_group;
+
+    std::vector<custom_icon> custom_icons;
+    std::vector<binary_record> binaries;
+
+    void clear();
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include "meterbuf.hpp"
+
+#include "future.hpp"
+
+namespace kdbx
+{
+
+meterbuf::meterbuf(std::streambuf* source)
+    : _source(source), _buffer(CHUNK_SIZE)
+{
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+    setg(start, start, start);
+}
+
+meterbuf::int_type meterbuf::underflow()
+{
+    if (gptr() < egptr()) {
+        // Still have characters in the buffer
+        return traits_type::to_int_type(*gptr());
+    }
+
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+
+    load_stats::clock::time_point before = load_stats::clock::now();
+    std::streamsize count = _source->sgetn(start, CHUNK_SIZE);
+    _elapsed += load_stats::clock::now() - before;
+
+    if (count <= 0) {
+        setg(start, start, start);
+        return traits_type::eof();
+    }
+
+    _bytes += static_cast<uint64_t>(count);
+    setg(start, start, start + count);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+uint64_t meterbuf::bytes() const
+{
+    return _bytes;
+}
+
+load_stats::duration meterbuf::elapsed() const
+{
+    return _elapsed;
+}
+
+stage_meters::stage_meters(load_stats* stats)
+    : _stats(stats)
+{
+}
+
+std::streambuf* stage_meters::add(std::streambuf* source,
+                                    load_stats::duration load_stats::* phase,
+                                    uint64_t load_stats::* bytes)
+{
+    if (!_stats) {
+        return source;
+    }
+
+    stage next;
+    next.meter = std::make_unique<meterbuf>(source);
+    next.phase = phase;
+    next.bytes = bytes;
+    next.below_before = _stages.empty() ? load_stats::duration::zero()
+                                        : _stages.back().meter->elapsed();
+
+    _stages.push_back(std::move(next));
+    return _stages.back().meter.get();
+}
+
+void stage_meters::finish()
+{
+    if (!_stats || _stages.empty()) {
+        return;
+    }
+
+    // Every stage's time includes what the stage below it spent meanwhile
+    load_stats::duration below = load_stats::duration::zero();
+
+    for (stage& s : _stages) {
+        load_stats::duration elapsed = s.meter->elapsed();
+        _stats->*s.phase = elapsed - (below - s.below_before);
+        below = elapsed;
+
+        if (s.bytes) {
+            _stats->*s.bytes = s.meter->bytes();
+        }
+    }
+
+    // The parse read from the top stage, so it waited on all of them
+    _stats->xml_parse -= below;
+}
+
+}
@@ -0,0 +1,89 @@
+#ifndef METERBUF_HPP
+#define METERBUF_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <vector>
+#include "cryptopp/secblock.h"
+
+#include "load_stats.hpp"
+
+namespace kdbx
+{
+
+/*
+ * Passes another stream buffer through unchanged, counting the bytes and
+ * the time spent producing them. Only used when load statistics are on,
+ * since it copies everything once more.
+ */
+class meterbuf : public std::streambuf
+{
+private:
+    meterbuf(meterbuf&&);
+    meterbuf(const meterbuf&);
+    meterbuf& operator=(const meterbuf&);
+
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    std::streambuf* _source;
+    CryptoPP::SecByteBlock _buffer;
+    uint64_t _bytes = 0;
+    load_stats::duration _elapsed = load_stats::duration::zero();
+
+protected:
+    int_type underflow() override;
+
+public:
+    explicit meterbuf(std::streambuf* source);
+
+    uint64_t bytes() const;
+
+    // Includes the time spent in whatever the source reads from
+    load_stats::duration elapsed() const;
+};
+
+/*
+ * The stages of a load's body, stacked so that each reads from the one
+ * added before it. With statistics on, every stage reads through a
+ * meterbuf, and finish() gives each phase its time without the stages
+ * below it.
+ */
+class stage_meters
+{
+private:
+    stage_meters(const stage_meters&);
+    stage_meters& operator=(const stage_meters&);
+
+    struct stage
+    {
+        std::unique_ptr<meterbuf> meter;
+        load_stats::duration load_stats::* phase;
+        uint64_t load_stats::* bytes;
+
+        // What the stage below had already spent when this one was added,
+        // such as decrypting the stream start bytes
+        load_stats::duration below_before;
+    };
+
+    load_stats* _stats;
+    std::vector<stage> _stages;
+
+public:
+    // NULL stats meter nothing
+    explicit stage_meters(load_stats* stats);
+
+    // The buffer to read the new stage through: source itself with
+    // statistics off. The bytes it passes on are counted into bytes,
+    // unless that is NULL.
+    std::streambuf* add(std::streambuf* source,
+                        load_stats::duration load_stats::* phase,
+                        uint64_t load_stats::* bytes);
+
+    // Call once the XML has been parsed from the top stage
+    void finish();
+};
+
+}
+
+#endif
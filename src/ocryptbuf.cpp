@@ -0,0 +1,52 @@
+#include "ocryptbuf.hpp"
+
+#include <cstring>
+
+#include "errors.hpp"
+
+namespace kdbx
+{
+
+ocryptbuf::ocryptbuf(std::ostream& out, CryptoPP::StreamTransformation& cipher)
+    : _out(out), _cipher(cipher), _buffer(CHUNK_SIZE + BLOCK_SIZE)
+{
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+    setp(start, start + CHUNK_SIZE);
+}
+
+ocryptbuf::int_type ocryptbuf::overflow(int_type c)
+{
+    write_chunk(CHUNK_SIZE);
+
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+void ocryptbuf::write_chunk(size_t length)
+{
+    _cipher.ProcessData(_buffer.data(), _buffer.data(), length);
+    _out.write(reinterpret_cast<const char*>(_buffer.data()), length);
+
+    if (!_out) {
+        throw write_error("unable to write ciphertext");
+    }
+
+    setp(pbase(), epptr());
+}
+
+void ocryptbuf::finish()
+{
+    size_t length = static_cast<size_t>(pptr() - pbase());
+
+    // PKCS#7 padding always adds at least one byte
+    byte padding = static_cast<byte>(BLOCK_SIZE - length % BLOCK_SIZE);
+    std::memset(_buffer.data() + length, padding, padding);
+
+    write_chunk(length + padding);
+}
+
+}
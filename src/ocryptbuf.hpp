@@ -0,0 +1,43 @@
+#ifndef OCRYPTBUF_HPP
+#define OCRYPTBUF_HPP 1
+#include <cstddef>
+#include <iostream>
+#include <streambuf>
+#include "cryptopp/cryptlib.h"
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * Encrypts with a block cipher in fixed size chunks, the inverse of
+ * cryptbuf. finish() pads and encrypts whatever is left.
+ */
+class ocryptbuf : public std::streambuf
+{
+private:
+    ocryptbuf(ocryptbuf&&);
+    ocryptbuf(const ocryptbuf&);
+    ocryptbuf& operator=(const ocryptbuf&);
+
+    static const size_t BLOCK_SIZE = 16;
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    std::ostream& _out;
+    CryptoPP::StreamTransformation& _cipher;
+    CryptoPP::SecByteBlock _buffer;
+
+    void write_chunk(size_t length);
+
+protected:
+    int_type overflow(int_type c) override;
+
+public:
+    ocryptbuf(std::ostream& out, CryptoPP::StreamTransformation& cipher);
+
+    void finish();
+};
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "ogzipbuf.hpp"
+
+#include <cstring>
+
+#include "errors.hpp"
+
+namespace kdbx
+{
+
+ogzipbuf::ogzipbuf(std::ostream& out)
+    : _out(out), _input(CHUNK_SIZE), _buffer(CHUNK_SIZE)
+{
+    std::memset(&_stream, 0, sizeof(_stream));
+
+    // Add 16 to the window bits to write a GZip header
+    if (deflateInit2(&_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw write_error("unable to initialize compression");
+    }
+
+    char_type* start = reinterpret_cast<char_type*>(_input.begin());
+    setp(start, start + CHUNK_SIZE);
+}
+
+ogzipbuf::~ogzipbuf()
+{
+    deflateEnd(&_stream);
+}
+
+ogzipbuf::int_type ogzipbuf::overflow(int_type c)
+{
+    deflate_input(Z_NO_FLUSH);
+
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+void ogzipbuf::deflate_input(int flush)
+{
+    _stream.next_in = _input.data();
+    _stream.avail_in = static_cast<uInt>(pptr() - pbase());
+
+    int result;
+
+    do {
+        _stream.next_out = _buffer.data();
+        _stream.avail_out = static_cast<uInt>(_buffer.size());
+
+        result = deflate(&_stream, flush);
+        if (result == Z_STREAM_ERROR) {
+            throw write_error("compression failed");
+        }
+
+        size_t count = _buffer.size() - _stream.avail_out;
+        _out.write(reinterpret_cast<const char*>(_buffer.data()), count);
+
+        if (!_out) {
+            throw write_error("unable to write compressed data");
+        }
+    } while (_stream.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+
+    setp(pbase(), epptr());
+}
+
+void ogzipbuf::finish()
+{
+    deflate_input(Z_FINISH);
+}
+
+}
@@ -0,0 +1,43 @@
+#ifndef OGZIPBUF_HPP
+#define OGZIPBUF_HPP 1
+#include <cstddef>
+#include <iostream>
+#include <streambuf>
+#include <zlib.h>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * Deflates into a GZip stream in fixed size chunks.
+ */
+class ogzipbuf : public std::streambuf
+{
+private:
+    ogzipbuf(ogzipbuf&&);
+    ogzipbuf(const ogzipbuf&);
+    ogzipbuf& operator=(const ogzipbuf&);
+
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    std::ostream& _out;
+    z_stream _stream;
+    CryptoPP::SecByteBlock _input;
+    CryptoPP::SecByteBlock _buffer;
+
+    void deflate_input(int flush);
+
+protected:
+    int_type overflow(int_type c) override;
+
+public:
+    explicit ogzipbuf(std::ostream& out);
+    ~ogzipbuf();
+
+    void finish();
+};
+
+}
+
+#endif
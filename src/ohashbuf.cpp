@@ -0,0 +1,67 @@
+#include "ohashbuf.hpp"
+
+#include "cryptopp/sha.h"
+
+#include "errors.hpp"
+#include "io.hpp"
+
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+
+namespace kdbx
+{
+
+ohashbuf::ohashbuf(std::ostream& out)
+    : _out(out), _buffer(BLOCK_SIZE)
+{
+    char_type* start = reinterpret_cast<char_type*>(_buffer.begin());
+    setp(start, start + BLOCK_SIZE);
+}
+
+ohashbuf::int_type ohashbuf::overflow(int_type c)
+{
+    write_block();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+void ohashbuf::write_block()
+{
+    uint32_t length = static_cast<uint32_t>(pptr() - pbase());
+
+    SecByteBlock hash(SHA256::DIGESTSIZE);
+    if (length) {
+        SHA256().CalculateDigest(hash.data(), _buffer.data(), length);
+    } else {
+        // The final block has an empty digest
+        hash.CleanNew(SHA256::DIGESTSIZE);
+    }
+
+    write(_out, _blk_idx);
+    write(_out, hash);
+    write(_out, length);
+    _out.write(pbase(), length);
+
+    if (!_out) {
+        throw write_error("unable to write block");
+    }
+
+    _blk_idx++;
+    setp(pbase(), epptr());
+}
+
+void ohashbuf::finish()
+{
+    if (pptr() != pbase()) {
+        write_block();
+    }
+
+    write_block();
+}
+
+}
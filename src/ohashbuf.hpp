@@ -0,0 +1,45 @@
+#ifndef OHASHBUF_HPP
+#define OHASHBUF_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <streambuf>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * Writes the hashed block stream read by hashbuf.
+ *
+ * Output is collected into fixed size blocks, each written out with its
+ * index and SHA-256 digest once full. finish() writes the last partial
+ * block and the empty block that ends the stream.
+ */
+class ohashbuf : public std::streambuf
+{
+private:
+    ohashbuf(ohashbuf&&);
+    ohashbuf(const ohashbuf&);
+    ohashbuf& operator=(const ohashbuf&);
+
+    static const size_t BLOCK_SIZE = 1024 * 1024;
+
+    std::ostream& _out;
+    CryptoPP::SecByteBlock _buffer;
+    uint32_t _blk_idx = 0;
+
+    void write_block();
+
+protected:
+    int_type overflow(int_type c) override;
+
+public:
+    explicit ohashbuf(std::ostream& out);
+
+    void finish();
+};
+
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "probe.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "errors.hpp"
+#include "kdbx.hpp"
+#include "work_pool.hpp"
+
+using std::string;
+using std::vector;
+
+namespace kdbx
+{
+
+header_info probe_header(const string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw parse_error("unable to open file");
+    }
+
+    kdbx2 db;
+    db.load_header(in);
+
+    header_info info;
+    info.path = path;
+    info.file_version = db.file_version();
+    info.comment = db.comment();
+    info.cipher_id = db.cipher_id();
+    info.compression_flags = db.compression_flags();
+    info.transform_rounds = db.transform_rounds();
+    info.inner_random_stream_id = db.inner_random_stream_id();
+    return info;
+}
+
+static bool has_extension(const char* name, const char* extension)
+{
+    size_t length = std::strlen(name);
+    size_t ext_length = std::strlen(extension);
+
+    if (length <= ext_length) {
+        return false;
+    }
+
+    const char* tail = name + length - ext_length;
+
+    for (size_t ii = 0; ii < ext_length; ii++) {
+        char c = tail[ii];
+
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+
+        if (c != extension[ii]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Collects database paths, and entries for directories that can't be read
+static void find_databases(const string& root, bool recursive,
+                            vector<string>& paths, vector<header_info>& failed)
+{
+    vector<string> pending(1, root);
+
+    while (!pending.empty()) {
+        string dir = pending.back();
+        pending.pop_back();
+
+        DIR* handle = opendir(dir.c_str());
+
+        if (!handle) {
+            header_info info;
+            info.path = dir;
+            info.error = "unable to open directory";
+            failed.push_back(info);
+            continue;
+        }
+
+        while (struct dirent* item = readdir(handle)) {
+            if (!std::strcmp(item->d_name, ".") || !std::strcmp(item->d_name, "..")) {
+                continue;
+            }
+
+            string path = dir + "/" + item->d_name;
+
+            // Symbolic links are followed to files but not to directories,
+            // so a link can't make the walk loop
+            struct stat info;
+
+            if (lstat(path.c_str(), &info) < 0) {
+                continue;
+            }
+
+            if (S_ISDIR(info.st_mode)) {
+                if (recursive) {
+                    pending.push_back(path);
+                }
+            } else if (has_extension(item->d_name, ".kdbx")) {
+                if (S_ISLNK(info.st_mode) && (stat(path.c_str(), &info) < 0 || !S_ISREG(info.st_mode))) {
+                    continue;
+                }
+
+                paths.push_back(path);
+            }
+        }
+
+        closedir(handle);
+    }
+}
+
+vector<header_info> probe_directory(const string& path, bool recursive, size_t threads)
+{
+    struct stat info;
+
+    if (stat(path.c_str(), &info) < 0 || !S_ISDIR(info.st_mode)) {
+        throw parse_error("unable to open directory");
+    }
+
+    vector<string> paths;
+    vector<header_info> results;
+    find_databases(path, recursive, paths, results);
+
+    size_t first = results.size();
+    results.resize(first + paths.size());
+
+    vector<work_pool::task> tasks;
+    tasks.reserve(paths.size());
+
+    for (size_t ii = 0; ii < paths.size(); ii++) {
+        const string* file = &paths[ii];
+        header_info* result = &results[first + ii];
+
+        tasks.push_back([file, result] {
+            try {
+                *result = probe_header(*file);
+            } catch (const std::exception& e) {
+                result->path = *file;
+                result->error = e.what();
+            }
+        });
+    }
+
+    work_pool pool(threads);
+    pool.run(std::move(tasks));
+
+    std::sort(results.begin(), results.end(),
+        [](const header_info& a, const header_info& b) {
+            return a.path < b.path;
+        });
+
+    return results;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef PROBE_HPP
+#define PROBE_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kdbx
+{
+
+/*
+ * The unencrypted header of a database file.
+ */
+struct header_info
+{
+    std::string path;
+
+    uint32_t file_version = 0;
+    std::string comment;
+    std::string cipher_id;
+    uint32_t compression_flags = 0;
+    uint64_t transform_rounds = 0;
+    uint32_t inner_random_stream_id = 0;
+
+    // Empty unless the header could not be read
+    std::string error;
+
+    uint16_t file_version_major() const { return static_cast<uint16_t>(file_version >> 16); }
+    uint16_t file_version_minor() const { return file_version & 0xFFFF; }
+
+    explicit operator bool() const { return error.empty(); }
+};
+
+// Reads the signature, version and header fields of one file, stopping at
+// the end of the header. Throws parse_error if they can't be read.
+header_info probe_header(const std::string& path);
+
+// Probes every .kdbx file under a directory on a work_pool. Failures are
+// reported per file; results are sorted by path. Zero threads means one
+// per hardware thread.
+std::vector<header_info> probe_directory(const std::string& path,
+                                            bool recursive = true,
+                                            size_t threads = 0);
+
+}
+
+#endif
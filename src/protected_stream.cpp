@@ -0,0 +1,76 @@
+#include "protected_stream.hpp"
+
+#include "cryptopp/chacha.h"
+#include "cryptopp/salsa.h"
+#include "cryptopp/sha.h"
+
+#include "errors.hpp"
+
+using CryptoPP::ChaChaTLS;
+using CryptoPP::Salsa20;
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+using CryptoPP::SHA512;
+
+namespace kdbx
+{
+
+static const byte SALSA20_IV[] = {0xE8, 0x30, 0x09, 0x4B, 0x97, 0x20, 0x5D, 0x2A};
+
+static const size_t CHACHA20_KEY_SIZE = 32;
+static const size_t CHACHA20_IV_SIZE = 12;
+
+protected_stream::protected_stream(uint32_t id, const SecByteBlock& key)
+    : _id(id)
+{
+    switch (_id) {
+        case Algorithm::NONE:
+            break;
+
+        case Algorithm::SALSA20:
+            _key.New(SHA256::DIGESTSIZE);
+            SHA256().CalculateDigest(_key.data(), key.data(), key.size());
+            break;
+
+        case Algorithm::CHACHA20:
+        {
+            // KDBX 4 takes both the key and the nonce from one digest
+            SecByteBlock digest(SHA512::DIGESTSIZE);
+            SHA512().CalculateDigest(digest.data(), key.data(), key.size());
+            _key.Assign(digest.data(), CHACHA20_KEY_SIZE);
+            _iv.Assign(digest.data() + CHACHA20_KEY_SIZE, CHACHA20_IV_SIZE);
+            break;
+        }
+
+        default:
+            throw parse_error("unsupported inner random stream");
+    }
+}
+
+void protected_stream::apply(uint64_t offset, byte* data, size_t length) const
+{
+    switch (_id) {
+        case Algorithm::NONE:
+            break;
+
+        case Algorithm::SALSA20:
+        {
+            Salsa20::Encryption salsa;
+            salsa.SetKeyWithIV(_key.data(), _key.size(), SALSA20_IV, sizeof(SALSA20_IV));
+            salsa.Seek(offset);
+            salsa.ProcessData(data, data, length);
+            break;
+        }
+
+        case Algorithm::CHACHA20:
+        {
+            ChaChaTLS::Encryption chacha;
+            chacha.SetKeyWithIV(_key.data(), _key.size(), _iv.data(), _iv.size());
+            chacha.Seek(offset);
+            chacha.ProcessData(data, data, length);
+            break;
+        }
+    }
+}
+
+}
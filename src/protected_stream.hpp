@@ -0,0 +1,40 @@
+#ifndef PROTECTED_STREAM_HPP
+#define PROTECTED_STREAM_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * The inner random stream that protects values inside the XML.
+ *
+ * Every protected value consumes the keystream in document order. Given the
+ * offset of a value, apply() seeks straight to it so one value can be
+ * decrypted without generating the keystream for everything before it.
+ */
+class protected_stream
+{
+private:
+    uint32_t _id;
+    CryptoPP::SecByteBlock _key;
+    CryptoPP::SecByteBlock _iv;
+
+public:
+    enum Algorithm
+    {
+        NONE = 0,
+        ARC_FOUR_VARIANT,
+        SALSA20,
+        CHACHA20,
+    };
+
+    protected_stream(uint32_t id, const CryptoPP::SecByteBlock& key);
+
+    void apply(uint64_t offset, byte* data, size_t length) const;
+};
+
+}
+
+#endif
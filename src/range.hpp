@@ -0,0 +1,62 @@
+#ifndef RANGE_HPP
+#define RANGE_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace kdbx
+{
+
+class kdbx2_pvt;
+
+static const uint32_t NO_INDEX = 0xFFFFFFFF;
+
+/*
+ * A run of consecutive groups or entries, handed out as handles.
+ */
+template<typename T>
+class index_range
+{
+private:
+    const kdbx2_pvt* _db;
+    uint32_t _begin;
+    uint32_t _end;
+
+public:
+    class iterator
+    {
+    private:
+        const kdbx2_pvt* _db;
+        uint32_t _index;
+
+    public:
+        typedef std::ptrdiff_t difference_type;
+        typedef T value_type;
+        typedef const T* pointer;
+        typedef T reference;
+        typedef std::forward_iterator_tag iterator_category;
+
+        iterator(const kdbx2_pvt* db, uint32_t index) : _db(db), _index(index) {}
+
+        T operator*() const { return T(*_db, _index); }
+        iterator& operator++() { _index++; return *this; }
+        iterator operator++(int) { iterator old = *this; _index++; return old; }
+
+        bool operator==(const iterator& other) const { return _index == other._index; }
+        bool operator!=(const iterator& other) const { return _index != other._index; }
+    };
+
+    index_range(const kdbx2_pvt* db, uint32_t begin, uint32_t end)
+        : _db(db), _begin(begin), _end(end) {}
+
+    iterator begin() const { return iterator(_db, _begin); }
+    iterator end() const { return iterator(_db, _end); }
+
+    size_t size() const { return _end - _begin; }
+    bool empty() const { return _begin == _end; }
+    T operator[](size_t ii) const { return T(*_db, _begin + static_cast<uint32_t>(ii)); }
+};
+
+}
+
+#endif
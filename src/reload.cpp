@@ -0,0 +1,171 @@
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+
+#include "future.hpp"
+
+#include "mapped_file.hpp"
+#include "membuf.hpp"
+
+using std::istream;
+using std::string;
+using std::vector;
+
+namespace kdbx
+{
+
+void kdbx2_pvt::take_settings(const kdbx2_pvt& other)
+{
+    keys = other.keys;
+    cache = other.cache;
+    kdf_slots = other.kdf_slots;
+    read_ahead = other.read_ahead;
+    stats_callback = other.stats_callback;
+
+    if (!other.stats) {
+        stats.reset();
+    } else if (!stats) {
+        stats = std::make_unique<load_stats>();
+        stats->clear();
+    }
+
+    if (other.search && !search) {
+        search = std::make_unique<search_index>();
+    }
+}
+
+void kdbx2_pvt::take_derived_key(const kdbx2_pvt& other)
+{
+    composite_key = other.composite_key;
+    transformed_key = other.transformed_key;
+    transformed_seed = other.transformed_seed;
+    transformed_rounds = other.transformed_rounds;
+}
+
+template<typename Record>
+static const uuid* parent_id(const tree& t, const Record& record)
+{
+    return record.parent == NO_INDEX ? NULL : &t.groups[record.parent].id;
+}
+
+template<typename Record>
+static bool moved(const tree& before, const Record& old_record,
+                    const tree& after, const Record& new_record)
+{
+    const uuid* old_parent = parent_id(before, old_record);
+    const uuid* new_parent = parent_id(after, new_record);
+
+    if (!old_parent || !new_parent) {
+        return old_parent != new_parent;
+    }
+
+    return *old_parent != *new_parent;
+}
+
+// Each side is walked once and looked up in the other side's index
+template<typename Record>
+static void diff(const tree& before, const vector<Record>& old_records,
+                    const uuid_index<uint32_t>& old_index,
+                    const tree& after, const vector<Record>& new_records,
+                    const uuid_index<uint32_t>& new_index,
+                    vector<uuid>& added, vector<uuid>& modified, vector<uuid>& removed)
+{
+    for (const Record& record : new_records) {
+        const uint32_t* found = old_index.find(record.id);
+
+        if (!found) {
+            added.push_back(record.id);
+            continue;
+        }
+
+        const Record& old_record = old_records[*found];
+
+        if (old_record.last_modified != record.last_modified
+                || moved(before, old_record, after, record)) {
+            modified.push_back(record.id);
+        }
+    }
+
+    for (const Record& record : old_records) {
+        if (!new_index.find(record.id)) {
+            removed.push_back(record.id);
+        }
+    }
+}
+
+void kdbx2_pvt::diff_tree(const kdbx::tree& before, const uuid_index<uint32_t>& groups_before,
+                            const uuid_index<uint32_t>& entries_before, change_set& changes) const
+{
+    diff(before, before.groups, groups_before, tree, tree.groups, group_index,
+            changes.added_groups, changes.modified_groups, changes.removed_groups);
+
+    diff(before, before.entries, entries_before, tree, tree.entries, entry_index,
+            changes.added_entries, changes.modified_entries, changes.removed_entries);
+}
+
+change_set kdbx2::reload()
+{
+    string path = _pvt->source_path;
+
+    if (path.empty()) {
+        throw parse_error("no file to reload");
+    }
+
+    change_set changes;
+
+    file_stamp stamp;
+    if (!stamp.read(path)) {
+        throw parse_error("unable to open file");
+    }
+
+    if (stamp == _pvt->source_stamp) {
+        return changes;
+    }
+
+    mapped_file file(path);
+
+    // Every save writes fresh seeds, so the same seeds mean the same save
+    // (e.g. the file was only touched or copied back)
+    {
+        membuf buffer(file.data(), file.size());
+        istream in(&buffer);
+
+        kdbx2 header;
+        header.load_header(in);
+
+        const kdbx2_pvt& next = *header._pvt;
+
+        if (next.master_seed == _pvt->master_seed
+                && next.encryption_iv == _pvt->encryption_iv
+                && next.stream_start_bytes == _pvt->stream_start_bytes) {
+            _pvt->source_stamp = stamp;
+            return changes;
+        }
+    }
+
+    // Load into a fresh instance, keeping the old one until it succeeds
+    std::unique_ptr<kdbx2_pvt> previous = std::move(_pvt);
+    _pvt = std::make_unique<kdbx2_pvt>(*this);
+    _pvt->take_settings(*previous);
+    _pvt->take_derived_key(*previous);
+
+    try {
+        load(file.data(), file.size());
+    } catch (...) {
+        // The failed load's key may come from another transform seed, so
+        // the old instance keeps its own
+        previous->take_settings(*_pvt);
+        _pvt = std::move(previous);
+        throw;
+    }
+
+    _pvt->source_path = path;
+    _pvt->source_stamp = stamp;
+
+    const kdbx2_pvt& before = *previous;
+    _pvt->diff_tree(before.tree, before.group_index, before.entry_index, changes);
+
+    changes.reloaded = true;
+    return changes;
+}
+
+}
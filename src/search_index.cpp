@@ -0,0 +1,313 @@
+#include "search_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+using std::string;
+using std::vector;
+
+namespace kdbx
+{
+
+static const entry::Field INDEXED_FIELDS[] = {
+    entry::TITLE,
+    entry::USER_NAME,
+    entry::URL,
+    entry::NOTES,
+};
+
+static inline uint8_t fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<uint8_t>(c - 'A' + 'a') : static_cast<uint8_t>(c);
+}
+
+static inline uint32_t trigram_at(const char* text)
+{
+    return static_cast<uint32_t>(fold(text[0])) << 16
+            | static_cast<uint32_t>(fold(text[1])) << 8
+            | fold(text[2]);
+}
+
+static bool contains_folded(const char* text, size_t length, const string& query)
+{
+    if (query.size() > length) {
+        return false;
+    }
+
+    for (size_t ii = 0; ii + query.size() <= length; ii++) {
+        size_t jj = 0;
+        while (jj < query.size() && fold(text[ii + jj]) == static_cast<uint8_t>(query[jj])) {
+            jj++;
+        }
+
+        if (jj == query.size()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void search_index::trigrams(const entry_record& record, vector<uint32_t>& out)
+{
+    out.clear();
+
+    for (entry::Field field : INDEXED_FIELDS) {
+        const string_field& value = record.standard[field];
+
+        if (!value.key || value.is_protected || value.length < 3) {
+            continue;
+        }
+
+        for (size_t ii = 0; ii + 3 <= value.length; ii++) {
+            out.push_back(trigram_at(value.value + ii));
+        }
+    }
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void search_index::decode(const posting& list, vector<uint32_t>& out)
+{
+    out.clear();
+    out.reserve(list.count);
+
+    uint32_t value = 0;
+    const uint8_t* data = list.data.data();
+
+    for (uint32_t ii = 0; ii < list.count; ii++) {
+        uint32_t delta = 0;
+        int shift = 0;
+
+        while (*data & 0x80) {
+            delta |= static_cast<uint32_t>(*data++ & 0x7F) << shift;
+            shift += 7;
+        }
+        delta |= static_cast<uint32_t>(*data++) << shift;
+
+        value += delta;
+        out.push_back(value);
+    }
+}
+
+void search_index::clear()
+{
+    _tree = nullptr;
+    _postings.clear();
+    _stale.clear();
+    _added.clear();
+    _added_count = 0;
+}
+
+void search_index::build(const kdbx::tree& tree)
+{
+    clear();
+    _tree = &tree;
+    _stale.assign(tree.entries.size(), false);
+
+    vector<uint32_t> grams;
+
+    // Entries are visited in order, so every list is appended in order
+    for (uint32_t ii = 0; ii < tree.entries.size(); ii++) {
+        trigrams(tree.entries[ii], grams);
+
+        for (uint32_t gram : grams) {
+            posting& list = _postings[gram];
+            uint32_t delta = list.count ? ii - list.last : ii;
+
+            while (delta >= 0x80) {
+                list.data.push_back(static_cast<uint8_t>(delta | 0x80));
+                delta >>= 7;
+            }
+            list.data.push_back(static_cast<uint8_t>(delta));
+
+            list.count++;
+            list.last = ii;
+        }
+    }
+
+    for (auto& list : _postings) {
+        list.second.data.shrink_to_fit();
+    }
+}
+
+void search_index::update(uint32_t entry)
+{
+    if (!_tree || entry >= _stale.size()) {
+        return;
+    }
+
+    // Forget anything added for the entry by an earlier update
+    if (_stale[entry]) {
+        for (auto& added : _added) {
+            vector<uint32_t>& list = added.second;
+            auto found = std::lower_bound(list.begin(), list.end(), entry);
+
+            if (found != list.end() && *found == entry) {
+                list.erase(found);
+                _added_count--;
+            }
+        }
+    }
+
+    _stale[entry] = true;
+
+    vector<uint32_t> grams;
+    trigrams(_tree->entries[entry], grams);
+
+    for (uint32_t gram : grams) {
+        vector<uint32_t>& list = _added[gram];
+        list.insert(std::lower_bound(list.begin(), list.end(), entry), entry);
+        _added_count++;
+    }
+
+    // Fold the changes back in once they stop being small
+    if (_added_count > _tree->entries.size() / 8 + 1024) {
+        build(*_tree);
+    }
+}
+
+void search_index::candidates(uint32_t trigram, vector<uint32_t>& out) const
+{
+    out.clear();
+
+    auto base = _postings.find(trigram);
+    if (base != _postings.end()) {
+        decode(base->second, out);
+
+        out.erase(std::remove_if(out.begin(), out.end(),
+                    [this](uint32_t entry) { return _stale[entry]; }), out.end());
+    }
+
+    auto added = _added.find(trigram);
+    if (added != _added.end() && !added->second.empty()) {
+        vector<uint32_t> merged;
+        merged.reserve(out.size() + added->second.size());
+        std::merge(out.begin(), out.end(), added->second.begin(), added->second.end(),
+                    std::back_inserter(merged));
+        out.swap(merged);
+    }
+}
+
+static string fold_query(const string& query)
+{
+    string folded(query.size(), '\0');
+    std::transform(query.begin(), query.end(), folded.begin(),
+                    [](char c) { return static_cast<char>(fold(c)); });
+    return folded;
+}
+
+bool search_index::matches(const entry_record& record, const string& query)
+{
+    for (entry::Field field : INDEXED_FIELDS) {
+        const string_field& value = record.standard[field];
+
+        if (value.key && !value.is_protected
+                && contains_folded(value.value, value.length, query)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+vector<uint32_t> search_index::search(const string& query, size_t limit) const
+{
+    vector<uint32_t> results;
+
+    if (!_tree || query.empty() || !limit) {
+        return results;
+    }
+
+    if (query.size() < 3) {
+        // Too short for a trigram
+        return scan(*_tree, query, limit);
+    }
+
+    string folded = fold_query(query);
+
+    vector<uint32_t> grams;
+    for (size_t ii = 0; ii + 3 <= folded.size(); ii++) {
+        grams.push_back(trigram_at(folded.c_str() + ii));
+    }
+
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+    // Start from the rarest trigram so the intersections stay small
+    auto size_of = [this](uint32_t gram) -> size_t {
+        auto base = _postings.find(gram);
+        auto added = _added.find(gram);
+        return (base != _postings.end() ? base->second.count : 0)
+                + (added != _added.end() ? added->second.size() : 0);
+    };
+
+    std::sort(grams.begin(), grams.end(), [&size_of](uint32_t a, uint32_t b) {
+        return size_of(a) < size_of(b);
+    });
+
+    vector<uint32_t> current;
+    vector<uint32_t> next;
+    vector<uint32_t> intersection;
+
+    candidates(grams[0], current);
+
+    for (size_t ii = 1; ii < grams.size() && !current.empty(); ii++) {
+        candidates(grams[ii], next);
+
+        intersection.clear();
+        std::set_intersection(current.begin(), current.end(), next.begin(), next.end(),
+                                std::back_inserter(intersection));
+        current.swap(intersection);
+    }
+
+    for (uint32_t entry : current) {
+        if (results.size() >= limit) {
+            break;
+        }
+
+        if (matches(_tree->entries[entry], folded)) {
+            results.push_back(entry);
+        }
+    }
+
+    return results;
+}
+
+vector<uint32_t> search_index::scan(const kdbx::tree& tree, const string& query, size_t limit)
+{
+    vector<uint32_t> results;
+
+    if (query.empty()) {
+        return results;
+    }
+
+    string folded = fold_query(query);
+
+    for (uint32_t ii = 0; ii < tree.entries.size() && results.size() < limit; ii++) {
+        if (matches(tree.entries[ii], folded)) {
+            results.push_back(ii);
+        }
+    }
+
+    return results;
+}
+
+size_t search_index::memory_usage() const
+{
+    size_t total = _stale.size() / 8;
+
+    for (const auto& list : _postings) {
+        total += sizeof(list) + list.second.data.capacity();
+    }
+
+    for (const auto& list : _added) {
+        total += sizeof(list) + list.second.capacity() * sizeof(uint32_t);
+    }
+
+    return total;
+}
+
+}
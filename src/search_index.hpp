@@ -0,0 +1,68 @@
+#ifndef SEARCH_INDEX_HPP
+#define SEARCH_INDEX_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tree.hpp"
+
+namespace kdbx
+{
+
+/*
+ * Trigram index over the non-protected Title, UserName, URL and Notes of
+ * every entry, matched case insensitively (ASCII only).
+ *
+ * Each trigram maps to the sorted list of entries containing it, stored as
+ * varint encoded deltas. Entries updated after the build are marked stale
+ * in the compressed lists and their new trigrams kept in small uncompressed
+ * lists until enough have piled up to be worth a rebuild. Candidates are
+ * checked against the actual text, so results are exact.
+ */
+class search_index
+{
+private:
+    struct posting
+    {
+        std::vector<uint8_t> data;
+        uint32_t count = 0;
+        uint32_t last = 0;
+    };
+
+    const kdbx::tree* _tree = nullptr;
+    std::unordered_map<uint32_t, posting> _postings;
+
+    // Changes since the postings were built
+    std::vector<bool> _stale;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> _added;
+    size_t _added_count = 0;
+
+    static void trigrams(const entry_record& record, std::vector<uint32_t>& out);
+    static void decode(const posting& list, std::vector<uint32_t>& out);
+
+    static bool matches(const entry_record& record, const std::string& folded);
+
+    void candidates(uint32_t trigram, std::vector<uint32_t>& out) const;
+
+public:
+    void build(const kdbx::tree& tree);
+    void clear();
+
+    // Re-reads the fields of one entry after it has changed
+    void update(uint32_t entry);
+
+    // Indices of matching entries in tree order, at most limit of them
+    std::vector<uint32_t> search(const std::string& query, size_t limit) const;
+
+    size_t memory_usage() const;
+
+    // The same search by checking every entry, for when there is no index
+    static std::vector<uint32_t> scan(const kdbx::tree& tree,
+                                        const std::string& query, size_t limit);
+};
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "semaphore.hpp"
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+namespace kdbx
+{
+
+semaphore::semaphore(size_t count)
+    : _count(count)
+{
+
+}
+
+void semaphore::acquire()
+{
+    unique_lock<mutex> lock(_mutex);
+    _available.wait(lock, [this] { return _count > 0; });
+    _count--;
+}
+
+void semaphore::release()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _count++;
+    }
+
+    _available.notify_one();
+}
+
+semaphore_guard::semaphore_guard(semaphore* sem)
+    : _sem(sem)
+{
+    if (_sem) {
+        _sem->acquire();
+    }
+}
+
+semaphore_guard::~semaphore_guard()
+{
+    if (_sem) {
+        _sem->release();
+    }
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef SEMAPHORE_HPP
+#define SEMAPHORE_HPP 1
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace kdbx
+{
+
+/*
+ * Counting semaphore, used to cap how many key derivations run at once.
+ */
+class semaphore
+{
+private:
+    semaphore(const semaphore&);
+    semaphore& operator=(const semaphore&);
+
+    std::mutex _mutex;
+    std::condition_variable _available;
+    size_t _count;
+
+public:
+    explicit semaphore(size_t count);
+
+    void acquire();
+    void release();
+};
+
+class semaphore_guard
+{
+private:
+    semaphore_guard(const semaphore_guard&);
+    semaphore_guard& operator=(const semaphore_guard&);
+
+    semaphore* _sem;
+
+public:
+    // A NULL semaphore does nothing
+    explicit semaphore_guard(semaphore* sem);
+    ~semaphore_guard();
+};
+
+}
+
+#endif
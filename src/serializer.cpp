@@ -0,0 +1,120 @@
+#include "serializer.hpp"
+
+#include <cstring>
+
+using pugi::xml_attribute;
+using pugi::xml_node;
+
+namespace kdbx
+{
+
+serializer::serializer(std::ostream& out, text_filter filter)
+    : _out(out), _filter(std::move(filter))
+{
+
+}
+
+void serializer::write(const pugi::xml_document& document)
+{
+    _out << "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\n";
+
+    for (xml_node child : document) {
+        if (child.type() != pugi::node_declaration) {
+            write_node(child);
+        }
+    }
+}
+
+void serializer::write_node(const xml_node& node)
+{
+    switch (node.type()) {
+        case pugi::node_element:
+            write_element(node);
+            break;
+
+        case pugi::node_pcdata:
+            write_escaped(node.value(), false);
+            break;
+
+        case pugi::node_cdata:
+            _out << "<![CDATA[" << node.value() << "]]>";
+            break;
+
+        case pugi::node_comment:
+            _out << "<!--" << node.value() << "-->";
+            break;
+
+        default:
+            break;
+    }
+}
+
+void serializer::write_element(const xml_node& node)
+{
+    _out << '<' << node.name();
+
+    for (xml_attribute attribute = node.first_attribute(); attribute;
+            attribute = attribute.next_attribute()) {
+        _out << ' ' << attribute.name() << "=\"";
+        write_escaped(attribute.value(), true);
+        _out << '"';
+    }
+
+    if (_filter && _filter(node, _replacement)) {
+        _out << '>';
+        write_escaped(_replacement.c_str(), false);
+        _out << "</" << node.name() << ">\n";
+        return;
+    }
+
+    if (!node.first_child()) {
+        _out << "/>\n";
+        return;
+    }
+
+    _out << '>';
+
+    bool elements = false;
+    for (xml_node child : node) {
+        if (child.type() == pugi::node_element && !elements) {
+            _out << '\n';
+            elements = true;
+        }
+
+        write_node(child);
+    }
+
+    _out << "</" << node.name() << ">\n";
+}
+
+void serializer::write_escaped(const char* text, bool attribute)
+{
+    const char* run = text;
+
+    for (const char* ii = text; ; ii++) {
+        const char* entity = nullptr;
+
+        switch (*ii) {
+            case '\0':
+                _out.write(run, ii - run);
+                return;
+
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = attribute ? "&quot;" : nullptr; break;
+            case '\r': entity = "&#13;"; break;
+            case '\n': entity = attribute ? "&#10;" : nullptr; break;
+            case '\t': entity = attribute ? "&#9;" : nullptr; break;
+            default: break;
+        }
+
+        if (entity) {
+            _out.write(run, ii - run);
+            _out << entity;
+            run = ii + 1;
+        }
+    }
+}
+
+}
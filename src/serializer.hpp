@@ -0,0 +1,40 @@
+#ifndef SERIALIZER_HPP
+#define SERIALIZER_HPP 1
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "pugixml.hpp"
+
+namespace kdbx
+{
+
+/*
+ * Writes a document as XML while walking it, so the output never has to be
+ * held in memory. The filter may substitute the text of an element, which
+ * is how protected values are re-encrypted without touching the document.
+ */
+class serializer
+{
+public:
+    // Returns true and sets text to replace the element's text
+    typedef std::function<bool(const pugi::xml_node&, std::string& text)> text_filter;
+
+private:
+    std::ostream& _out;
+    text_filter _filter;
+    std::string _replacement;
+
+    void write_node(const pugi::xml_node& node);
+    void write_element(const pugi::xml_node& node);
+    void write_escaped(const char* text, bool attribute);
+
+public:
+    serializer(std::ostream& out, text_filter filter);
+
+    void write(const pugi::xml_document& document);
+};
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "snapshot.hpp"
+
+#include <thread>
+
+using std::lock_guard;
+using std::mutex;
+
+namespace kdbx
+{
+
+snapshot_holder::snapshot_holder(snapshot db)
+    : _current(new node{std::move(db)}), _epoch(0)
+{
+    _readers[0] = 0;
+    _readers[1] = 0;
+}
+
+snapshot_holder::~snapshot_holder()
+{
+    delete _current.load();
+}
+
+snapshot snapshot_holder::get() const
+{
+    while (true) {
+        uint32_t epoch = _epoch.load();
+        _readers[epoch & 1]++;
+
+        // A publisher that moved on before we were counted won't wait for
+        // us, so count ourselves in the new epoch instead
+        if (_epoch.load() != epoch) {
+            _readers[epoch & 1]--;
+            continue;
+        }
+
+        snapshot db = _current.load()->db;
+        _readers[epoch & 1]--;
+        return db;
+    }
+}
+
+snapshot snapshot_holder::publish(snapshot db)
+{
+    lock_guard<mutex> lock(_publish);
+
+    node* old = _current.exchange(new node{std::move(db)});
+
+    // Readers counted in the old epoch may still be copying the old node
+    uint32_t epoch = _epoch.load();
+    _epoch.store(epoch + 1);
+
+    while (_readers[epoch & 1].load() != 0) {
+        std::this_thread::yield();
+    }
+
+    snapshot replaced = std::move(old->db);
+    delete old;
+    return replaced;
+}
+
+}
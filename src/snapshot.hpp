@@ -0,0 +1,60 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP 1
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "kdbx.hpp"
+
+namespace kdbx
+{
+
+/*
+ * A loaded database that no one changes any more. Any number of threads
+ * may read it at once; it is destroyed, and its decrypted memory wiped,
+ * when the last reference goes.
+ */
+typedef std::shared_ptr<const kdbx2> snapshot;
+
+/*
+ * Publishes snapshots to concurrent readers, RCU style.
+ *
+ * Readers never block: they announce themselves in a counter for the
+ * current epoch, copy the current snapshot's reference and leave. A
+ * publisher swaps in the new snapshot, moves to the next epoch and waits
+ * for the readers of the last one to leave before dropping its reference
+ * to the old snapshot. Readers still holding it keep it alive.
+ */
+class snapshot_holder
+{
+private:
+    snapshot_holder(const snapshot_holder&);
+    snapshot_holder& operator=(const snapshot_holder&);
+
+    struct node
+    {
+        snapshot db;
+    };
+
+    std::atomic<node*> _current;
+    std::atomic<uint32_t> _epoch;
+    mutable std::atomic<uint32_t> _readers[2];
+
+    // Publishers take turns; readers never touch it
+    std::mutex _publish;
+
+public:
+    explicit snapshot_holder(snapshot db = snapshot());
+    ~snapshot_holder();
+
+    // The latest snapshot, or NULL if nothing has been published
+    snapshot get() const;
+
+    // Replaces the current snapshot and returns the one it replaced
+    snapshot publish(snapshot db);
+};
+
+}
+
+#endif
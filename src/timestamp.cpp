@@ -0,0 +1,117 @@
+#include "timestamp.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include "base64.hpp"
+#include "errors.hpp"
+
+namespace kdbx
+{
+
+static bool parse_digits(const char*& text, int count, int& out)
+{
+    out = 0;
+
+    for (int ii = 0; ii < count; ii++, text++) {
+        if (*text < '0' || *text > '9') {
+            return false;
+        }
+
+        out = out * 10 + (*text - '0');
+    }
+
+    return true;
+}
+
+static bool expect(const char*& text, char c)
+{
+    if (*text != c) {
+        return false;
+    }
+
+    text++;
+    return true;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+static int64_t days_from_civil(int64_t y, int m, int d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// KDBX 4 stores a little endian int64 of seconds since 0001-01-01
+static bool parse_binary(const char* text, timestamp& out)
+{
+    size_t length = std::strlen(text);
+    byte bytes[sizeof(int64_t)];
+
+    if (base64_decoded_size(text, length) != sizeof(bytes)) {
+        return false;
+    }
+
+    try {
+        base64_decode(text, length, bytes);
+    } catch (const parse_error&) {
+        return false;
+    }
+
+    int64_t seconds;
+    std::memcpy(&seconds, bytes, sizeof(seconds));
+
+    // Nothing KeePass writes is before year 1
+    if (seconds < 0) {
+        return false;
+    }
+
+    out = timestamp(std::chrono::seconds(seconds + days_from_civil(1, 1, 1) * 86400));
+    return true;
+}
+
+bool parse_timestamp(const char* text, timestamp& out)
+{
+    // The ISO form always has a dash after the year
+    if (std::strlen(text) < 5 || text[4] != '-') {
+        return parse_binary(text, out);
+    }
+
+    int year, month, day, hour, minute, second;
+
+    if (!parse_digits(text, 4, year) || !expect(text, '-')
+            || !parse_digits(text, 2, month) || !expect(text, '-')
+            || !parse_digits(text, 2, day) || !expect(text, 'T')
+            || !parse_digits(text, 2, hour) || !expect(text, ':')
+            || !parse_digits(text, 2, minute) || !expect(text, ':')
+            || !parse_digits(text, 2, second)) {
+        return false;
+    }
+
+    if (month < 1 || month > 12 || day < 1 || day > 31
+            || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    // Ignore fractional seconds
+    if (*text == '.') {
+        do {
+            text++;
+        } while (*text >= '0' && *text <= '9');
+    }
+
+    if (*text != 'Z' && *text != '\0') {
+        return false;
+    }
+
+    int64_t seconds = days_from_civil(year, month, day) * 86400
+                        + hour * 3600 + minute * 60 + second;
+
+    out = timestamp(std::chrono::seconds(seconds));
+    return true;
+}
+
+}
@@ -0,0 +1,19 @@
+#ifndef TIMESTAMP_HPP
+#define TIMESTAMP_HPP 1
+#include <chrono>
+
+namespace kdbx
+{
+
+// KeePass times are whole seconds, from year 1 (DateTime.MinValue) to year
+// 9999. Counting seconds keeps that range well inside int64, which the
+// clock's own nanoseconds would not.
+typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::seconds> timestamp;
+
+// Parses the UTC ISO 8601 form KeePass writes, e.g. "2013-11-03T00:58:17Z",
+// or the base64 encoded seconds since 0001-01-01 that KDBX 4 writes
+bool parse_timestamp(const char* text, timestamp& out);
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "transform.hpp"
+
+#include "cryptopp/aes.h"
+
+#include "errors.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KDBX_AESNI 1
+#include <wmmintrin.h>
+#endif
+
+using CryptoPP::AES;
+using CryptoPP::BlockTransformation;
+using CryptoPP::SecByteBlock;
+
+namespace kdbx
+{
+
+#ifdef KDBX_AESNI
+
+#define KDBX_AESNI_TARGET __attribute__((target("aes,sse2")))
+
+KDBX_AESNI_TARGET
+static inline __m128i expand_step(__m128i key, __m128i assist)
+{
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+// Round constants have to be immediates, hence the macros.
+#define KDBX_EXPAND_EVEN(ii, rcon) \
+    rk[ii] = expand_step(rk[ii - 2], \
+        _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[ii - 1], rcon), 0xff))
+
+#define KDBX_EXPAND_ODD(ii) \
+    rk[ii] = expand_step(rk[ii - 2], \
+        _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[ii - 1], 0x00), 0xaa))
+
+KDBX_AESNI_TARGET
+static void transform_aesni(const byte* seed, byte* key, uint64_t rounds)
+{
+    __m128i rk[15];
+
+    rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seed));
+    rk[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seed + 16));
+    KDBX_EXPAND_EVEN(2, 0x01);
+    KDBX_EXPAND_ODD(3);
+    KDBX_EXPAND_EVEN(4, 0x02);
+    KDBX_EXPAND_ODD(5);
+    KDBX_EXPAND_EVEN(6, 0x04);
+    KDBX_EXPAND_ODD(7);
+    KDBX_EXPAND_EVEN(8, 0x08);
+    KDBX_EXPAND_ODD(9);
+    KDBX_EXPAND_EVEN(10, 0x10);
+    KDBX_EXPAND_ODD(11);
+    KDBX_EXPAND_EVEN(12, 0x20);
+    KDBX_EXPAND_ODD(13);
+    KDBX_EXPAND_EVEN(14, 0x40);
+
+    __m128i lane0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    __m128i lane1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 16));
+
+    for (uint64_t ii = 0; ii < rounds; ii++) {
+        lane0 = _mm_xor_si128(lane0, rk[0]);
+        lane1 = _mm_xor_si128(lane1, rk[0]);
+
+        for (int jj = 1; jj < 14; jj++) {
+            lane0 = _mm_aesenc_si128(lane0, rk[jj]);
+            lane1 = _mm_aesenc_si128(lane1, rk[jj]);
+        }
+
+        lane0 = _mm_aesenclast_si128(lane0, rk[14]);
+        lane1 = _mm_aesenclast_si128(lane1, rk[14]);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(key), lane0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(key + 16), lane1);
+
+    // Don't leave the expanded key schedule behind on the stack
+    volatile __m128i* wipe = rk;
+    for (int ii = 0; ii < 15; ii++) {
+        wipe[ii] = _mm_setzero_si128();
+    }
+}
+
+#undef KDBX_EXPAND_EVEN
+#undef KDBX_EXPAND_ODD
+
+#endif
+
+static void transform_portable(const SecByteBlock& seed, byte* key, uint64_t rounds)
+{
+    AES::Encryption aes(seed.data(), seed.size());
+
+    for (uint64_t ii = 0; ii < rounds; ii++) {
+        aes.AdvancedProcessBlocks(key, NULL, key, key_transform::KEY_SIZE,
+                                    BlockTransformation::BT_AllowParallel);
+    }
+}
+
+key_transform::key_transform(const SecByteBlock& seed, bool use_aesni)
+    : _seed(seed), _aesni(use_aesni && has_aesni())
+{
+    if (_seed.size() != 32) {
+        throw parse_error("transform seed unknown format");
+    }
+}
+
+void key_transform::apply(byte* key, uint64_t rounds) const
+{
+#ifdef KDBX_AESNI
+    if (_aesni) {
+        transform_aesni(_seed.data(), key, rounds);
+        return;
+    }
+#endif
+
+    transform_portable(_seed, key, rounds);
+}
+
+bool key_transform::uses_aesni() const
+{
+    return _aesni;
+}
+
+bool key_transform::has_aesni()
+{
+#ifdef KDBX_AESNI
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes");
+#else
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,42 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP 1
+#include <cstdint>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * Runs the AES-ECB key transformation used by the KDBX 2/3 key derivation.
+ *
+ * The two 16 byte halves of the key are independent, so both are encrypted
+ * side by side. When the CPU supports AES-NI the round keys are expanded
+ * once and both lanes stay in registers for every round; otherwise the work
+ * falls back to CryptoPP's block cipher.
+ */
+class key_transform
+{
+private:
+    key_transform(const key_transform&);
+    key_transform& operator=(const key_transform&);
+
+    CryptoPP::SecByteBlock _seed;
+    bool _aesni;
+
+public:
+    static const size_t KEY_SIZE = 32;
+
+    // With use_aesni false the portable engine runs even on CPUs with
+    // AES-NI, so the two can be checked against each other
+    explicit key_transform(const CryptoPP::SecByteBlock& seed, bool use_aesni = true);
+
+    void apply(byte* key, uint64_t rounds) const;
+
+    bool uses_aesni() const;
+
+    static bool has_aesni();
+};
+
+}
+
+#endif
@@ -0,0 +1,218 @@
+#include "tree.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "errors.hpp"
+#include "timestamp.hpp"
+
+using pugi::xml_node;
+
+namespace kdbx
+{
+
+static timestamp read_modified(const xml_node& node)
+{
+    timestamp modified;
+    parse_timestamp(node.child("Times").child("LastModificationTime").text().get(), modified);
+    return modified;
+}
+
+static const char* const STANDARD_KEYS[] = {
+    "Title",
+    "UserName",
+    "Password",
+    "URL",
+    "Notes",
+};
+
+int standard_slot(const char* key, size_t length)
+{
+    // Only look at the one candidate with a matching length
+    int slot;
+
+    switch (length) {
+        case 3:
+            slot = entry::URL;
+            break;
+
+        case 5:
+            slot = key[0] == 'T' ? entry::TITLE : entry::NOTES;
+            break;
+
+        case 8:
+            slot = key[0] == 'U' ? entry::USER_NAME : entry::PASSWORD;
+            break;
+
+        default:
+            return -1;
+    }
+
+    if (std::memcmp(key, STANDARD_KEYS[slot], length) != 0) {
+        return -1;
+    }
+
+    return slot;
+}
+
+void tree::clear()
+{
+    groups.clear();
+    entries.clear();
+    custom_fields.clear();
+    binary_refs.clear();
+    first_group = NO_INDEX;
+}
+
+void tree::build(const xml_node& root, const protected_map& protected_values)
+{
+    clear();
+
+    uint32_t previous = NO_INDEX;
+
+    for (xml_node child : root) {
+        if (std::strcmp(child.name(), "Group")) {
+            continue;
+        }
+
+        uint32_t index = build_group(child, NO_INDEX, protected_values);
+
+        if (previous == NO_INDEX) {
+            first_group = index;
+        } else {
+            groups[previous].next_sibling = index;
+        }
+
+        previous = index;
+    }
+}
+
+uint32_t tree::build_group(const xml_node& node, uint32_t parent,
+                            const protected_map& protected_values)
+{
+    uint32_t index = static_cast<uint32_t>(groups.size());
+    const char* uuid_text = node.child("UUID").text().get();
+
+    group_record record;
+    record.node = node;
+    record.id = uuid::from_base64(uuid_text);
+    record.uuid_text = uuid_text;
+    record.name = node.child("Name").text().get();
+    record.notes = node.child("Notes").text().get();
+    record.icon_id = node.child("IconID").text().as_int();
+    record.is_expanded = node.child("IsExpanded").text().as_bool(false);
+    record.enable_auto_type = node.child("EnableAutoType").text().get();
+    record.enable_searching = node.child("EnableSearching").text().get();
+    record.last_top_visible_entry = node.child("LastTopVisibleEntry").text().get();
+    record.last_modified = read_modified(node);
+    record.parent = parent;
+    record.first_child = NO_INDEX;
+    record.next_sibling = NO_INDEX;
+    record.first_entry = static_cast<uint32_t>(entries.size());
+
+    groups.push_back(record);
+
+    // Direct entries first, so they form one run
+    for (xml_node child : node) {
+        if (!std::strcmp(child.name(), "Entry")) {
+            build_entry(child, index, protected_values);
+        }
+    }
+
+    groups[index].entry_count = static_cast<uint32_t>(entries.size()) - groups[index].first_entry;
+
+    uint32_t previous = NO_INDEX;
+
+    for (xml_node child : node) {
+        if (std::strcmp(child.name(), "Group")) {
+            continue;
+        }
+
+        uint32_t child_index = build_group(child, index, protected_values);
+
+        if (previous == NO_INDEX) {
+            groups[index].first_child = child_index;
+        } else {
+            groups[previous].next_sibling = child_index;
+        }
+
+        previous = child_index;
+    }
+
+    groups[index].subtree_end = static_cast<uint32_t>(groups.size());
+    groups[index].subtree_entry_end = static_cast<uint32_t>(entries.size());
+
+    return index;
+}
+
+void tree::build_entry(const xml_node& node, uint32_t parent,
+                        const protected_map& protected_values)
+{
+    const char* uuid_text = node.child("UUID").text().get();
+
+    entry_record record;
+    record.node = node;
+    record.id = uuid::from_base64(uuid_text);
+    record.uuid_text = uuid_text;
+    record.parent = parent;
+    record.last_modified = read_modified(node);
+    record.first_custom = static_cast<uint32_t>(custom_fields.size());
+    record.first_binary = static_cast<uint32_t>(binary_refs.size());
+    std::memset(record.standard, 0, sizeof(record.standard));
+
+    for (xml_node outer : node) {
+        if (!std::strcmp("Binary", outer.name())) {
+            // Only references into the pool; the contents stay where they are
+            pugi::xml_attribute ref = outer.child("Value").attribute("Ref");
+
+            if (ref) {
+                binary_refs.push_back({outer.child("Key").text().get(), ref.as_uint()});
+            }
+
+            continue;
+        }
+
+        if (std::strcmp("String", outer.name()) != 0) {
+            continue;
+        }
+
+        xml_node value = outer.child("Value");
+
+        string_field field;
+        field.key = outer.child("Key").text().get();
+        field.value = value.text().get();
+        field.length = std::strlen(field.value);
+        field.is_protected = value.attribute("Protected").as_bool(false);
+        field.protected_offset = 0;
+
+        if (field.is_protected) {
+            auto found = protected_values.find(value.internal_object());
+
+            if (found == protected_values.end()) {
+                throw parse_error("protected value not indexed");
+            }
+
+            field.protected_offset = found->second.offset;
+        }
+
+        int slot = standard_slot(field.key, std::strlen(field.key));
+
+        if (slot < 0) {
+            custom_fields.push_back(field);
+        } else {
+            record.standard[slot] = field;
+        }
+    }
+
+    record.custom_count = static_cast<uint32_t>(custom_fields.size()) - record.first_custom;
+    record.binary_count = static_cast<uint32_t>(binary_refs.size()) - record.first_binary;
+
+    std::sort(custom_fields.begin() + record.first_custom, custom_fields.end(),
+        [](const string_field& a, const string_field& b) {
+            return std::strcmp(a.key, b.key) < 0;
+        });
+
+    entries.push_back(record);
+}
+
+}
@@ -0,0 +1,105 @@
+#ifndef TREE_HPP
+#define TREE_HPP 1
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "pugixml.hpp"
+
+#include "entry.hpp"
+#include "range.hpp"
+#include "timestamp.hpp"
+#include "uuid.hpp"
+
+namespace kdbx
+{
+
+/*
+ * Groups are stored in pre-order, so the subtree of a group is the run of
+ * groups up to subtree_end. Entries are stored in the same order with the
+ * direct entries of a group placed before those of its children, so both
+ * a group's own entries and the entries of its whole subtree are runs too.
+ */
+struct group_record
+{
+    pugi::xml_node node;
+    uuid id;
+    const char* uuid_text;
+    const char* name;
+    const char* notes;
+    int icon_id;
+    bool is_expanded;
+    const char* enable_auto_type;
+    const char* enable_searching;
+    const char* last_top_visible_entry;
+    timestamp last_modified;
+
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t subtree_end;
+
+    uint32_t first_entry;
+    uint32_t entry_count;
+    uint32_t subtree_entry_end;
+};
+
+struct entry_record
+{
+    pugi::xml_node node;
+    uuid id;
+    const char* uuid_text;
+    uint32_t parent;
+    timestamp last_modified;
+
+    string_field standard[entry::STANDARD_FIELD_COUNT];
+
+    // Custom fields are a run in tree::custom_fields, sorted by key
+    uint32_t first_custom;
+    uint32_t custom_count;
+
+    // Attachments are a run in tree::binary_refs, in document order
+    uint32_t first_binary;
+    uint32_t binary_count;
+};
+
+// An entry's reference to an attachment in the pool
+struct binary_ref
+{
+    const char* key;
+    uint32_t ref;
+};
+
+struct protected_value
+{
+    uint64_t offset;
+    size_t length;
+};
+
+typedef std::unordered_map<const pugi::xml_node_struct*, protected_value> protected_map;
+
+// Slot of a standard field key, or -1 for custom keys
+int standard_slot(const char* key, size_t length);
+
+struct tree
+{
+    std::vector<group_record> groups;
+    std::vector<entry_record> entries;
+    std::vector<string_field> custom_fields;
+    std::vector<binary_ref> binary_refs;
+
+    uint32_t first_group = NO_INDEX;
+
+    void clear();
+    void build(const pugi::xml_node& root, const protected_map& protected_values);
+
+private:
+    uint32_t build_group(const pugi::xml_node& node, uint32_t parent,
+                            const protected_map& protected_values);
+    void build_entry(const pugi::xml_node& node, uint32_t parent,
+                        const protected_map& protected_values);
+};
+
+}
+
+#endif
@@ -0,0 +1,286 @@
+#include "url_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using std::string;
+using std::vector;
+
+namespace kdbx
+{
+
+static const uint32_t ROOT = 0;
+
+static inline char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool is_host_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_';
+}
+
+bool parsed_url::parse(const char* text, size_t length, parsed_url& out)
+{
+    const char* begin = text;
+    const char* end = text + length;
+
+    while (begin < end && is_space(*begin)) {
+        begin++;
+    }
+    while (end > begin && is_space(*(end - 1))) {
+        end--;
+    }
+
+    out = parsed_url();
+
+    // Scheme, if there is one
+    const char* colon = static_cast<const char*>(std::memchr(begin, ':', end - begin));
+    if (colon && end - colon >= 3 && colon[1] == '/' && colon[2] == '/') {
+        for (const char* ii = begin; ii < colon; ii++) {
+            out.scheme_name.push_back(lower(*ii));
+        }
+
+        if (out.scheme_name == "http") {
+            out.scheme = HTTP;
+        } else if (out.scheme_name == "https") {
+            out.scheme = HTTPS;
+        } else {
+            out.scheme = OTHER;
+        }
+
+        begin = colon + 3;
+    }
+
+    // The authority runs up to the path, query or fragment
+    const char* authority_end = begin;
+    while (authority_end < end && *authority_end != '/' && *authority_end != '?'
+            && *authority_end != '#') {
+        authority_end++;
+    }
+
+    // Drop any user info
+    for (const char* ii = authority_end; ii > begin; ii--) {
+        if (*(ii - 1) == '@') {
+            begin = ii;
+            break;
+        }
+    }
+
+    const char* host_end = authority_end;
+    const char* port_begin = nullptr;
+
+    if (begin < authority_end && *begin == '[') {
+        // IPv6 literal
+        const char* close = static_cast<const char*>(std::memchr(begin, ']', authority_end - begin));
+        if (!close) {
+            return false;
+        }
+
+        out.host.assign(begin + 1, close);
+        out.is_ip = true;
+
+        if (close + 1 < authority_end && close[1] == ':') {
+            port_begin = close + 2;
+        }
+    } else {
+        for (const char* ii = begin; ii < authority_end; ii++) {
+            if (*ii == ':') {
+                host_end = ii;
+                port_begin = ii + 1;
+                break;
+            }
+        }
+
+        for (const char* ii = begin; ii < host_end; ii++) {
+            char c = lower(*ii);
+            if (!is_host_char(c)) {
+                return false;
+            }
+            out.host.push_back(c);
+        }
+
+        while (!out.host.empty() && out.host.back() == '.') {
+            out.host.pop_back();
+        }
+
+        if (out.host.empty() || out.host.front() == '.'
+                || out.host.find("..") != string::npos) {
+            return false;
+        }
+
+        out.is_ip = out.host.find_first_not_of("0123456789.") == string::npos;
+    }
+
+    if (port_begin && port_begin < authority_end) {
+        uint32_t port = 0;
+
+        for (const char* ii = port_begin; ii < authority_end; ii++) {
+            if (*ii < '0' || *ii > '9' || port > 65535) {
+                return false;
+            }
+            port = port * 10 + static_cast<uint32_t>(*ii - '0');
+        }
+
+        if (port == 0 || port > 65535) {
+            return false;
+        }
+
+        out.port = static_cast<uint16_t>(port);
+        out.explicit_port = true;
+    } else if (out.scheme == HTTP) {
+        out.port = 80;
+    } else if (out.scheme == HTTPS) {
+        out.port = 443;
+    }
+
+    return !out.host.empty();
+}
+
+void url_index::clear()
+{
+    _labels.clear();
+    _children.clear();
+    _nodes.clear();
+    _targets.clear();
+}
+
+uint32_t url_index::find_child(uint32_t parent, const char* label, size_t length) const
+{
+    auto id = _labels.find(string(label, length));
+    if (id == _labels.end()) {
+        return NO_INDEX;
+    }
+
+    auto child = _children.find(static_cast<uint64_t>(parent) << 32 | id->second);
+    return child != _children.end() ? child->second : NO_INDEX;
+}
+
+void url_index::build(const kdbx::tree& tree)
+{
+    clear();
+
+    _nodes.push_back({0, 0, 0});
+
+    // Targets are collected per node first, then laid out contiguously
+    vector<vector<target>> pending(1);
+    parsed_url url;
+
+    for (uint32_t ii = 0; ii < tree.entries.size(); ii++) {
+        const string_field& field = tree.entries[ii].standard[entry::URL];
+
+        if (!field.key || field.is_protected
+                || !parsed_url::parse(field.value, field.length, url)) {
+            continue;
+        }
+
+        uint32_t current = ROOT;
+        size_t label_end = url.host.size();
+
+        // Walk the labels right to left
+        while (label_end > 0) {
+            size_t dot = url.host.rfind('.', label_end - 1);
+            size_t label_begin = dot == string::npos ? 0 : dot + 1;
+
+            string label = url.host.substr(label_begin, label_end - label_begin);
+            auto id = _labels.emplace(label, static_cast<uint32_t>(_labels.size())).first->second;
+            uint64_t key = static_cast<uint64_t>(current) << 32 | id;
+
+            auto child = _children.find(key);
+            if (child == _children.end()) {
+                uint32_t created = static_cast<uint32_t>(_nodes.size());
+                _nodes.push_back({_nodes[current].depth + 1, 0, 0});
+                pending.emplace_back();
+                child = _children.emplace(key, created).first;
+            }
+
+            current = child->second;
+            label_end = label_begin ? label_begin - 1 : 0;
+        }
+
+        pending[current].push_back({ii, url.scheme, url.port, url.explicit_port, url.is_ip});
+    }
+
+    for (size_t ii = 0; ii < _nodes.size(); ii++) {
+        _nodes[ii].first_target = static_cast<uint32_t>(_targets.size());
+        _nodes[ii].target_count = static_cast<uint32_t>(pending[ii].size());
+        _targets.insert(_targets.end(), pending[ii].begin(), pending[ii].end());
+    }
+}
+
+size_t url_index::find(const string& text, vector<match>& out) const
+{
+    parsed_url url;
+
+    if (_nodes.empty() || !parsed_url::parse(text.data(), text.size(), url)) {
+        return 0;
+    }
+
+    size_t first = out.size();
+    uint32_t current = ROOT;
+    size_t label_end = url.host.size();
+
+    while (label_end > 0) {
+        size_t dot = url.host.rfind('.', label_end - 1);
+        size_t label_begin = dot == string::npos ? 0 : dot + 1;
+
+        current = find_child(current, url.host.data() + label_begin, label_end - label_begin);
+        if (current == NO_INDEX) {
+            break;
+        }
+
+        const node& here = _nodes[current];
+        bool exact = label_begin == 0;
+
+        for (uint32_t jj = 0; jj < here.target_count; jj++) {
+            const target& candidate = _targets[here.first_target + jj];
+
+            // Suffixes need at least two labels and never apply to addresses
+            if (!exact && (here.depth < 2 || candidate.is_ip || url.is_ip)) {
+                continue;
+            }
+
+            uint32_t score = here.depth * 8 + (exact ? 256 : 0);
+
+            if (candidate.scheme != parsed_url::NONE && url.scheme != parsed_url::NONE) {
+                if (candidate.scheme == url.scheme) {
+                    score += 4;
+                } else if (!(candidate.scheme == parsed_url::HTTP && url.scheme == parsed_url::HTTPS)) {
+                    // Never offer https credentials to http, or mix other schemes
+                    continue;
+                }
+            }
+
+            if (candidate.explicit_port) {
+                if (candidate.port != url.port) {
+                    continue;
+                }
+                score += 2;
+            } else if (!url.explicit_port) {
+                score += 1;
+            }
+
+            out.push_back({candidate.entry, score});
+        }
+
+        if (exact) {
+            break;
+        }
+
+        label_end = label_begin - 1;
+    }
+
+    std::sort(out.begin() + first, out.end(), [](const match& a, const match& b) {
+        return a.score != b.score ? a.score > b.score : a.entry < b.entry;
+    });
+
+    return out.size() - first;
+}
+
+}
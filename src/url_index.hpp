@@ -0,0 +1,94 @@
+#ifndef URL_INDEX_HPP
+#define URL_INDEX_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tree.hpp"
+
+namespace kdbx
+{
+
+/*
+ * A URL split into the parts used for matching. Scheme and host are
+ * lower case; the port is the explicit one or the scheme's default.
+ */
+struct parsed_url
+{
+    enum Scheme
+    {
+        NONE = 0,
+        HTTP,
+        HTTPS,
+        OTHER,
+    };
+
+    Scheme scheme = NONE;
+    std::string scheme_name;
+    std::string host;
+    uint16_t port = 0;
+    bool explicit_port = false;
+    bool is_ip = false;
+
+    // False if no usable host could be found
+    static bool parse(const char* text, size_t length, parsed_url& out);
+};
+
+/*
+ * Entry hosts stored in a trie of reversed labels, so a lookup for
+ * a.b.example.com walks com, example, b, a and collects the entries
+ * registered at each node on the way. Every entry's URL is parsed once
+ * when the index is built.
+ *
+ * A suffix only matches at a label boundary and never for a single label
+ * host (e.g. "com") or an IP address, which must match exactly. An entry
+ * with an explicit port only matches that port, and an https entry never
+ * matches an http request. Results are ranked by how specific the match
+ * is: exact host, then longer suffixes, then scheme and port agreement.
+ */
+class url_index
+{
+public:
+    struct match
+    {
+        uint32_t entry;
+        uint32_t score;
+    };
+
+private:
+    struct target
+    {
+        uint32_t entry;
+        parsed_url::Scheme scheme;
+        uint16_t port;
+        bool explicit_port;
+        bool is_ip;
+    };
+
+    struct node
+    {
+        uint32_t depth;
+        uint32_t first_target;
+        uint32_t target_count;
+    };
+
+    std::unordered_map<std::string, uint32_t> _labels;
+    std::unordered_map<uint64_t, uint32_t> _children;
+    std::vector<node> _nodes;
+    std::vector<target> _targets;
+
+    uint32_t find_child(uint32_t parent, const char* label, size_t length) const;
+
+public:
+    void build(const kdbx::tree& tree);
+    void clear();
+
+    // Appends ranked candidates to out, best first, and returns how many
+    size_t find(const std::string& url, std::vector<match>& out) const;
+};
+
+}
+
+#endif
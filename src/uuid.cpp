@@ -0,0 +1,52 @@
+#include "uuid.hpp"
+
+#include <cstring>
+
+#include "base64.hpp"
+#include "errors.hpp"
+
+using std::string;
+
+namespace kdbx
+{
+
+uuid uuid::from_base64(const char* text)
+{
+    size_t length = std::strlen(text);
+
+    if (base64_decoded_size(text, length) != SIZE) {
+        throw parse_error("invalid uuid");
+    }
+
+    uuid id;
+    base64_decode(text, length, id.bytes);
+    return id;
+}
+
+string uuid::to_base64() const
+{
+    return base64_encode(bytes, SIZE);
+}
+
+bool uuid::is_nil() const
+{
+    for (size_t ii = 0; ii < SIZE; ii++) {
+        if (bytes[ii]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool uuid::operator==(const uuid& other) const
+{
+    return std::memcmp(bytes, other.bytes, SIZE) == 0;
+}
+
+bool uuid::operator!=(const uuid& other) const
+{
+    return !(*this == other);
+}
+
+}
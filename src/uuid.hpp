@@ -0,0 +1,28 @@
+#ifndef UUID_HPP
+#define UUID_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kdbx
+{
+
+struct uuid
+{
+    static const size_t SIZE = 16;
+
+    uint8_t bytes[SIZE];
+
+    // Decodes the base64 form used in the XML
+    static uuid from_base64(const char* text);
+
+    std::string to_base64() const;
+    bool is_nil() const;
+
+    bool operator==(const uuid& other) const;
+    bool operator!=(const uuid& other) const;
+};
+
+}
+
+#endif
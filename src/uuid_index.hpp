@@ -0,0 +1,133 @@
+#ifndef UUID_INDEX_HPP
+#define UUID_INDEX_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "uuid.hpp"
+
+namespace kdbx
+{
+
+/*
+ * Open addressing hash table keyed by decoded UUIDs.
+ *
+ * The table is sized once for the expected number of keys and probed
+ * linearly, so a lookup is a hash and usually a single 16 byte compare.
+ */
+template<typename T>
+class uuid_index
+{
+private:
+    struct slot
+    {
+        uuid key;
+        T value;
+        bool used;
+    };
+
+    std::vector<slot> _slots;
+    size_t _mask = 0;
+    size_t _size = 0;
+
+    static size_t hash(const uuid& key)
+    {
+        uint64_t low;
+        uint64_t high;
+        std::memcpy(&low, key.bytes, sizeof(low));
+        std::memcpy(&high, key.bytes + sizeof(low), sizeof(high));
+
+        // Fibonacci hashing, so sequential UUIDs still spread out
+        return static_cast<size_t>(((low ^ high) * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+public:
+    void reserve(size_t count)
+    {
+        size_t capacity = 16;
+        while (capacity < count * 2) {
+            capacity *= 2;
+        }
+
+        std::vector<slot> old;
+        old.swap(_slots);
+
+        _slots.assign(capacity, slot());
+        _mask = capacity - 1;
+        _size = 0;
+
+        for (const slot& s : old) {
+            if (s.used) {
+                insert(s.key, s.value);
+            }
+        }
+    }
+
+    // Keeps the first value if the key is already present
+    bool insert(const uuid& key, const T& value)
+    {
+        if ((_size + 1) * 2 > _slots.size()) {
+            reserve(_size + 1);
+        }
+
+        for (size_t ii = hash(key) & _mask; ; ii = (ii + 1) & _mask) {
+            slot& s = _slots[ii];
+
+            if (!s.used) {
+                s.key = key;
+                s.value = value;
+                s.used = true;
+                _size++;
+                return true;
+            }
+
+            if (s.key == key) {
+                return false;
+            }
+        }
+    }
+
+    const T* find(const uuid& key) const
+    {
+        if (_size == 0) {
+            return NULL;
+        }
+
+        for (size_t ii = hash(key) & _mask; ; ii = (ii + 1) & _mask) {
+            const slot& s = _slots[ii];
+
+            if (!s.used) {
+                return NULL;
+            }
+
+            if (s.key == key) {
+                return &s.value;
+            }
+        }
+    }
+
+    // Calls f(key, value) for every entry, in no particular order
+    template<typename F>
+    void for_each(F f) const
+    {
+        for (const slot& s : _slots) {
+            if (s.used) {
+                f(s.key, s.value);
+            }
+        }
+    }
+
+    void clear()
+    {
+        _slots.clear();
+        _mask = 0;
+        _size = 0;
+    }
+
+    size_t size() const { return _size; }
+};
+
+}
+
+#endif
@@ -0,0 +1,196 @@
+#include "variant_dictionary.hpp"
+
+#include <cstring>
+
+#include "errors.hpp"
+
+using std::string;
+
+using CryptoPP::SecByteBlock;
+
+namespace kdbx
+{
+
+static const uint16_t VERSION = 0x0100;
+static const uint16_t VERSION_MASK = 0xFF00;
+
+template<typename T>
+static T read_le(const byte* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void variant_dictionary::parse(const byte* data, size_t length)
+{
+    /*
+     * The format is a version followed by items of the form:
+     *
+     * struct {
+     *    uint8_t type;
+     *    int32_t key_length;
+     *    char key[];
+     *    int32_t value_length;
+     *    uint8_t value[];
+     * };
+     *
+     * ending with a single zero type byte.
+     */
+    _values.clear();
+
+    const byte* end = data + length;
+
+    if (length < sizeof(uint16_t)) {
+        throw parse_error("variant dictionary truncated");
+    }
+
+    uint16_t version = read_le<uint16_t>(data);
+    data += sizeof(version);
+
+    // Minor versions stay compatible
+    if ((version & VERSION_MASK) > (VERSION & VERSION_MASK)) {
+        throw parse_error("unsupported variant dictionary version");
+    }
+
+    while (true) {
+        if (data == end) {
+            throw parse_error("variant dictionary truncated");
+        }
+
+        uint8_t type = *data++;
+
+        if (type == Type::NONE) {
+            return;
+        }
+
+        int32_t key_length;
+        int32_t value_length;
+
+        if (static_cast<size_t>(end - data) < sizeof(key_length)) {
+            throw parse_error("variant dictionary truncated");
+        }
+
+        key_length = read_le<int32_t>(data);
+        data += sizeof(key_length);
+
+        if (key_length < 0 || static_cast<size_t>(end - data) < key_length + sizeof(value_length)) {
+            throw parse_error("variant dictionary truncated");
+        }
+
+        string key(reinterpret_cast<const char*>(data), static_cast<size_t>(key_length));
+        data += key_length;
+
+        value_length = read_le<int32_t>(data);
+        data += sizeof(value_length);
+
+        if (value_length < 0 || static_cast<size_t>(end - data) < static_cast<size_t>(value_length)) {
+            throw parse_error("variant dictionary truncated");
+        }
+
+        value& item = _values[key];
+        item.type = type;
+        item.data.Assign(data, static_cast<size_t>(value_length));
+        data += value_length;
+    }
+}
+
+void variant_dictionary::clear()
+{
+    _values.clear();
+}
+
+const variant_dictionary::value* variant_dictionary::find(const string& key, uint8_t type) const
+{
+    auto found = _values.find(key);
+
+    if (found == _values.end() || found->second.type != type) {
+        return NULL;
+    }
+
+    return &found->second;
+}
+
+template<typename T>
+static bool get_fixed(const SecByteBlock& data, T& out)
+{
+    if (data.size() != sizeof(T)) {
+        throw parse_error("variant dictionary value unknown format");
+    }
+
+    out = read_le<T>(data.data());
+    return true;
+}
+
+bool variant_dictionary::get(const string& key, uint32_t& out) const
+{
+    const value* found = find(key, Type::UINT32);
+    return found && get_fixed(found->data, out);
+}
+
+bool variant_dictionary::get(const string& key, uint64_t& out) const
+{
+    const value* found = find(key, Type::UINT64);
+    return found && get_fixed(found->data, out);
+}
+
+bool variant_dictionary::get(const string& key, bool& out) const
+{
+    const value* found = find(key, Type::BOOL);
+    uint8_t flag;
+
+    if (!found || !get_fixed(found->data, flag)) {
+        return false;
+    }
+
+    out = flag != 0;
+    return true;
+}
+
+bool variant_dictionary::get(const string& key, int32_t& out) const
+{
+    const value* found = find(key, Type::INT32);
+    return found && get_fixed(found->data, out);
+}
+
+bool variant_dictionary::get(const string& key, int64_t& out) const
+{
+    const value* found = find(key, Type::INT64);
+    return found && get_fixed(found->data, out);
+}
+
+bool variant_dictionary::get(const string& key, string& out) const
+{
+    const value* found = find(key, Type::STRING);
+
+    if (!found) {
+        return false;
+    }
+
+    out.assign(reinterpret_cast<const char*>(found->data.data()), found->data.size());
+    return true;
+}
+
+bool variant_dictionary::get(const string& key, SecByteBlock& out) const
+{
+    const value* found = find(key, Type::BYTES);
+
+    if (!found) {
+        return false;
+    }
+
+    out = found->data;
+    return true;
+}
+
+bool variant_dictionary::contains(const string& key) const
+{
+    return _values.find(key) != _values.end();
+}
+
+size_t variant_dictionary::size() const
+{
+    return _values.size();
+}
+
+}
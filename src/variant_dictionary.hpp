@@ -0,0 +1,65 @@
+#ifndef VARIANT_DICTIONARY_HPP
+#define VARIANT_DICTIONARY_HPP 1
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "cryptopp/secblock.h"
+
+namespace kdbx
+{
+
+/*
+ * The typed key/value map KDBX 4 uses for the KDF parameters and the
+ * public custom data.
+ *
+ * Values are kept as the raw little endian bytes they were read as. The
+ * getters check the stored type and return false when a key is missing or
+ * has a different type.
+ */
+class variant_dictionary
+{
+public:
+    enum Type
+    {
+        NONE = 0x00,
+        UINT32 = 0x04,
+        UINT64 = 0x05,
+        BOOL = 0x08,
+        INT32 = 0x0C,
+        INT64 = 0x0D,
+        STRING = 0x18,
+        BYTES = 0x42,
+    };
+
+private:
+    struct value
+    {
+        uint8_t type;
+        CryptoPP::SecByteBlock data;
+    };
+
+    std::unordered_map<std::string, value> _values;
+
+    const value* find(const std::string& key, uint8_t type) const;
+
+public:
+    // Throws parse_error if data is not a well formed dictionary
+    void parse(const byte* data, size_t length);
+    void clear();
+
+    bool get(const std::string& key, uint32_t& out) const;
+    bool get(const std::string& key, uint64_t& out) const;
+    bool get(const std::string& key, bool& out) const;
+    bool get(const std::string& key, int32_t& out) const;
+    bool get(const std::string& key, int64_t& out) const;
+    bool get(const std::string& key, std::string& out) const;
+    bool get(const std::string& key, CryptoPP::SecByteBlock& out) const;
+
+    bool contains(const std::string& key) const;
+    size_t size() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include "work_pool.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "future.hpp"
+
+using std::lock_guard;
+using std::mutex;
+using std::vector;
+
+namespace kdbx
+{
+
+work_pool::work_pool(size_t threads)
+    : _threads(threads)
+{
+    if (!_threads) {
+        _threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+size_t work_pool::threads() const
+{
+    return _threads;
+}
+
+bool work_pool::pop(size_t worker, task& out)
+{
+    queue& own = *_queues[worker];
+    lock_guard<mutex> lock(own.mutex);
+
+    if (own.tasks.empty()) {
+        return false;
+    }
+
+    out = std::move(own.tasks.back());
+    own.tasks.pop_back();
+    return true;
+}
+
+bool work_pool::steal(size_t worker, task& out)
+{
+    for (size_t ii = 1; ii < _queues.size(); ii++) {
+        queue& victim = *_queues[(worker + ii) % _queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty()) {
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void work_pool::work(size_t worker)
+{
+    task next;
+
+    // Nothing is queued once the batch starts, so empty everywhere means done
+    while (pop(worker, next) || steal(worker, next)) {
+        next();
+    }
+}
+
+void work_pool::run(vector<task> tasks)
+{
+    size_t workers = std::min(_threads, tasks.size());
+
+    if (!workers) {
+        return;
+    }
+
+    _queues.clear();
+    for (size_t ii = 0; ii < workers; ii++) {
+        _queues.push_back(std::make_unique<queue>());
+    }
+
+    for (size_t ii = 0; ii < tasks.size(); ii++) {
+        _queues[ii % workers]->tasks.push_back(std::move(tasks[ii]));
+    }
+
+    vector<std::thread> threads;
+    for (size_t ii = 1; ii < workers; ii++) {
+        threads.emplace_back(&work_pool::work, this, ii);
+    }
+
+    // The calling thread is the first worker
+    work(0);
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    _queues.clear();
+}
+
+}
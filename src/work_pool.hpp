@@ -0,0 +1,55 @@
+#ifndef WORK_POOL_HPP
+#define WORK_POOL_HPP 1
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace kdbx
+{
+
+/*
+ * Runs a batch of independent tasks on a fixed number of threads.
+ *
+ * Tasks are dealt round-robin onto one deque per worker. A worker takes
+ * from the back of its own deque and, once that is empty, steals from the
+ * front of the others, so a few slow tasks (a large database, a high round
+ * count) don't leave the remaining threads idle.
+ */
+class work_pool
+{
+public:
+    typedef std::function<void()> task;
+
+private:
+    work_pool(const work_pool&);
+    work_pool& operator=(const work_pool&);
+
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    size_t _threads;
+    std::vector<std::unique_ptr<queue>> _queues;
+
+    bool pop(size_t worker, task& out);
+    bool steal(size_t worker, task& out);
+    void work(size_t worker);
+
+public:
+    // Zero threads means one per hardware thread
+    explicit work_pool(size_t threads = 0);
+
+    size_t threads() const;
+
+    // Blocks until every task has run. Tasks must not throw.
+    void run(std::vector<task> tasks);
+};
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+
+#include <cstring>
+#include <sstream>
+
+#include "cryptopp/aes.h"
+#include "cryptopp/modes.h"
+#include "cryptopp/osrng.h"
+
+#include "future.hpp"
+
+#include "base64.hpp"
+#include "io.hpp"
+#include "ocryptbuf.hpp"
+#include "ogzipbuf.hpp"
+#include "ohashbuf.hpp"
+#include "serializer.hpp"
+
+using pugi::xml_node;
+
+using std::ostream;
+using std::string;
+
+using CryptoPP::AES;
+using CryptoPP::AutoSeededRandomPool;
+using CryptoPP::CBC_Mode;
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+
+namespace kdbx
+{
+
+static const size_t SEED_SIZE = 32;
+
+void kdbx2::save(ostream& out)
+{
+    if (_pvt->from_cache) {
+        throw write_error("database was loaded from a cache");
+    }
+
+    if (file_version_major() > 3) {
+        throw write_error("unknown file version");
+    }
+
+    kdbx2_pvt::save_state state;
+
+    _pvt->prepare_key();
+    _pvt->write_header(out, state);
+    _pvt->write_body(out, state);
+
+    out.flush();
+    if (!out) {
+        throw write_error("unable to write database");
+    }
+}
+
+void kdbx2_pvt::prepare_key()
+{
+    SecByteBlock current;
+    compute_composite_key(current);
+
+    // The key transformed at load can be used again while the keys, the
+    // transform seed and the rounds are unchanged, as when loading
+    if (!transformed_key.empty() && current == composite_key
+            && transform_seed == transformed_seed && transform_rounds == transformed_rounds) {
+        return;
+    }
+
+    // New keys get a new seed; otherwise the header's seed and rounds are
+    // kept, and only the key is transformed again to match them
+    if (current != composite_key || transform_seed.empty()) {
+        composite_key = current;
+
+        AutoSeededRandomPool rng;
+        transform_seed.New(SEED_SIZE);
+        rng.GenerateBlock(transform_seed.data(), transform_seed.size());
+    }
+
+    if (!transform_key() && cache) {
+        cache->insert(composite_key, transform_seed, transform_rounds, transformed_key);
+    }
+}
+
+static void write_field(ostream& out, uint8_t id, const void* data, size_t length)
+{
+    if (length > UINT16_MAX) {
+        throw write_error("header field too long");
+    }
+
+    uint16_t encoded = static_cast<uint16_t>(length);
+    write(out, id);
+    write(out, encoded);
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(length));
+}
+
+static void write_field(ostream& out, uint8_t id, const SecByteBlock& data)
+{
+    write_field(out, id, data.data(), data.size());
+}
+
+void kdbx2_pvt::write_header(ostream& out, save_state& state) const
+{
+    // Every save gets fresh seeds, so no two files share a keystream
+    AutoSeededRandomPool rng;
+
+    state.master_seed.New(SEED_SIZE);
+    rng.GenerateBlock(state.master_seed.data(), state.master_seed.size());
+
+    state.encryption_iv.New(AES::BLOCKSIZE);
+    rng.GenerateBlock(state.encryption_iv.data(), state.encryption_iv.size());
+
+    state.protected_stream_key.New(SEED_SIZE);
+    rng.GenerateBlock(state.protected_stream_key.data(), state.protected_stream_key.size());
+
+    state.stream_start_bytes.New(SEED_SIZE);
+    rng.GenerateBlock(state.stream_start_bytes.data(), state.stream_start_bytes.size());
+
+    // Build the header in memory, since its hash goes into the XML
+    std::ostringstream header;
+
+    write(header, SIGNATURE[0]);
+    write(header, SIGNATURE[1]);
+    write(header, file_version);
+
+    if (cipher_id.empty()) {
+        write_field(header, FieldID::CIPHER_ID, AES_CIPHER_ID, sizeof(AES_CIPHER_ID));
+    } else {
+        write_field(header, FieldID::CIPHER_ID, cipher_id.data(), cipher_id.size());
+    }
+
+    if (!comment.empty()) {
+        write_field(header, FieldID::COMMENT, comment.data(), comment.size());
+    }
+
+    write_field(header, FieldID::COMPRESSION_FLAGS, &compression_flags, sizeof(compression_flags));
+    write_field(header, FieldID::MASTER_SEED, state.master_seed);
+    write_field(header, FieldID::TRANSFORM_SEED, transform_seed);
+    write_field(header, FieldID::TRANSFORM_ROUNDS, &transform_rounds, sizeof(transform_rounds));
+    write_field(header, FieldID::ENCRYPTION_IV, state.encryption_iv);
+    write_field(header, FieldID::PROTECTED_STREAM_KEY, state.protected_stream_key);
+    write_field(header, FieldID::STREAM_START_BYTES, state.stream_start_bytes);
+    write_field(header, FieldID::INNER_RANDOM_STREAM_ID,
+                &inner_random_stream_id, sizeof(inner_random_stream_id));
+    write_field(header, FieldID::END_OF_HEADER, "\r\n\r\n", 4);
+
+    string bytes = header.str();
+
+    byte digest[SHA256::DIGESTSIZE];
+    SHA256().CalculateDigest(digest, reinterpret_cast<const byte*>(bytes.data()), bytes.size());
+    state.header_hash = base64_encode(digest, sizeof(digest));
+
+    write(out, bytes);
+    if (!out) {
+        throw write_error("unable to write header");
+    }
+}
+
+void kdbx2_pvt::write_body(ostream& out, const save_state& state) const
+{
+    switch (_pub.file_version_major()) {
+        case 0x01:
+        case 0x02:
+        case 0x03:
+            write_body_v1(out, state);
+            break;
+
+        default:
+            throw write_error("unknown file version");
+    }
+}
+
+void kdbx2_pvt::write_body_v1(ostream& out, const save_state& state) const
+{
+    SecByteBlock master_key;
+    combine_master_key(state.master_seed, master_key);
+
+    CBC_Mode<AES>::Encryption encryption(master_key,
+                                            master_key.size(),
+                                            state.encryption_iv.data());
+
+    // Encrypt the body in chunks as it is written
+    ocryptbuf encrypted(out, encryption);
+    ostream crypt_stream(&encrypted);
+    crypt_stream.exceptions(std::ios::badbit);
+
+    write(crypt_stream, state.stream_start_bytes);
+
+    // Frame the plaintext into hashed blocks
+    ohashbuf hashed(crypt_stream);
+    ostream hash_stream(&hashed);
+    hash_stream.exceptions(std::ios::badbit);
+
+    // Compress the XML as it is written, if needed
+    std::unique_ptr<ogzipbuf> deflated;
+
+    switch (compression_flags) {
+        case Compression::NONE:
+            break;
+
+        case Compression::GZIP:
+            deflated = std::make_unique<ogzipbuf>(hash_stream);
+            break;
+
+        default:
+            throw write_error("unknown compression algorithm");
+    }
+
+    ostream xml_stream(deflated ? static_cast<std::streambuf*>(deflated.get()) : &hashed);
+    xml_stream.exceptions(std::ios::badbit);
+
+    // Protected values are decrypted with the stream they were loaded with
+    // and encrypted again, in document order, with the new one
+    protected_stream next(inner_random_stream_id, state.protected_stream_key);
+    uint64_t offset = 0;
+
+    auto filter = [&](const xml_node& node, string& text) -> bool {
+        if (!std::strcmp(node.name(), "HeaderHash")
+                && !std::strcmp(node.parent().name(), "Meta")) {
+            text = state.header_hash;
+            return true;
+        }
+
+        auto found = protected_values.find(node.internal_object());
+        if (found == protected_values.end()) {
+            return false;
+        }
+
+        const char* encoded = node.text().get();
+        SecByteBlock value(found->second.length);
+        base64_decode(encoded, std::strlen(encoded), value.data());
+
+        inner_stream->apply(found->second.offset, value.data(), value.size());
+        next.apply(offset, value.data(), value.size());
+        offset += value.size();
+
+        text = base64_encode(value.data(), value.size());
+        return true;
+    };
+
+    xml_node kee = document.child("KeePassFile");
+
+    if (kee) {
+        serializer(xml_stream, filter).write(document);
+    } else {
+        // Nothing has been loaded, so write an empty database
+        xml_stream << "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\n"
+                    << "<KeePassFile>\n<Meta>\n<HeaderHash>" << state.header_hash
+                    << "</HeaderHash>\n</Meta>\n<Root/>\n</KeePassFile>\n";
+    }
+
+    if (deflated) {
+        deflated->finish();
+    }
+
+    hashed.finish();
+    encrypted.finish();
+}
+
+}
@@ -0,0 +1,131 @@
+#include "xml_memory.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+#include "cryptopp/misc.h"
+
+#include "pugixml.hpp"
+
+namespace kdbx
+{
+
+static thread_local secure_arena* current_arena = nullptr;
+static thread_local load_stats* counting = nullptr;
+static thread_local int64_t live = 0;
+
+// Marks the blocks allocated here, so blocks pugixml got elsewhere (before
+// the functions were installed) aren't mistaken for them when freed
+static const uint64_t BLOCK_MAGIC = 0x6B6462786D656D31ULL;
+
+// Keeps the blocks handed to pugixml aligned like malloc's
+union block_header
+{
+    struct
+    {
+        secure_arena* arena;
+        size_t size;
+        uint64_t magic;
+    } info;
+    std::max_align_t align;
+};
+
+static void* xml_allocate(size_t size)
+{
+    size_t total = sizeof(block_header) + size;
+    block_header* header;
+
+    if (current_arena) {
+        try {
+            header = static_cast<block_header*>(current_arena->allocate(total));
+        } catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+    } else {
+        header = static_cast<block_header*>(std::malloc(total));
+
+        if (!header) {
+            return nullptr;
+        }
+    }
+
+    header->info.arena = current_arena;
+    header->info.size = size;
+    header->info.magic = BLOCK_MAGIC;
+
+    if (counting) {
+        counting->allocations++;
+        counting->allocated_bytes += size;
+
+        if (++live > static_cast<int64_t>(counting->peak_allocations)) {
+            counting->peak_allocations = static_cast<uint64_t>(live);
+        }
+    }
+
+    return header + 1;
+}
+
+static void xml_deallocate(void* ptr)
+{
+    if (!ptr) {
+        return;
+    }
+
+    block_header* header = static_cast<block_header*>(ptr) - 1;
+
+    // pugixml's default functions use malloc and free
+    if (header->info.magic != BLOCK_MAGIC) {
+        std::free(ptr);
+        return;
+    }
+
+    header->info.magic = 0;
+
+    if (counting) {
+        live--;
+    }
+
+    if (!header->info.arena) {
+        CryptoPP::SecureWipeBuffer(reinterpret_cast<byte*>(header),
+                                    sizeof(block_header) + header->info.size);
+        std::free(header);
+    }
+}
+
+// Installed before main. A static initializer elsewhere may still have
+// allocated through pugixml's defaults first; the magic tells those apart.
+static struct xml_memory_hooks
+{
+    xml_memory_hooks()
+    {
+        pugi::set_memory_management_functions(xml_allocate, xml_deallocate);
+    }
+} hooks;
+
+xml_memory_scope::xml_memory_scope(secure_arena* arena, load_stats* stats)
+    : _previous_arena(current_arena), _previous_stats(counting)
+{
+    // Blocks from other functions would be freed here, and arena blocks
+    // there, so nothing may be parsed once the hooks are replaced
+    if (pugi::get_memory_allocation_function() != xml_allocate
+            || pugi::get_memory_deallocation_function() != xml_deallocate) {
+        throw std::logic_error("pugixml memory management functions were replaced");
+    }
+
+    current_arena = arena;
+
+    if (stats) {
+        counting = stats;
+        live = 0;
+    }
+}
+
+xml_memory_scope::~xml_memory_scope()
+{
+    current_arena = _previous_arena;
+    counting = _previous_stats;
+}
+
+}
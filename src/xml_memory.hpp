@@ -0,0 +1,41 @@
+#ifndef XML_MEMORY_HPP
+#define XML_MEMORY_HPP 1
+
+#include "arena.hpp"
+#include "load_stats.hpp"
+
+namespace kdbx
+{
+
+/*
+ * pugixml only takes process wide allocation functions. The ones installed
+ * here look at the calling thread to decide where document memory comes
+ * from and what it is counted against, so concurrent loads stay apart.
+ *
+ * Each block records where it came from, so it can be freed on any thread,
+ * and a magic value; blocks without it came from pugixml's own malloc.
+ * Heap blocks are wiped before they are freed; arena blocks are left for
+ * the arena to wipe.
+ *
+ * The functions are installed during static initialization and must stay
+ * installed; a scope throws std::logic_error if they have been replaced.
+ */
+class xml_memory_scope
+{
+private:
+    xml_memory_scope(const xml_memory_scope&);
+    xml_memory_scope& operator=(const xml_memory_scope&);
+
+    secure_arena* _previous_arena;
+    load_stats* _previous_stats;
+
+public:
+    // Allocations on this thread come from arena (the heap if NULL) and
+    // are counted into stats (if not NULL) until the scope ends
+    xml_memory_scope(secure_arena* arena, load_stats* stats);
+    ~xml_memory_scope();
+};
+
+}
+
+#endif
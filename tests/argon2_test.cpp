@@ -0,0 +1,162 @@
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+
+#include "argon2.hpp"
+#include "errors.hpp"
+
+#include "check.hpp"
+
+using std::string;
+
+using CryptoPP::SecByteBlock;
+
+using kdbx::argon2;
+using kdbx::argon2_parameters;
+
+struct test_vector
+{
+    const char* name;
+    uint32_t type;
+    uint32_t version;
+    string password;
+    string salt;
+    string secret;
+    string associated;
+    uint64_t memory_kib;
+    uint64_t iterations;
+    uint32_t parallelism;
+    const char* tag;
+};
+
+// RFC 9106 section 5 uses these inputs for every type
+static const string RFC_PASSWORD(32, '\x01');
+static const string RFC_SALT(16, '\x02');
+static const string RFC_SECRET(8, '\x03');
+static const string RFC_ASSOCIATED(12, '\x04');
+
+static const test_vector VECTORS[] = {
+    // RFC 9106 sections 5.1 and 5.3
+    {"RFC 9106 Argon2d", argon2_parameters::ARGON2D, argon2_parameters::VERSION_13,
+        RFC_PASSWORD, RFC_SALT, RFC_SECRET, RFC_ASSOCIATED, 32, 3, 4,
+        "512b391b6f1162975371d30919734294f868e3be3984f3c1a13a4db9fabe4acb"},
+    {"RFC 9106 Argon2id", argon2_parameters::ARGON2ID, argon2_parameters::VERSION_13,
+        RFC_PASSWORD, RFC_SALT, RFC_SECRET, RFC_ASSOCIATED, 32, 3, 4,
+        "0d640df58d78766c08c037a34a8b53c9d01ef0452d75b65eb52520e96b01e659"},
+
+    // Version 1.0, which KeePass still accepts, from the reference
+    // implementation
+    {"v1.0 Argon2d", argon2_parameters::ARGON2D, argon2_parameters::VERSION_10,
+        RFC_PASSWORD, RFC_SALT, RFC_SECRET, RFC_ASSOCIATED, 32, 3, 4,
+        "96a9d4e5a1734092c85e29f410a45914a5dd1f5cbf08b2670da68a0285abf32b"},
+    {"v1.0 Argon2id", argon2_parameters::ARGON2ID, argon2_parameters::VERSION_10,
+        RFC_PASSWORD, RFC_SALT, RFC_SECRET, RFC_ASSOCIATED, 32, 3, 4,
+        "b64615f07789b66b645b67ee9ed3b377ae350b6bfcbb0fc95141ea8f322613c0"},
+    {"v1.0 Argon2d, one lane", argon2_parameters::ARGON2D, argon2_parameters::VERSION_10,
+        "password", "somesalt", "", "", 256, 2, 1,
+        "bd404868ff00c52e7543c8332e6a772a5724892d7e328d5cf253bbc8e726b371"},
+    {"v1.0 Argon2id, one lane", argon2_parameters::ARGON2ID, argon2_parameters::VERSION_10,
+        "password", "somesalt", "", "", 256, 2, 1,
+        "da070e576e50f2f38a3c897cbddc6c7fb4028e870971ff9eae7b4e1879295e6e"},
+};
+
+static SecByteBlock bytes(const string& text)
+{
+    return SecByteBlock(reinterpret_cast<const byte*>(text.data()), text.size());
+}
+
+static string hex(const byte* data, size_t length)
+{
+    static const char DIGITS[] = "0123456789abcdef";
+    string text;
+
+    for (size_t ii = 0; ii < length; ii++) {
+        text += DIGITS[data[ii] >> 4];
+        text += DIGITS[data[ii] & 0xF];
+    }
+
+    return text;
+}
+
+static argon2_parameters parameters(const test_vector& v)
+{
+    argon2_parameters params;
+    params.type = v.type;
+    params.version = v.version;
+    params.salt = bytes(v.salt);
+    params.secret = bytes(v.secret);
+    params.associated = bytes(v.associated);
+    params.memory = v.memory_kib * 1024;
+    params.iterations = v.iterations;
+    params.parallelism = v.parallelism;
+    return params;
+}
+
+static void check_vector(const test_vector& v, uint32_t threads)
+{
+    argon2 kdf(parameters(v), threads);
+
+    byte out[argon2::KEY_SIZE];
+    kdf.apply(reinterpret_cast<const byte*>(v.password.data()), v.password.size(), out);
+
+    string tag = hex(out, sizeof(out));
+
+    if (tag != v.tag) {
+        std::cerr << v.name << " with " << threads << " thread(s) gave " << tag << std::endl;
+        CHECK(false);
+    }
+}
+
+static bool rejects(const argon2_parameters& params)
+{
+    try {
+        argon2 kdf(params);
+    } catch (const kdbx::parse_error&) {
+        return true;
+    }
+
+    return false;
+}
+
+int main()
+{
+    // The lanes are spread over any number of threads, including more
+    // threads than lanes, without changing the result
+    for (const test_vector& v : VECTORS) {
+        for (uint32_t threads : {0u, 1u, 2u, 3u, 4u, 8u}) {
+            check_vector(v, threads);
+        }
+    }
+
+    argon2_parameters params = parameters(VECTORS[0]);
+    CHECK(!rejects(params));
+
+    argon2_parameters bad = params;
+    bad.type = 1;
+    CHECK(rejects(bad));
+
+    bad = params;
+    bad.version = 0x12;
+    CHECK(rejects(bad));
+
+    bad = params;
+    bad.parallelism = 0;
+    CHECK(rejects(bad));
+
+    bad = params;
+    bad.iterations = 0;
+    CHECK(rejects(bad));
+
+    bad = params;
+    bad.salt = bytes("1234567");
+    CHECK(rejects(bad));
+
+    // Eight blocks per lane at least
+    bad = params;
+    bad.memory = 31 * 1024;
+    CHECK(rejects(bad));
+
+    return kdbx_test::finish();
+}
@@ -0,0 +1,44 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP 1
+#include <iostream>
+
+/*
+ * Just enough of a test harness for the test executables. Failed checks
+ * are reported and counted, and main returns finish(), which is non-zero
+ * if anything failed, for ctest to see.
+ */
+namespace kdbx_test
+{
+
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* file, int line, const char* condition)
+{
+    std::cerr << file << ":" << line << ": check failed: " << condition << std::endl;
+    failures()++;
+}
+
+inline int finish()
+{
+    if (failures()) {
+        std::cerr << failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            kdbx_test::fail(__FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,164 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "kdbx.hpp"
+#include "timestamp.hpp"
+
+#include "check.hpp"
+
+using std::string;
+
+using CryptoPP::SecByteBlock;
+
+using namespace kdbx;
+
+static const char* const PASSWORD = "test123";
+
+// The KDBX 4 fixtures hold tests/simple.kdbx's groups and entries, with an
+// attachment on the first entry
+static const char* const ROOT = "4LW4Mnb1IUOtKMXNrbcp1w==";
+static const char* const SAMPLE = "IPl4jfIQlkGfB/yZP3C0dA==";
+static const char* const SAMPLE_2 = "qcpJ1WYvVEm5OXbDPjMsOQ==";
+static const char* const ATTACHMENT = "Attached through the inner header\n";
+
+static const byte AES_CIPHER[] = {
+    0x31, 0xC1, 0xF2, 0xE6, 0xBF, 0x71, 0x43, 0x50,
+    0xBE, 0x58, 0x05, 0x21, 0x6A, 0xFC, 0x5A, 0xFF,
+};
+
+static const byte CHACHA20_CIPHER[] = {
+    0xD6, 0x03, 0x8A, 0x2B, 0x8B, 0x6F, 0x4C, 0xB5,
+    0xA5, 0x24, 0x33, 0x9A, 0x31, 0xDB, 0xB5, 0x9A,
+};
+
+struct fixture
+{
+    const byte* cipher;
+    uint64_t iterations;
+};
+
+static string read_file(const string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static bool has_password(const kdbx2& db, const char* id, const char* expected)
+{
+    entry e = db.find_entry(uuid::from_base64(id));
+    SecByteBlock value;
+
+    if (!e || !e.get_protected_string("Password", value)) {
+        return false;
+    }
+
+    return value.size() == std::strlen(expected)
+        && std::memcmp(value.data(), expected, value.size()) == 0;
+}
+
+static bool is_time(const timestamp& t, const char* expected)
+{
+    timestamp parsed;
+    return parse_timestamp(expected, parsed) && t == parsed;
+}
+
+static void check_contents(const kdbx2& db, const fixture& f)
+{
+    CHECK(db.file_version_major() == 4);
+    CHECK(db.cipher_id() == string(reinterpret_cast<const char*>(f.cipher), 16));
+    CHECK(db.compression_flags() == 1);
+    CHECK(db.transform_rounds() == f.iterations);
+
+    // The inner header's stream, ChaCha20, decrypts the protected values
+    CHECK(db.inner_random_stream_id() == 3);
+    CHECK(has_password(db, SAMPLE, "Password"));
+    CHECK(has_password(db, SAMPLE_2, "12345"));
+
+    CHECK(db.all_groups().size() == 7);
+    CHECK(db.all_entries().size() == 2);
+
+    // Times are base64 seconds since year 1 in KDBX 4
+    group root = db.find_group(uuid::from_base64(ROOT));
+    CHECK(root && is_time(root.last_modified(), "2013-11-03T00:58:17Z"));
+
+    entry sample = db.find_entry(uuid::from_base64(SAMPLE));
+    CHECK(sample && is_time(sample.last_modified(), "2013-11-03T00:58:28Z"));
+    CHECK(sample && !std::strcmp(sample.get_string(entry::TITLE), "Sample Entry"));
+
+    // Attachments come from the inner header rather than Meta
+    attachment file = sample ? sample.find_attachment("hello.txt") : attachment();
+    CHECK(file);
+
+    if (file) {
+        std::shared_ptr<const SecByteBlock> contents = file.open();
+        CHECK(contents->size() == std::strlen(ATTACHMENT));
+        CHECK(!std::memcmp(contents->data(), ATTACHMENT, contents->size()));
+    }
+}
+
+static bool load_fails(const string& bytes, const char* password)
+{
+    kdbx2 db;
+    db.push_key(password);
+
+    try {
+        db.load(bytes.data(), bytes.size());
+    } catch (const parse_error&) {
+        return true;
+    }
+
+    return false;
+}
+
+static void check_fixture(const string& path, const fixture& f)
+{
+    string bytes = read_file(path);
+    CHECK(!bytes.empty());
+
+    // From memory, where the blocks are verified in place
+    kdbx2 mapped;
+    mapped.push_key(PASSWORD);
+    mapped.load(bytes.data(), bytes.size());
+    check_contents(mapped, f);
+
+    // And through a stream, where they are copied out first
+    kdbx2 streamed;
+    streamed.push_key(PASSWORD);
+    std::istringstream in(bytes);
+    streamed.load(in);
+    check_contents(streamed, f);
+
+    // The header HMAC catches a wrong key
+    CHECK(load_fails(bytes, "wrong password"));
+
+    // Damage to the header, past the signature and version
+    string header = bytes;
+    header[40] ^= 0x01;
+    CHECK(load_fails(header, PASSWORD));
+
+    // Damage to the last block of ciphertext, ahead of the empty block
+    // that ends the file
+    string body = bytes;
+    body[body.size() - 40] ^= 0x01;
+    CHECK(load_fails(body, PASSWORD));
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <argon2d_aes.kdbx> <argon2id_chacha20.kdbx>"
+                    << std::endl;
+        return 2;
+    }
+
+    // Argon2d with AES-256, and Argon2id with ChaCha20
+    check_fixture(argv[1], fixture{AES_CIPHER, 2});
+    check_fixture(argv[2], fixture{CHACHA20_CIPHER, 3});
+
+    return kdbx_test::finish();
+}
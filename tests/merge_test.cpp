@@ -0,0 +1,351 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pugixml.hpp"
+
+#include "base64.hpp"
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+#include "xml_memory.hpp"
+
+#include "check.hpp"
+
+using std::string;
+using std::vector;
+
+using pugi::xml_node;
+
+using CryptoPP::SecByteBlock;
+
+using namespace kdbx;
+
+static const char* const PASSWORD = "test123";
+
+// Objects in tests/simple.kdbx
+static const char* const ROOT = "4LW4Mnb1IUOtKMXNrbcp1w==";
+static const char* const GENERAL = "RsQYHEUup0iBIoW022wBUA==";
+static const char* const WINDOWS = "Z6V4jPkLAkC18yeaO0EEDg==";
+static const char* const NETWORK = "g11fbFF5oE+wqzouGQMevw==";
+static const char* const INTERNET = "ucs0IAo59EWthob/k75m7Q==";
+static const char* const EMAIL = "D6JTPVaFg0OJgy5yRbpntw==";
+
+static const char* const SAMPLE = "IPl4jfIQlkGfB/yZP3C0dA==";
+static const char* const SAMPLE_2 = "qcpJ1WYvVEm5OXbDPjMsOQ==";
+
+// Added by the tests
+static const char* const COPY_C = "AAAAAAAAAAAAAAAAAAAAAQ==";
+static const char* const COPY_D = "AAAAAAAAAAAAAAAAAAAAAg==";
+static const char* const ADDED_E = "AAAAAAAAAAAAAAAAAAAAAw==";
+
+static const char* const ORIGINAL_TIME = "2013-11-03T00:58:28Z";
+static const char* const OURS_TIME = "2014-01-01T00:00:00Z";
+static const char* const THEIRS_TIME = "2015-01-01T00:00:00Z";
+
+static void load(kdbx2& db, const string& bytes)
+{
+    db.push_key(PASSWORD);
+    db.load(bytes.data(), bytes.size());
+}
+
+static string save(kdbx2& db)
+{
+    std::ostringstream out;
+    db.save(out);
+    return out.str();
+}
+
+//
+// Editing, through the document of a loaded database
+//
+
+static xml_node entry_node(kdbx2& db, const char* id)
+{
+    entry e = db.find_entry(uuid::from_base64(id));
+    return e ? kdbx2_pvt::of(db).tree.entries[e.index()].node : xml_node();
+}
+
+static xml_node group_node(kdbx2& db, const char* id)
+{
+    group g = db.find_group(uuid::from_base64(id));
+    return g ? kdbx2_pvt::of(db).tree.groups[g.index()].node : xml_node();
+}
+
+// Copied protected values are registered where the originals were, so the
+// save decrypts them like values that were loaded
+static void register_values(kdbx2_pvt& db, const xml_node& copy, const xml_node& source)
+{
+    auto found = db.protected_values.find(source.internal_object());
+
+    if (found != db.protected_values.end()) {
+        protected_value value = found->second;
+        db.protected_values[copy.internal_object()] = value;
+    }
+
+    xml_node c = copy.first_child();
+    xml_node s = source.first_child();
+
+    for (; c && s; c = c.next_sibling(), s = s.next_sibling()) {
+        register_values(db, c, s);
+    }
+}
+
+static xml_node copy_node(kdbx2& db, xml_node parent, const xml_node& source)
+{
+    xml_node copy = parent.append_copy(source);
+    register_values(kdbx2_pvt::of(db), copy, source);
+    return copy;
+}
+
+static void set_time(const xml_node& node, const char* name, const char* time)
+{
+    node.child("Times").child(name).text().set(time);
+}
+
+static void set_string(const xml_node& node, const char* key, const char* value)
+{
+    for (xml_node field : node) {
+        if (!std::strcmp(field.name(), "String")
+                && !std::strcmp(field.child("Key").text().get(), key)) {
+            field.child("Value").text().set(value);
+        }
+    }
+}
+
+static void add_entry(kdbx2& db, const char* source, const char* id, const char* group,
+                        const char* title, const char* time)
+{
+    xml_node copy = copy_node(db, group_node(db, group), entry_node(db, source));
+    copy.child("UUID").text().set(id);
+    set_string(copy, "Title", title);
+    set_time(copy, "LastModificationTime", time);
+    set_time(copy, "LocationChanged", time);
+}
+
+// The current version goes into the History, like KeePass does
+static void edit_entry(kdbx2& db, const char* id, const char* title, const char* time)
+{
+    xml_node node = entry_node(db, id);
+    xml_node old = node.child("History").append_child("Entry");
+
+    for (xml_node child : node) {
+        if (std::strcmp(child.name(), "History")) {
+            copy_node(db, old, child);
+        }
+    }
+
+    set_string(node, "Title", title);
+    set_time(node, "LastModificationTime", time);
+}
+
+static void move_entry(kdbx2& db, const char* id, const char* group, const char* time)
+{
+    xml_node node = entry_node(db, id);
+    group_node(db, group).append_move(node);
+    set_time(node, "LocationChanged", time);
+}
+
+// Last on each side: removed nodes stay in protected_values until the save,
+// so nothing may be added after them
+static void delete_entry(kdbx2& db, const char* id, const char* time)
+{
+    xml_node root = kdbx2_pvt::of(db).document.child("KeePassFile").child("Root");
+    xml_node object = root.child("DeletedObjects").append_child("DeletedObject");
+    object.append_child("UUID").text().set(id);
+    object.append_child("DeletionTime").text().set(time);
+
+    xml_node node = entry_node(db, id);
+    node.parent().remove_child(node);
+}
+
+// The file saved after edit has changed a load of file
+template<typename F>
+static string edit_file(const string& file, F edit)
+{
+    kdbx2 db;
+    load(db, file);
+
+    {
+        xml_memory_scope scope(&kdbx2_pvt::of(db).arena, NULL);
+        edit(db);
+    }
+
+    return save(db);
+}
+
+//
+// Checking
+//
+
+static bool has_ids(const vector<uuid>& ids, const vector<const char*>& expected)
+{
+    if (ids.size() != expected.size()) {
+        return false;
+    }
+
+    for (const char* id : expected) {
+        bool found = false;
+
+        for (const uuid& other : ids) {
+            found = found || other == uuid::from_base64(id);
+        }
+
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static string field_value(kdbx2& db, const xml_node& node, const char* key)
+{
+    kdbx2_pvt& pvt = kdbx2_pvt::of(db);
+
+    for (xml_node field : node) {
+        if (std::strcmp(field.name(), "String")
+                || std::strcmp(field.child("Key").text().get(), key)) {
+            continue;
+        }
+
+        xml_node value = field.child("Value");
+        const char* text = value.text().get();
+        auto found = pvt.protected_values.find(value.internal_object());
+
+        if (found == pvt.protected_values.end()) {
+            return text;
+        }
+
+        SecByteBlock plain(found->second.length);
+        base64_decode(text, std::strlen(text), plain.data());
+        pvt.inner_stream->apply(found->second.offset, plain.data(), plain.size());
+        return string(reinterpret_cast<const char*>(plain.data()), plain.size());
+    }
+
+    return string();
+}
+
+static string password(const kdbx2& db, const char* id)
+{
+    SecByteBlock value;
+
+    if (!db.find_entry(uuid::from_base64(id)).get_protected_string("Password", value)) {
+        return string();
+    }
+
+    return string(reinterpret_cast<const char*>(value.data()), value.size());
+}
+
+static bool is_in(const kdbx2& db, const char* id, const char* group)
+{
+    entry e = db.find_entry(uuid::from_base64(id));
+    return e && e.parent().id() == uuid::from_base64(group);
+}
+
+static void check_merged(kdbx2& db)
+{
+    CHECK(db.all_entries().size() == 3);
+
+    // The other side's later edit wins, and ours joins the History
+    entry sample = db.find_entry(uuid::from_base64(SAMPLE));
+    CHECK(sample);
+    CHECK(!std::strcmp(sample.get_string(entry::TITLE), "Theirs"));
+    CHECK(is_in(db, SAMPLE, ROOT));
+    CHECK(password(db, SAMPLE) == "Password");
+
+    vector<xml_node> history;
+
+    for (xml_node old : entry_node(db, SAMPLE).child("History")) {
+        history.push_back(old);
+    }
+
+    CHECK(history.size() == 2);
+
+    if (history.size() == 2) {
+        const char* times[] = {ORIGINAL_TIME, OURS_TIME};
+        const char* titles[] = {"Sample Entry", "Ours"};
+
+        for (size_t ii = 0; ii < history.size(); ii++) {
+            xml_node time = history[ii].child("Times").child("LastModificationTime");
+            CHECK(!std::strcmp(time.text().get(), times[ii]));
+            CHECK(field_value(db, history[ii], "Title") == titles[ii]);
+            CHECK(field_value(db, history[ii], "Password") == "Password");
+        }
+    }
+
+    // Deleted by them, and by us
+    CHECK(!db.find_entry(uuid::from_base64(SAMPLE_2)));
+    CHECK(db.is_deleted(uuid::from_base64(SAMPLE_2)));
+    CHECK(!db.find_entry(uuid::from_base64(COPY_C)));
+    CHECK(db.is_deleted(uuid::from_base64(COPY_C)));
+
+    // Moved on both sides, theirs later
+    CHECK(is_in(db, COPY_D, INTERNET));
+    CHECK(password(db, COPY_D) == "Password");
+
+    // Added by them
+    entry added = db.find_entry(uuid::from_base64(ADDED_E));
+    CHECK(added);
+    CHECK(added && !std::strcmp(added.get_string(entry::TITLE), "Added"));
+    CHECK(is_in(db, ADDED_E, EMAIL));
+    CHECK(password(db, ADDED_E) == "12345");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <simple.kdbx>" << std::endl;
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    string simple((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // Both sides start from the same two extra entries
+    string base = edit_file(simple, [](kdbx2& db) {
+        add_entry(db, SAMPLE_2, COPY_C, GENERAL, "Copy C", ORIGINAL_TIME);
+        add_entry(db, SAMPLE, COPY_D, NETWORK, "Copy D", ORIGINAL_TIME);
+    });
+
+    string ours = edit_file(base, [](kdbx2& db) {
+        edit_entry(db, SAMPLE, "Ours", OURS_TIME);
+        move_entry(db, COPY_D, WINDOWS, OURS_TIME);
+        delete_entry(db, COPY_C, OURS_TIME);
+    });
+
+    string theirs = edit_file(base, [](kdbx2& db) {
+        add_entry(db, SAMPLE_2, ADDED_E, EMAIL, "Added", THEIRS_TIME);
+        edit_entry(db, SAMPLE, "Theirs", THEIRS_TIME);
+        move_entry(db, COPY_D, INTERNET, THEIRS_TIME);
+        delete_entry(db, SAMPLE_2, THEIRS_TIME);
+    });
+
+    kdbx2 db;
+    load(db, ours);
+
+    kdbx2 other;
+    load(other, theirs);
+
+    change_set changes = db.merge(other);
+
+    CHECK(!changes.reloaded);
+    CHECK(changes.added_groups.empty());
+    CHECK(changes.modified_groups.empty());
+    CHECK(changes.removed_groups.empty());
+    CHECK(has_ids(changes.added_entries, {ADDED_E}));
+    CHECK(has_ids(changes.modified_entries, {SAMPLE, COPY_D}));
+    CHECK(has_ids(changes.removed_entries, {SAMPLE_2}));
+
+    check_merged(db);
+
+    // Merged protected values have a new stream, which the save must carry
+    kdbx2 reloaded;
+    load(reloaded, save(db));
+    check_merged(reloaded);
+
+    return kdbx_test::finish();
+}
@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "kdbx.hpp"
+
+#include "check.hpp"
+
+using std::string;
+
+using CryptoPP::SecByteBlock;
+
+using namespace kdbx;
+
+static const char* const PASSWORD = "test123";
+
+static string read_file(const string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const string& path, const string& bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << bytes;
+}
+
+static bool has_password(const kdbx2& db, const char* id, const char* expected)
+{
+    entry e = db.find_entry(uuid::from_base64(id));
+    SecByteBlock value;
+
+    if (!e || !e.get_protected_string("Password", value)) {
+        return false;
+    }
+
+    return value.size() == std::strlen(expected)
+        && std::memcmp(value.data(), expected, value.size()) == 0;
+}
+
+static size_t header_size(const string& bytes)
+{
+    std::istringstream in(bytes);
+    kdbx2 header;
+    header.load_header(in);
+    return static_cast<size_t>(in.tellg());
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <simple.kdbx> <scratch file>" << std::endl;
+        return 2;
+    }
+
+    string path = argv[2];
+    string simple = read_file(argv[1]);
+    write_file(path, simple);
+
+    kdbx2 db;
+    db.push_key(PASSWORD);
+    db.load_file(path);
+
+    // Another save caught partway through the body, as when another
+    // program is still writing it. A new key makes the save pick a new
+    // transform seed.
+    string other;
+
+    {
+        kdbx2 copy;
+        copy.push_key(PASSWORD);
+        copy.load(simple.data(), simple.size());
+        copy.clear_keys();
+        copy.push_key("another password");
+
+        std::ostringstream out;
+        copy.save(out);
+        other = out.str();
+    }
+
+    write_file(path, other.substr(0, header_size(other) + 40));
+
+    bool failed = false;
+
+    try {
+        db.reload();
+    } catch (const std::exception&) {
+        failed = true;
+    }
+
+    CHECK(failed);
+
+    // Left as it was, so a save still has a key that matches its header
+    CHECK(db.all_entries().size() == 2);
+    CHECK(has_password(db, "IPl4jfIQlkGfB/yZP3C0dA==", "Password"));
+
+    std::ostringstream out;
+    db.save(out);
+    string saved = out.str();
+
+    kdbx2 reloaded;
+    reloaded.push_key(PASSWORD);
+    reloaded.load(saved.data(), saved.size());
+
+    CHECK(reloaded.all_entries().size() == 2);
+    CHECK(has_password(reloaded, "IPl4jfIQlkGfB/yZP3C0dA==", "Password"));
+    CHECK(has_password(reloaded, "qcpJ1WYvVEm5OXbDPjMsOQ==", "12345"));
+
+    // A load that fails partway through the body leaves an empty database
+    // rather than records pointing into the freed document
+    string damaged = simple;
+    damaged[damaged.size() - 20] ^= 0x01;
+
+    kdbx2 plain;
+    plain.push_key(PASSWORD);
+    plain.load(simple.data(), simple.size());
+
+    failed = false;
+
+    try {
+        plain.load(damaged.data(), damaged.size());
+    } catch (const std::exception&) {
+        failed = true;
+    }
+
+    CHECK(failed);
+    CHECK(plain.all_entries().size() == 0);
+    CHECK(plain.all_groups().size() == 0);
+    CHECK(!plain.find_entry(uuid::from_base64("IPl4jfIQlkGfB/yZP3C0dA==")));
+
+    std::remove(path.c_str());
+    return kdbx_test::finish();
+}
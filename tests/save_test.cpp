@@ -0,0 +1,243 @@
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "cryptopp/sha.h"
+
+#include "base64.hpp"
+#include "kdbx.hpp"
+#include "kdbx_pvt.hpp"
+
+#include "check.hpp"
+
+using std::string;
+
+using CryptoPP::SecByteBlock;
+using CryptoPP::SHA256;
+
+using namespace kdbx;
+
+static const char* const PASSWORD = "test123";
+
+static bool same(const char* a, const char* b)
+{
+    if (!a || !b) {
+        return a == b;
+    }
+
+    return std::strcmp(a, b) == 0;
+}
+
+static void load(kdbx2& db, const string& bytes)
+{
+    db.push_key(PASSWORD);
+    db.load(bytes.data(), bytes.size());
+}
+
+static string save(kdbx2& db)
+{
+    std::ostringstream out;
+    db.save(out);
+    return out.str();
+}
+
+static void compare_header(const kdbx2& a, const kdbx2& b)
+{
+    CHECK(a.file_version() == b.file_version());
+    CHECK(a.cipher_id() == b.cipher_id());
+    CHECK(a.compression_flags() == b.compression_flags());
+    CHECK(a.transform_rounds() == b.transform_rounds());
+    CHECK(a.inner_random_stream_id() == b.inner_random_stream_id());
+}
+
+static void compare_meta(const kdbx2& a, const kdbx2& b)
+{
+    CHECK(same(a.generator(), b.generator()));
+    CHECK(same(a.database_name(), b.database_name()));
+    CHECK(a.database_name_changed() == b.database_name_changed());
+    CHECK(same(a.database_description(), b.database_description()));
+    CHECK(a.database_description_changed() == b.database_description_changed());
+    CHECK(same(a.default_user_name(), b.default_user_name()));
+    CHECK(a.default_user_name_changed() == b.default_user_name_changed());
+    CHECK(a.maintenance_history_days() == b.maintenance_history_days());
+    CHECK(same(a.color(), b.color()));
+    CHECK(a.master_key_changed() == b.master_key_changed());
+    CHECK(a.master_key_change_rec() == b.master_key_change_rec());
+    CHECK(a.master_key_change_force() == b.master_key_change_force());
+
+    const memory_protection& pa = a.memory_protection();
+    const memory_protection& pb = b.memory_protection();
+    CHECK(pa.title == pb.title);
+    CHECK(pa.user_name == pb.user_name);
+    CHECK(pa.password == pb.password);
+    CHECK(pa.url == pb.url);
+    CHECK(pa.notes == pb.notes);
+
+    CHECK(a.recycle_bin_enabled() == b.recycle_bin_enabled());
+    CHECK(a.recycle_bin_uuid() == b.recycle_bin_uuid());
+    CHECK(a.recycle_bin_changed() == b.recycle_bin_changed());
+    CHECK(a.entry_templates_group() == b.entry_templates_group());
+    CHECK(a.entry_templates_group_changed() == b.entry_templates_group_changed());
+    CHECK(a.history_max_items() == b.history_max_items());
+    CHECK(a.history_max_size() == b.history_max_size());
+    CHECK(a.last_selected_group() == b.last_selected_group());
+    CHECK(a.last_top_visible_group() == b.last_top_visible_group());
+    CHECK(a.custom_icons().size() == b.custom_icons().size());
+    CHECK(a.binaries().size() == b.binaries().size());
+}
+
+static void compare_groups(const kdbx2& a, const kdbx2& b)
+{
+    index_range<group> ga = a.all_groups();
+    index_range<group> gb = b.all_groups();
+    CHECK(ga.size() == gb.size());
+
+    for (size_t ii = 0; ii < ga.size() && ii < gb.size(); ii++) {
+        group x = ga[ii];
+        group y = gb[ii];
+
+        CHECK(x.id() == y.id());
+        CHECK(same(x.name(), y.name()));
+        CHECK(same(x.notes(), y.notes()));
+        CHECK(x.icon_id() == y.icon_id());
+        CHECK(x.last_modified() == y.last_modified());
+        CHECK(x.is_expanded() == y.is_expanded());
+        CHECK(same(x.enable_auto_type(), y.enable_auto_type()));
+        CHECK(same(x.enable_searching(), y.enable_searching()));
+        CHECK(same(x.last_top_visible_entry(), y.last_top_visible_entry()));
+        CHECK(x.parent().index() == y.parent().index());
+        CHECK(x.entries().size() == y.entries().size());
+    }
+}
+
+static void compare_entries(const kdbx2& a, const kdbx2& b)
+{
+    index_range<entry> ea = a.all_entries();
+    index_range<entry> eb = b.all_entries();
+    CHECK(ea.size() == eb.size());
+
+    for (size_t ii = 0; ii < ea.size() && ii < eb.size(); ii++) {
+        entry x = ea[ii];
+        entry y = eb[ii];
+
+        CHECK(x.id() == y.id());
+        CHECK(x.last_modified() == y.last_modified());
+        CHECK(x.parent().id() == y.parent().id());
+        CHECK(x.attachment_count() == y.attachment_count());
+
+        for (int field = 0; field < entry::STANDARD_FIELD_COUNT; field++) {
+            const string_field* fx = x.find_string(static_cast<entry::Field>(field));
+            const string_field* fy = y.find_string(static_cast<entry::Field>(field));
+
+            CHECK(!fx == !fy);
+
+            if (!fx || !fy) {
+                continue;
+            }
+
+            CHECK(same(fx->key, fy->key));
+            CHECK(fx->is_protected == fy->is_protected);
+
+            // Protected values are compared decrypted, since each save
+            // encrypts them with a new stream
+            SecByteBlock vx;
+            SecByteBlock vy;
+            CHECK(x.get_protected_string(fx->key, vx));
+            CHECK(y.get_protected_string(fy->key, vy));
+            CHECK(vx == vy);
+        }
+    }
+}
+
+static bool has_password(const kdbx2& db, const char* id, const char* expected)
+{
+    entry e = db.find_entry(uuid::from_base64(id));
+    SecByteBlock value;
+
+    if (!e || !e.get_protected_string("Password", value)) {
+        return false;
+    }
+
+    return value.size() == std::strlen(expected)
+        && std::memcmp(value.data(), expected, value.size()) == 0;
+}
+
+static void check_header_hash(const kdbx2& db, const string& bytes)
+{
+    std::istringstream in(bytes);
+    kdbx2 header;
+    header.load_header(in);
+
+    size_t header_size = static_cast<size_t>(in.tellg());
+
+    byte digest[SHA256::DIGESTSIZE];
+    SHA256().CalculateDigest(digest, reinterpret_cast<const byte*>(bytes.data()), header_size);
+
+    CHECK(same(db.header_hash(), base64_encode(digest, sizeof(digest)).c_str()));
+}
+
+// Changes the header's key parameters behind the key transformed at load,
+// then checks that the save transforms the key again to match them
+template<typename F>
+static void check_key_change(const string& file, F change)
+{
+    kdbx2 db;
+    load(db, file);
+    change(kdbx2_pvt::of(db));
+
+    string saved = save(db);
+
+    kdbx2 reloaded;
+    load(reloaded, saved);
+
+    CHECK(reloaded.transform_rounds() == db.transform_rounds());
+    CHECK(has_password(reloaded, "IPl4jfIQlkGfB/yZP3C0dA==", "Password"));
+    CHECK(has_password(reloaded, "qcpJ1WYvVEm5OXbDPjMsOQ==", "12345"));
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <simple.kdbx>" << std::endl;
+        return 2;
+    }
+
+    kdbx2 original;
+    original.push_key(PASSWORD);
+    original.load_file(argv[1]);
+
+    CHECK(has_password(original, "IPl4jfIQlkGfB/yZP3C0dA==", "Password"));
+    CHECK(has_password(original, "qcpJ1WYvVEm5OXbDPjMsOQ==", "12345"));
+
+    string saved = save(original);
+
+    kdbx2 reloaded;
+    load(reloaded, saved);
+
+    compare_header(original, reloaded);
+    compare_meta(original, reloaded);
+    compare_groups(original, reloaded);
+    compare_entries(original, reloaded);
+    check_header_hash(reloaded, saved);
+
+    CHECK(has_password(reloaded, "IPl4jfIQlkGfB/yZP3C0dA==", "Password"));
+    CHECK(has_password(reloaded, "qcpJ1WYvVEm5OXbDPjMsOQ==", "12345"));
+
+    // A second generation, saved from a database that was itself saved
+    string again = save(reloaded);
+    CHECK(again != saved);
+
+    kdbx2 second;
+    load(second, again);
+
+    compare_meta(original, second);
+    compare_groups(original, second);
+    compare_entries(original, second);
+    check_header_hash(second, again);
+
+    check_key_change(saved, [](kdbx2_pvt& db) { db.transform_rounds = 1000; });
+    check_key_change(saved, [](kdbx2_pvt& db) { db.transform_seed[0] ^= 0xFF; });
+
+    return kdbx_test::finish();
+}
@@ -0,0 +1,64 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "base64.hpp"
+#include "timestamp.hpp"
+
+#include "check.hpp"
+
+using namespace kdbx;
+
+// Seconds from 1970-01-01 to 0001-01-01 and to 9999-12-31T23:59:59Z
+static const int64_t YEAR_1 = -62135596800LL;
+static const int64_t YEAR_9999_END = 253402300799LL;
+
+static int64_t seconds(const timestamp& t)
+{
+    return static_cast<int64_t>(t.time_since_epoch().count());
+}
+
+// The KDBX 4 form: little endian seconds since 0001-01-01, in base64
+static std::string binary(int64_t since_year_1)
+{
+    byte bytes[sizeof(int64_t)];
+
+    for (size_t ii = 0; ii < sizeof(bytes); ii++) {
+        bytes[ii] = static_cast<byte>(static_cast<uint64_t>(since_year_1) >> (8 * ii));
+    }
+
+    return base64_encode(bytes, sizeof(bytes));
+}
+
+static bool parses_to(const char* text, int64_t expected)
+{
+    timestamp t;
+    return parse_timestamp(text, t) && seconds(t) == expected;
+}
+
+int main()
+{
+    CHECK(parses_to("1970-01-01T00:00:00Z", 0));
+    CHECK(parses_to("2013-11-03T00:58:17Z", 1383440297));
+    CHECK(parses_to("2013-11-03T00:58:17.123Z", 1383440297));
+
+    // The ends of KeePass's range, beyond what nanosecond counts can hold
+    CHECK(parses_to("0001-01-01T00:00:00Z", YEAR_1));
+    CHECK(parses_to("9999-12-31T23:59:59Z", YEAR_9999_END));
+    CHECK(parses_to(binary(0).c_str(), YEAR_1));
+    CHECK(parses_to(binary(YEAR_9999_END - YEAR_1).c_str(), YEAR_9999_END));
+
+    // They still order correctly against ordinary times
+    timestamp first, ordinary, last;
+    CHECK(parse_timestamp(binary(0).c_str(), first));
+    CHECK(parse_timestamp("2013-11-03T00:58:17Z", ordinary));
+    CHECK(parse_timestamp("9999-12-31T23:59:59Z", last));
+    CHECK(first < ordinary && ordinary < last);
+
+    timestamp t;
+    CHECK(!parse_timestamp("2013-13-03T00:58:17Z", t));
+    CHECK(!parse_timestamp("2013-11-03 00:58:17Z", t));
+    CHECK(!parse_timestamp(binary(-1).c_str(), t));
+
+    return kdbx_test::finish();
+}
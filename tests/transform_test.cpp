@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "cryptopp/aes.h"
+#include "cryptopp/modes.h"
+
+#include "transform.hpp"
+
+#include "check.hpp"
+
+using CryptoPP::AES;
+using CryptoPP::ECB_Mode;
+using CryptoPP::SecByteBlock;
+
+using kdbx::key_transform;
+
+static const uint64_t ROUNDS[] = {0, 1, 2, 7, 6001};
+
+// What the KDF loop did before key_transform: one ECB call per round
+static void reference(const SecByteBlock& seed, byte* key, uint64_t rounds)
+{
+    ECB_Mode<AES>::Encryption aes(seed.data(), seed.size());
+
+    for (uint64_t ii = 0; ii < rounds; ii++) {
+        aes.ProcessData(key, key, key_transform::KEY_SIZE);
+    }
+}
+
+static void fill(byte* data, size_t length, unsigned pattern)
+{
+    for (size_t ii = 0; ii < length; ii++) {
+        data[ii] = static_cast<byte>(pattern * 31 + ii * 7 + (pattern >> 3));
+    }
+}
+
+static void check_engine(bool use_aesni)
+{
+    for (unsigned pattern = 0; pattern < 4; pattern++) {
+        SecByteBlock seed(32);
+        fill(seed.data(), seed.size(), pattern);
+
+        key_transform transform(seed, use_aesni);
+        CHECK(transform.uses_aesni() == use_aesni);
+
+        for (uint64_t rounds : ROUNDS) {
+            byte expected[key_transform::KEY_SIZE];
+            byte actual[key_transform::KEY_SIZE];
+
+            fill(expected, sizeof(expected), pattern + 100);
+            std::memcpy(actual, expected, sizeof(actual));
+
+            reference(seed, expected, rounds);
+            transform.apply(actual, rounds);
+
+            if (std::memcmp(expected, actual, sizeof(actual)) != 0) {
+                std::cerr << (use_aesni ? "AES-NI" : "portable") << " engine differs for seed "
+                            << pattern << " and " << rounds << " rounds" << std::endl;
+                CHECK(false);
+            }
+        }
+    }
+}
+
+int main()
+{
+    check_engine(false);
+
+    if (key_transform::has_aesni()) {
+        check_engine(true);
+    } else {
+        std::cout << "no AES-NI on this CPU, only the portable engine was checked" << std::endl;
+    }
+
+    return kdbx_test::finish();
+}